@@ -2,10 +2,38 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include "error_handler.h"
 #include "type_system.h"
+#include "mem_stats.h"
+
+// Conversion applied to an expression's value where it is used, decided by
+// semantic analysis (see Expr::conv).
+enum class ImplicitConv {
+    None,
+    ArrayToPointer, // array lvalue decays to a pointer to its first element
+    CharToInt,      // sext i8 -> i32
+    IntToChar,      // trunc i32 -> i8
+    IntToFloat,     // sitofp
+    FloatToInt,     // fptosi
+    PointerCast,    // bitcast between pointer types
+    IntToPointer,   // inttoptr (e.g. p = 0)
+    PointerToInt    // ptrtoint
+};
+
+struct Function;
 
 struct Expr {
+    // Annotations filled in by semanticCheckModule
+    Type* type = nullptr;          // type of the expression itself (before conv)
+    Type* convertedType = nullptr; // type after conv; null when conv is None
+    ImplicitConv conv = ImplicitConv::None;
+    bool isLValue = false;
+    Type* valueType() const { return convertedType ? convertedType : type; }
+
     virtual ~Expr() = default;
+    // Node storage is charged to MemTag::Ast for -fmem-report
+    static void* operator new(size_t n) { MemTagScope tag(MemTag::Ast); return ::operator new(n); }
+    static void operator delete(void* p) { ::operator delete(p); }
 };
 
 struct NumberExpr : Expr {
@@ -20,9 +48,17 @@ struct FloatLiteralExpr : Expr {
 
 struct VarExpr : Expr {
     std::string name;
+    int slot = -1;                      // index into Function::slots, or
+    const Function* function = nullptr; // the function it names (not an lvalue)
     explicit VarExpr(std::string n) : name(std::move(n)) {}
 };
 
+struct SizeofExpr : Expr {
+    Type* operand = nullptr; // sizeof(int), sizeof(struct S); null for sizeof(name)
+    std::string name;        // variable or typedef name
+    size_t size = 0;         // computed by semantic analysis
+};
+
 struct StringLiteralExpr : Expr {
     std::string value;
     explicit StringLiteralExpr(std::string v) : value(std::move(v)) {}
@@ -55,6 +91,8 @@ struct AssignExpr : Expr {
 struct CallExpr : Expr {
     std::unique_ptr<Expr> callee; // VarExpr for named function or expression for fn pointer
     std::vector<std::unique_ptr<Expr>> args;
+    const Function* target = nullptr; // direct call to a function in the module
+    SourceLocation loc; // of the callee, naming the call site for -fheap-profile
 };
 
 struct ArrayIndexExpr : Expr {
@@ -65,14 +103,20 @@ struct ArrayIndexExpr : Expr {
 struct MemberExpr : Expr { // base.field
     std::unique_ptr<Expr> base;
     std::string field;
+    size_t fieldIndex = 0; // resolved by semantic analysis
 };
 
 struct PtrMemberExpr : Expr { // base->field
     std::unique_ptr<Expr> base;
     std::string field;
+    size_t fieldIndex = 0; // resolved by semantic analysis
 };
 
-struct Stmt { virtual ~Stmt() = default; };
+struct Stmt {
+    virtual ~Stmt() = default;
+    static void* operator new(size_t n) { MemTagScope tag(MemTag::Ast); return ::operator new(n); }
+    static void operator delete(void* p) { ::operator delete(p); }
+};
 
 struct ExprStmt : Stmt {
     std::unique_ptr<Expr> expr;
@@ -83,6 +127,7 @@ struct VarDeclStmt : Stmt {
     std::string name;
     Type* type = nullptr;
     bool isStatic = false;
+    int slot = -1; // index into Function::slots
     std::unique_ptr<Expr> init; // optional
 };
 
@@ -134,7 +179,17 @@ struct ReturnStmt : Stmt {
     explicit ReturnStmt(std::unique_ptr<Expr> v) : value(std::move(v)) {}
 };
 
-struct FunctionParam { std::string name; Type* type = nullptr; };
+struct FunctionParam { std::string name; Type* type = nullptr; int slot = -1; };
+
+// A parameter or local variable of a function. Semantic analysis gives each
+// declaration its own slot (shadowed names get distinct slots) and points
+// every VarExpr at one.
+struct VarSlot {
+    std::string name;
+    Type* type = nullptr;
+    bool isStatic = false; // lives in a module global
+    int paramIndex = -1;   // >= 0 for parameters
+};
 
 struct Function {
     std::string name;
@@ -143,4 +198,7 @@ struct Function {
     std::vector<FunctionParam> detailedParams; // preferred
     std::unique_ptr<BlockStmt> bodyBlock; // preferred body
     std::vector<std::unique_ptr<Stmt>> body; // legacy body
+    std::vector<VarSlot> slots; // filled in by semantic analysis
+    bool isExtern = false; // 'extern int f(...);': no body, defined in another unit
+    bool reachable = true; // false when main cannot reach it: not checked or emitted
 };
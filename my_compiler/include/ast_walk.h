@@ -0,0 +1,11 @@
+#pragma once
+#include <functional>
+#include "ast.h"
+
+// Pre-order traversal of a function body or any subtree of it: `f` sees a
+// node before its children, statements and expressions in source order.
+void forEachStmt(const Stmt* s, const std::function<void(const Stmt*)>& f);
+void forEachStmt(const Function& fn, const std::function<void(const Stmt*)>& f);
+void forEachExpr(const Expr* e, const std::function<void(const Expr*)>& f);
+void forEachExpr(const Stmt* s, const std::function<void(const Expr*)>& f);
+void forEachExpr(const Function& fn, const std::function<void(const Expr*)>& f);
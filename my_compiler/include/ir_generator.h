@@ -1,11 +1,15 @@
 #pragma once
+#include <functional>
 #include <memory>
+#include <set>
 #include <string>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include "ast.h"
+#include "options.h"
+#include "profile.h"
 
 struct IRValue {
     std::string reg;   // e.g. %t3 or i32 literal folded
@@ -14,44 +18,121 @@ struct IRValue {
 
 class IRGenerator {
 public:
+    // `profile` (from -fprofile-use) must outlive the generator.
+    explicit IRGenerator(const CompilerOptions& opts = CompilerOptions{}, const Profile* profile = nullptr)
+        : opts(opts), profile(profile) {}
     std::string generateModuleIR(const Function& fn);
     std::string generateModuleIR(const std::vector<std::unique_ptr<Function>>& fns);
 
+    // The same module, with the functions arriving one at a time while
+    // earlier ones are emitted (-fpipeline, emit_stream.cpp): `next` yields
+    // them in module order, then null. Emission itself stays in order on
+    // the calling thread; the per-function text passes (value numbering,
+    // peepholes) run on `workers` threads.
+    std::string generateModuleIR(const std::function<const Function*()>& next, int workers);
+
+    // -fbounds-check: array accesses seen and how many of them were proven
+    // in bounds and left unchecked.
+    struct BoundsStats { int accesses = 0; int removed = 0; };
+    const BoundsStats& boundsStats() const { return bounds; }
+
+    // Local value numbering: instructions in the functions as emitted and
+    // as output, and how many redundant loads and recomputed expressions
+    // made up the difference.
+    struct ValueNumberingStats { int before = 0; int after = 0; int loads = 0; int expressions = 0; };
+    const ValueNumberingStats& valueNumberingStats() const { return valueNumbering; }
+
+    // Peephole rewrites: instructions in the functions before and after the
+    // pass, how often each rule fired, in table order, and how many
+    // instructions were left without uses and removed.
+    struct PeepholeStats { int before = 0; int after = 0; int dead = 0; std::vector<std::pair<std::string, int>> rules; };
+    const PeepholeStats& peepholeStats() const { return peepholes; }
+
+    // --whole-program: call sites inlined, functions given internal
+    // linkage and statics turned into constants.
+    struct WholeProgramStats { int inlined = 0; int internalized = 0; int constants = 0; };
+    const WholeProgramStats& wholeProgramStats() const { return wholeProgram; }
+
+    // Stack frames: locals and parameters given storage, the bytes they
+    // would take with an alloca each, and the allocas and bytes emitted
+    // once locals of disjoint scopes share them.
+    struct FrameStats { int locals = 0; long long before = 0; int allocas = 0; long long after = 0; };
+    const FrameStats& frameStats() const { return frames; }
+
+    // Inferred function attributes: functions annotated, those given
+    // internal linkage and fastcc, and how many got each attribute.
+    struct AttributeStats {
+        int functions = 0; int internal = 0; int fastcc = 0;
+        int readnone = 0; int readonly = 0; int willreturn = 0; int norecurse = 0;
+    };
+    const AttributeStats& attributeStats() const { return functionAttrs; }
+
+    // Switch lookup tables: switches emitted, how many became a load from
+    // a constant table, and the entries of those tables.
+    struct SwitchTableStats { int switches = 0; int tables = 0; int entries = 0; };
+    const SwitchTableStats& switchTableStats() const { return switchTables; }
+
 private:
-    struct LoopTargets { std::string continueLabel; std::string breakLabel; };
+    // scopes: how many of FunctionContext::scopes were open at the loop
+    struct LoopTargets { std::string continueLabel; std::string breakLabel; size_t scopes = 0; };
+    struct Interval { long long lo; long long hi; }; // of an i32 value, inclusive
     struct FunctionContext {
         std::ostringstream body;
         std::vector<std::string> entryAllocas; // emitted at function entry
-        std::unordered_map<std::string, std::string> locals; // var -> %alloca
-        std::unordered_map<std::string, std::string> localTypes; // var -> IR type (i32/i8/[N x i32])
+        const Function* node = nullptr;
+        std::vector<std::string> slotAddr; // Function::slots index -> %alloca or @global
         int tempCounter = 0;
         int blockCounter = 0;
         std::string currentLabel;
         bool currentTerminated = false;
         std::vector<LoopTargets> loopStack;
         std::unordered_map<std::string, std::string> labelMap; // user label -> llvm label
-        std::unordered_map<std::string, size_t> localArrayLen; // local arrays length by name
-        std::unordered_map<std::string, std::string> localArrayElem; // name -> element IR type (i32/i8)
-        std::unordered_map<std::string, std::string> localStructName; // name -> struct tag
+        std::unordered_map<int, Interval> ranges; // slot -> values it can hold here
+        std::unordered_set<int> addressTaken;     // slots whose ranges cannot be tracked (or loops unrolled over)
+        bool rangeFacts = false; // false with goto labels: a jump can skip a loop's condition
+        std::string trapLabel; // shared failure block of the bounds checks
+        std::unordered_map<const CallExpr*, std::string> stackAllocs; // malloc -> entry alloca standing in for it
+        std::unordered_set<int> stackSlots; // pointers that only hold those allocas: free() on them is dropped
+        // stack coloring: the block and for scopes being emitted, and the
+        // allocas of scopes already left, by IR type, free for reuse
+        struct Scope { std::vector<int> slots; std::vector<std::pair<std::string, size_t>> markers; }; // i8* and size of each aggregate
+        bool colorSlots = false; // false with goto labels: a jump can enter a scope past its lifetime.start
+        std::vector<Scope> scopes;
+        std::unordered_map<std::string, std::vector<std::string>> freeSlots;
+        int hookId = -1; // -finstrument-functions: the function's index in instrumented
     };
 
+    CompilerOptions opts;
+    const Profile* profile;
+
     // Module-level globals for string literals
     std::unordered_map<std::string, std::string> strToGlobal;
     std::vector<std::string> globalDefs;
-    std::unordered_map<std::string, std::string> globalVars; // name -> @g
-    std::unordered_map<std::string, std::string> globalVarTypes; // name -> IR type (i32/i8)
-    std::unordered_map<std::string, std::string> globalStructName; // name -> struct tag
-    // Function signatures for inter-proc calls
-    std::unordered_map<std::string, std::vector<std::string>> funcParamIR; // name -> param IR types
-    std::unordered_map<std::string, std::string> funcRetIR;               // name -> return IR type
-    bool usedMalloc = false;
-    bool usedFree = false;
-    std::unordered_set<std::string> usedFunctions;
+    std::unordered_map<std::string, std::string> globalVars; // static name -> @g
     std::unordered_set<std::string> usedStructs;
     std::vector<std::string> structTypeDefs;
+    std::set<std::string> libcDecls;      // "declare ..." lines for the C library functions called
+    std::set<std::string> intrinsicDecls; // and for llvm.* intrinsics
+    std::set<std::string> externDecls;    // and for the extern functions referenced
+    std::vector<std::string> metadata;    // !N = the N-th entry
+    std::unordered_map<std::string, std::string> tbaaNodes; // TBAA type or access tag -> its !N
+    std::vector<std::string> profileCounters; // "function label[/taken]" of @__prof.c.N
+    std::vector<std::string> instrumented;    // -finstrument-functions: names of the functions with hooks, by id
+    std::vector<std::string> heapSites;       // -fheap-profile: "function:line:column" of each malloc, by id
+    std::string unlikelyWeights; // metadata for branches that should almost never be taken
+    BoundsStats bounds;
+    ValueNumberingStats valueNumbering;
+    PeepholeStats peepholes;
+    WholeProgramStats wholeProgram;
+    FrameStats frames;
+    AttributeStats functionAttrs;
+    SwitchTableStats switchTables;
 
-    // Expressions/statements
+    // Expressions/statements. Both expression emitters rely on the
+    // annotations from semanticCheckModule: emitExpr yields the value after
+    // the expression's implicit conversion, emitValue the value before it.
     IRValue emitExpr(const Expr* e, FunctionContext& fn);
+    IRValue emitValue(const Expr* e, FunctionContext& fn);
     void emitStmt(const Stmt* s, FunctionContext& fn);
     void emitBlock(const BlockStmt* blk, FunctionContext& fn);
     void emitFunctionPrologue(const Function& fnNode, FunctionContext& fn);
@@ -63,13 +144,137 @@ private:
     void startBlock(FunctionContext& fn, const std::string& label);
     void branch(FunctionContext& fn, const std::string& target);
     void cbranch(FunctionContext& fn, const IRValue& cond, const std::string& tlabel, const std::string& flabel);
-    IRValue toBool(const IRValue& v, FunctionContext& fn);
-    std::string ensureAlloca(const std::string& name, FunctionContext& fn);
+    IRValue toBool(const IRValue& v, const Type* t, FunctionContext& fn);
+    std::string slotAddress(int slot, FunctionContext& fn);
     IRValue lvalueAddress(const Expr* e, FunctionContext& fn);
-    IRValue getStringPtr(const std::string& s, FunctionContext& fn);
+    IRValue getStringPtr(const std::string& s);
     std::string getOrCreateLabel(FunctionContext& fn, const std::string& userLabel);
     std::string sanitizeGlobal(const std::string& name) { return "@" + name; }
-    void ensureStructType(const std::string& name);
-    std::string typeToIR(Type* t);
-    IRValue ensureCast(const IRValue& v, const std::string& toType, FunctionContext& fn);
+    void ensureStructType(const Type* st);
+    std::string typeToIR(const Type* t);
+    IRValue convertValue(const IRValue& v, const Expr* e, FunctionContext& fn);
+    void beginFunction(const Function& fnNode, FunctionContext& fn);
+    // emitFunction = finishFunction(draftFunction(...)). The draft is the
+    // function as emitted, up to the text passes: the "define ... entry:"
+    // head with the allocas, and the body. Only drafting touches module
+    // state; finishing can run on another IRGenerator.
+    struct FunctionDraft {
+        const Function* node;
+        std::string head;
+        std::string body;
+        int temps; // FunctionContext::tempCounter
+        std::vector<std::string> allocas;
+    };
+    std::string emitFunction(const Function& fnNode);
+    FunctionDraft draftFunction(const Function& fnNode);
+    std::string finishFunction(FunctionDraft& draft);
+    std::string moduleText(const std::string& functions);
+    std::string addMetadata(const std::string& node);
+    void declareExtern(const Function* f);
+
+    // Profiling (profile.cpp). With -fprofile-generate every block and
+    // conditional branch bumps a counter that a destructor writes out at
+    // exit; with -fprofile-use the counts become branch weights, from which
+    // llc places the blocks, and functions that never ran are marked cold.
+    void countBlock(FunctionContext& fn);
+    void countTaken(const IRValue& cond, FunctionContext& fn);
+    std::string branchWeights(const FunctionContext& fn);
+    std::string functionAttributes(const Function& fnNode);
+    std::string profileRuntime();
+
+    // Function instrumentation (profile.cpp). With -finstrument-functions
+    // every function calls an enter hook after its prologue and an exit
+    // hook before each ret; the runtime times the calls from the cycle
+    // counter and writes collapsed stacks and a per-function table at exit.
+    void instrumentEntry(FunctionContext& fn);
+    void instrumentExit(FunctionContext& fn);
+    std::string instrumentRuntime();
+
+    // Heap profiling (profile.cpp). With -fheap-profile malloc and free go
+    // through a runtime that keeps per-call-site counts, a size histogram,
+    // live and peak bytes and a sampled timeline of live bytes, and writes
+    // them with the blocks still live (leaks) at exit. heapSite gives the
+    // id of a malloc's call site.
+    int heapSite(const CallExpr* call, const FunctionContext& fn);
+    std::string heapRuntime();
+
+    // TBAA metadata (tbaa.cpp): ", !tbaa !N" for a load or store of the
+    // lvalue, or of a whole object of type t, and "" when there is no tag.
+    std::string tbaaTag(const Expr* lvalue);
+    std::string tbaaTag(const Type* t);
+    std::string tbaaTag(const std::string& base, const std::string& access, size_t offset);
+    std::string tbaaScalar(const Type* t);
+    std::string tbaaStruct(const Type* st);
+    std::string tbaaNode(const std::string& key, const std::string& node);
+
+    // Bounds checking (bounds_check.cpp). Index ranges come from constants,
+    // locals that only ever hold one constant and the induction variables of
+    // counted for loops; accesses they prove in bounds get no check.
+    void analyzeRanges(const Function& fnNode, FunctionContext& fn);
+    Interval rangeOf(const Expr* e, const FunctionContext& fn) const;
+    bool inductionRange(const ForStmt* f, const FunctionContext& fn, int& slot, Interval& range) const;
+    void checkBounds(const ArrayIndexExpr* a, const IRValue& index, FunctionContext& fn);
+    void emitTrap(FunctionContext& fn);
+
+    // Escape analysis (escape_analysis.cpp): fills stackAllocs/stackSlots
+    // for malloc'd blocks of constant size whose pointer never leaves the
+    // function.
+    void findStackAllocations(const Function& fnNode, FunctionContext& fn);
+
+    // Stack slot coloring (stack_coloring.cpp). The locals of a block or for
+    // scope get their allocas when it is entered, taking those of a sibling
+    // scope already left if the type matches, and give them back when it
+    // is left; arrays and structs are bracketed by llvm.lifetime markers.
+    void openScope(const Stmt* owner, FunctionContext& fn);
+    void closeScope(FunctionContext& fn);
+    void endScopes(size_t keep, FunctionContext& fn);
+
+    // Local value numbering (value_numbering.cpp) over a function body as
+    // emitted: drops instructions that recompute a value already available
+    // in their block, and loads of a location whose value is known.
+    std::string numberValues(const std::string& body, const FunctionContext& fn);
+
+    // Peephole rewrites (peephole.cpp) over a function body after value
+    // numbering, from a table of rules, then removal of what became unused.
+    std::string applyPeepholes(const std::string& body, const FunctionContext& fn);
+
+    // Whole-program optimization (whole_program.cpp): inlining, constant
+    // statics and internal linkage over the text of every function in the
+    // module, which must be all of the program.
+    struct FunctionText { std::string name; std::string text; };
+    void optimizeWholeProgram(std::vector<FunctionText>& functions);
+
+    // Function attributes and linkage (function_attrs.cpp): nounwind,
+    // readnone/readonly, willreturn and norecurse inferred over the whole
+    // module, internal linkage and fastcc for what it does not export, on
+    // the define lines and the calls.
+    void inferFunctionAttributes(std::vector<FunctionText>& functions);
+
+    // Module state is reset by beginModule; finishModule runs the module
+    // passes over the emitted functions and assembles the module text.
+    void beginModule();
+    std::string finishModule(std::vector<FunctionText>& program);
+
+    // Loop vectorizer (loop_vectorizer.cpp). For a counted for loop over
+    // local arrays, runs its init and then a vector loop over as many whole
+    // vectors as fit, leaving the induction variable where the scalar loop
+    // must pick up the remaining iterations. False (nothing emitted) if the
+    // loop does not qualify.
+    struct VectorLoop;
+    bool vectorizeFor(const ForStmt* f, FunctionContext& fn);
+    IRValue emitVector(const Expr* e, const VectorLoop& loop, FunctionContext& fn);
+    IRValue vectorElementAddress(const ArrayIndexExpr* a, const VectorLoop& loop, FunctionContext& fn);
+
+    // Switch lookup tables (switch_table.cpp). Called for a switch once its
+    // value `v` is emitted: a dense switch whose cases only return or assign
+    // one variable constants is emitted as a load from a constant table
+    // (true). False (nothing emitted) if it does not qualify.
+    bool switchTable(const SwitchStmt* sw, const IRValue& v, FunctionContext& fn);
+
+    // Loop unrolling (loop_unroll.cpp). Called for a counted for loop once
+    // its init has run; `body` emits one copy of its body. A loop with a
+    // small constant trip count is replaced by copies of body and step
+    // (true). Otherwise a loop running several copies per test may be
+    // emitted, leaving the iterations it did not run to the loop (false).
+    bool unrollFor(const ForStmt* f, FunctionContext& fn, const std::function<void()>& body);
 };
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers for the passes that rewrite generated IR as text
+// (value_numbering.cpp, peephole.cpp, whole_program.cpp, function_attrs.cpp). They only understand the
+// shapes IRGenerator itself prints: one instruction per line indented by
+// two spaces, labels in column 0, switch cases indented by four.
+
+// "  %r = op ..." or "  op ...": r (or "") and the text from op on.
+struct IRInst {
+    std::string_view result;
+    std::string_view text;
+    std::string_view op() const { return text.substr(0, text.find(' ')); }
+};
+
+// False for labels, switch case lines and the switch's closing bracket.
+bool parseIRInst(std::string_view line, IRInst& inst);
+
+// The n-th operand of an instruction, counting top-level commas; "" if it
+// has fewer.
+std::string_view irOperand(std::string_view text, int n);
+
+// The "T* P" operand of a load or store, or "" for anything else.
+std::string_view irLocation(const IRInst& inst);
+
+// The direct callee of a call instruction ("f" for "call i32 @f(..."), or
+// "" for anything else, indirect calls included.
+std::string_view irDirectCallee(const IRInst& inst);
+
+// N for a "%tN" name, else -1. Every value IRGenerator names is a %tN.
+int irTempIndex(std::string_view name);
+
+// True for opcodes whose result depends on their operands alone and that
+// have no other effect.
+bool irPure(std::string_view op);
+
+// Tarjan's algorithm over a call graph given as each function's callees:
+// `order` lists the functions with callees before callers (the members of
+// a strongly connected component together), and `recursive` marks those
+// in a cycle or calling themselves.
+void callGraphOrder(const std::vector<std::vector<size_t>>& calls, std::vector<size_t>& order, std::vector<bool>& recursive);
+
+inline bool irNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '_';
+}
+
+// Calls f(begin, end) for every %name in line (values, labels and types).
+template <typename F>
+void forEachLocalName(std::string_view line, F f) {
+    for (size_t i = 0; i < line.size(); ++i) {
+        if (line[i] != '%') continue;
+        size_t j = i + 1;
+        while (j < line.size() && irNameChar(line[j])) ++j;
+        f(i, j);
+        i = j - 1;
+    }
+}
+
+// Calls f(N, begin, end) for every %tN in line.
+template <typename F>
+void forEachTemp(std::string_view line, F f) {
+    forEachLocalName(line, [&](size_t b, size_t e) {
+        if (int n = irTempIndex(line.substr(b, e - b)); n >= 0) f(n, b, e);
+    });
+}
+
+// Appends line to out with every %tN that has a non-empty to[N] replaced
+// by it; false (nothing appended) if it names none of them.
+bool renameTemps(std::string_view line, const std::vector<std::string>& to, std::string& out);
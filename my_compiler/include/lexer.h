@@ -1,22 +1,41 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include "error_handler.h"
 
 struct Token {
     enum Kind {
-        End, Identifier, Number, KwInt, KwReturn, Plus, Minus, Star, Slash, LParen, RParen, LBrace, RBrace, Semicolon, Assign
+        End, Identifier, Number, KwInt, KwReturn, Plus, Minus, Star, Slash, LParen, RParen, LBrace, RBrace, Semicolon, Assign,
+        FloatLiteral, StringLiteral,
+        KwFloat, KwChar, KwVoid, KwStruct, KwTypedef, KwStatic, KwExtern, KwSizeof,
+        KwIf, KwElse, KwWhile, KwFor, KwDo, KwSwitch, KwCase, KwDefault, KwBreak, KwContinue, KwGoto,
+        Percent, Amp, Pipe, Caret, Bang, Tilde, Less, Greater, LessEq, GreaterEq, EqEq, NotEq,
+        AndAnd, OrOr, Shl, Shr, Arrow, Dot, Comma, Colon, LBracket, RBracket,
+        Unknown // any other byte; lexeme holds it
     } kind = End;
-    std::string lexeme;
+    // Points into the source buffer handed to the Lexer; no copies are made.
+    // String literals exclude the quotes and keep their escapes, like lexer.l.
+    std::string_view lexeme;
+    long intValue = 0; // Number: decimal value or character literal code
     SourceLocation loc;
 };
 
+// Hand-written scanner for the full token set of lexer.l. Whitespace,
+// comments, identifiers and numbers are scanned with SSE2/AVX2 when the
+// target has them. The source must outlive the Lexer and its tokens.
 class Lexer {
 public:
-    explicit Lexer(const std::string& input);
+    explicit Lexer(std::string_view input);
     Token next();
 private:
-    const std::string input;
+    std::string_view input;
     size_t index = 0;
     int line = 1;
-    int column = 1;
+    size_t lineStart = 0; // offset of the first byte of the current line
+
+    void skipTrivia();
+    void newlinesIn(size_t from, size_t to);
 };
+
+// Name of a token kind for diagnostics and token dumps.
+const char* tokenKindName(Token::Kind k);
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+// Subsystems that allocation accounting is attributed to. Every global
+// operator new is charged to the tag that is current on the calling thread.
+enum class MemTag {
+    Other,
+    Parser,          // bison %union vectors and other parse-time scratch
+    Ast,             // Expr/Stmt nodes
+    Types,           // Type pools in type_system.h
+    Sema,            // semantic scopes and tables
+    FunctionContext, // per-function IR emission state (maps, body buffer)
+    IRText,          // module-level IR text assembly
+    Count
+};
+
+// Switches the current allocation tag for the lifetime of the scope.
+class MemTagScope {
+public:
+    explicit MemTagScope(MemTag tag);
+    ~MemTagScope();
+    MemTagScope(const MemTagScope&) = delete;
+    MemTagScope& operator=(const MemTagScope&) = delete;
+private:
+    MemTag prev;
+};
+
+// Allocation accounting backing -fmem-report. Counters are always live (the
+// replacement operator new is cheap); phases and functions only record
+// snapshots so the report can attribute bytes to them.
+class MemStats {
+public:
+    static void enable();
+    static bool enabled();
+
+    // Phases are sequential; beginning a phase closes the previous one.
+    static void beginPhase(const std::string& name);
+    static void endPhase();
+
+    // Attributes allocations made between begin/end to a function name.
+    // Calls for the same name accumulate (sema + IR emission).
+    static void beginFunction(const std::string& name);
+    static void endFunction();
+
+    static size_t liveBytes();
+    static size_t peakBytes();
+
+    static void report(std::ostream& os);
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+// Options taken from the mycc command line that change what is compiled,
+// as opposed to what is reported.
+struct CompilerOptions {
+    bool reorderStructFields = false; // -freorder-struct-fields
+    bool vectorize = false;           // -fvectorize
+    bool unrollLoops = false;         // -funroll-loops
+    bool boundsCheck = false;         // -fbounds-check
+    bool heapToStack = true;          // -fno-heap-to-stack turns off malloc -> alloca
+    bool valueNumbering = true;       // -fno-cse turns off local value numbering
+    bool deadFunctions = true;        // -fno-dead-functions emits functions main cannot reach
+    bool constEval = true;            // -fno-const-eval leaves calls to pure functions to run time
+    bool switchTables = true;         // -fno-switch-tables emits every switch as a switch instruction
+    bool stackColoring = true;        // -fno-stack-coloring gives every local an alloca of its own
+    bool wrapv = false;               // -fwrapv: signed overflow wraps, so no nsw on int arithmetic
+    bool strictAliasing = true;       // -fno-strict-aliasing: no TBAA metadata on loads and stores
+    bool functionAttrs = true;        // -fno-function-attrs: no inferred attributes, internal linkage or fastcc
+    bool peephole = true;             // -fno-peephole turns off the peephole rewrites
+    bool wholeProgram = false;        // --whole-program: the input files are the entire program
+    bool pipeline = false;            // -fpipeline: parse, check and emit concurrently (pipeline.h)
+    std::string profileGenerate;      // -fprofile-generate[=file]: where the program writes its counts
+    std::string profileUse;           // -fprofile-use=file
+    std::string instrumentFunctions;  // -finstrument-functions[=file]: where the program writes its collapsed stacks
+    std::string heapProfile;          // -fheap-profile[=file]: where the program writes its heap report
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -6,24 +7,66 @@
 #include "ast.h"
 #include "error_handler.h"
 
+// Recursive-descent parser for the language of parser.y, with a Pratt loop
+// for binary operators. It builds the same AST bison does (and registers
+// typedefs and struct fields in the same globals), but blocks and case
+// bodies take any number of statements. Lists are collected on scratch
+// stacks shared by all nesting levels and moved into exactly-sized vectors,
+// so parsing allocates little beyond the AST itself.
 class Parser {
 public:
     Parser(Lexer& lexer, ErrorHandler& err) : lexer(lexer), err(err) {
         current = this->lexer.next();
     }
 
+    // translation_unit: appends every function to `out`. Stops at the first
+    // syntax error; returns false if one was reported.
+    bool parseTranslationUnit(std::vector<std::unique_ptr<Function>>& out);
+    // The same, handing each function to `done` as soon as it is parsed.
+    bool parseTranslationUnit(const std::function<void(std::unique_ptr<Function>)>& done);
     std::unique_ptr<Function> parseFunction();
 
 private:
     Lexer& lexer;
     ErrorHandler& err;
     Token current;
+    Token ahead;             // second token of lookahead, valid if hasAhead
+    bool hasAhead = false;
+    bool failed = false;     // only the first syntax error is reported
 
-    void advance() { current = lexer.next(); }
+    std::vector<std::unique_ptr<Stmt>> stmtScratch;
+    std::vector<std::unique_ptr<Expr>> exprScratch;
+
+    void advance() {
+        if (hasAhead) { current = ahead; hasAhead = false; }
+        else current = lexer.next();
+    }
+    const Token& peek() {
+        if (!hasAhead) { ahead = lexer.next(); hasAhead = true; }
+        return ahead;
+    }
     bool accept(Token::Kind k) { if (current.kind == k) { advance(); return true; } return false; }
     bool expect(Token::Kind k, const char* what);
+    void syntaxError(const char* what);
+    std::string takeIdentifier(const char* what);
+
+    bool parseParams(std::vector<FunctionParam>& params);
+    std::unique_ptr<BlockStmt> parseBlock();
+    void parseStmtsUntil(Token::Kind a, Token::Kind b, Token::Kind c, std::vector<std::unique_ptr<Stmt>>& out);
+    std::unique_ptr<Stmt> parseStmt();
+    std::unique_ptr<Stmt> parseDeclaration();
+    std::unique_ptr<Stmt> parseTypedef();
+    std::unique_ptr<Stmt> parseStruct();
+    std::unique_ptr<Stmt> parseIf();
+    std::unique_ptr<Stmt> parseWhile();
+    std::unique_ptr<Stmt> parseDoWhile();
+    std::unique_ptr<Stmt> parseFor();
+    std::unique_ptr<Stmt> parseSwitch();
 
     std::unique_ptr<Expr> parseExpression();
-    std::unique_ptr<Expr> parseTerm();
-    std::unique_ptr<Expr> parseFactor();
+    std::unique_ptr<Expr> parseOptExpression(Token::Kind terminator);
+    std::unique_ptr<Expr> parseBinary(int minPrec);
+    std::unique_ptr<Expr> parseUnary();
+    std::unique_ptr<Expr> parsePostfix();
+    std::unique_ptr<Expr> parsePrimary();
 };
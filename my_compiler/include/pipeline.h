@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ir_generator.h"
+#include "options.h"
+#include "semantic.h"
+
+// Pipelined compilation (-fpipeline). The parser runs on the calling thread
+// and hands each function, as soon as it is complete, through a bounded
+// queue to a sema thread (IncrementalChecker), which passes the checked
+// functions on through a second queue to IR emission on a third thread
+// (IRGenerator::generateModuleIR with a `next` callback). Everything stays
+// in module order, so `ir` is the module the serial driver would write.
+//
+// Calls with constant arguments are folded (ConstEvaluator) on the sema
+// thread as functions are released, which is in module order as in the
+// serial driver; a call whose callee reaches a function not released yet
+// sends the module the serial way.
+//
+// Dead function elimination needs the whole call graph. A token scan of the
+// sources (scanReachableFunctions) runs alongside the parser and tells the
+// sema stage which functions to skip; it may keep a few too many, and then
+// the reachable ones are emitted again at the end.
+//
+// Serial: the stream met something only a check of the whole module can
+// settle (any diagnostic among them). Nothing was printed; the caller
+// clears g_functions and compiles the sources the serial way, which
+// reports exactly what it always does.
+// ParseFailed: the parse errors were printed as the serial driver does.
+enum class PipelineResult { Done, ParseFailed, Serial };
+
+PipelineResult compilePipelined(const std::vector<std::string>& sources, const std::vector<std::string>& paths,
+                                const CompilerOptions& opts, IRGenerator& irgen, ConstEvaluator& constEval,
+                                std::string& ir);
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Execution counts written by a -fprofile-generate build, read back for
+// -fprofile-use. The file has one "function label count" line per basic
+// block, plus "function label/taken count" for each block ending in a
+// conditional branch (how often the branch went to its true successor).
+// Labels are numbered in emission order, so a profile only matches the same
+// source compiled with the same options.
+class Profile {
+public:
+    // False with `error` set if the file cannot be read or is malformed.
+    bool load(const std::string& path, std::string& error);
+    // -1 if the block is not in the profile.
+    long long count(const std::string& function, const std::string& label) const;
+    long long taken(const std::string& function, const std::string& label) const;
+    bool hasFunction(const std::string& function) const { return functions.count(function) != 0; }
+
+private:
+    std::unordered_map<std::string, long long> counts; // "function label[/taken]" -> count
+    std::unordered_set<std::string> functions;
+};
@@ -1,14 +1,99 @@
 #pragma once
 #include "ast.h"
 #include "error_handler.h"
+#include "options.h"
+#include <memory>
+#include <unordered_set>
 
-// Performs semantic validation on a single function (legacy helper)
-void semanticCheck(const Function& fn, ErrorHandler& err);
+// Performs semantic validation on a single function (legacy helper); calls
+// may only target the function itself
+void semanticCheck(Function& fn, ErrorHandler& err);
 
 // Performs full module-level semantic validation:
 // - variable declarations and scopes
 // - type inference/checking for expressions, implicit casts
 // - array-to-pointer decay, pointer arithmetic scaling, member access
+// - struct layouts (see struct_layout.h) and sizeof
 // - function signature checking (arity and types)
 // - typedef-based declarations (ints, function pointers)
-void semanticCheckModule(const std::vector<std::unique_ptr<Function>>& fns, ErrorHandler& err);
+// Every Expr is annotated with its type, lvalue-ness and implicit
+// conversion, and every VarExpr with its slot in Function::slots; the IR
+// generator relies on these annotations.
+void semanticCheckModule(const std::vector<std::unique_ptr<Function>>& fns, ErrorHandler& err,
+                         const CompilerOptions& opts = CompilerOptions{});
+
+// Dead function elimination (call_graph.cpp): sets Function::reachable on
+// the functions main reaches through calls or by taking their address. In
+// a unit without main every function stays reachable. semanticCheckModule
+// calls this unless -fno-dead-functions is given.
+void markReachableFunctions(const std::vector<std::unique_ptr<Function>>& fns);
+
+// The same walk over the tokens of the sources, before they are parsed:
+// every identifier in a function's body counts as an edge. That is a
+// superset of the names markReachableFunctions follows, so the functions
+// it marks are all in the returned set of names.
+std::unordered_set<std::string> scanReachableFunctions(const std::vector<std::string>& sources);
+
+// Compile-time evaluation (const_eval.cpp). A function is pure when it
+// returns int, takes int and char parameters, keeps its state in int and
+// char locals and arrays of them (no statics, nothing whose address is
+// taken) and calls only pure functions of the module: no I/O, malloc or
+// calls through pointers. fold replaces each call to a pure function whose
+// arguments are all constant with the value an interpreter over the AST
+// computes, within a step and a memory budget; a call that runs out of
+// either, divides by zero, shifts out of range, indexes out of bounds or
+// reads an uninitialized local is left to run at run time. Results are
+// cached by function and arguments, recursive calls included.
+//
+// add makes a checked function available to evaluation. The serial driver
+// adds every checked function before folding any; the pipelined one adds
+// functions as the checker releases them, and fold returns false when a
+// call's callee reaches a function that was not added yet.
+struct ConstEvalStats {
+    int pure = 0;      // functions found pure
+    int folded = 0;    // calls replaced by their value
+    int cached = 0;    // of those, answered from the cache
+    int givenUp = 0;   // calls with constant arguments left alone
+};
+
+class ConstEvaluator {
+public:
+    ConstEvaluator();
+    ~ConstEvaluator();
+    ConstEvaluator& operator=(ConstEvaluator&&) noexcept;
+    void add(const Function& fn);
+    bool fold(Function& fn);
+    const ConstEvalStats& stats() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+// Checking for the pipelined driver (-fpipeline, pipeline.h): functions are
+// added in module order as the parser finishes them and checked on arrival,
+// with the struct layouts from layoutNewStructs. A call to a function that
+// has no definition yet keeps its signature lookup pending until the
+// definition arrives (or, for an extern declaration, until finish), and a
+// function is released to code generation once none of its calls are
+// pending. Functions are released in the order they were added.
+//
+// Functions whose `reachable` flag is already false (the driver sets it
+// from scanReachableFunctions) are declared but not checked. Anything that
+// needs the whole module, and any error, sets needsSerialCheck(): the
+// driver then starts over with semanticCheckModule, which reports what it
+// always does.
+class IncrementalChecker {
+public:
+    IncrementalChecker();
+    ~IncrementalChecker();
+    // Checks fn and appends the functions that became ready to `ready`.
+    void add(Function& fn, std::vector<Function*>& ready);
+    // After the last add: binds the calls still pending and releases the rest.
+    void finish(std::vector<Function*>& ready);
+    bool needsSerialCheck() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
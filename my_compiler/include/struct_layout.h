@@ -0,0 +1,21 @@
+#pragma once
+#include "type_system.h"
+
+// Byte size and alignment of a type on the 64-bit target LLVM assumes when
+// the module has no datalayout: i8 1, i32/float 4, pointers 8. A struct
+// without a layout has size 0.
+size_t sizeOf(const Type* t);
+size_t alignOf(const Type* t);
+
+// Builds (or rebuilds) the StructLayout of every struct the parser
+// registered in g_struct_field_types. Fields normally stay in declaration
+// order with natural padding, as in C; with reorderFields they are placed by
+// decreasing alignment, which removes padding between fields.
+void layoutStructs(bool reorderFields);
+
+// The pipelined driver's version, called on the parser thread between
+// functions: lays out only the structs registered since the last call, so
+// the layouts earlier functions were checked against never change. False
+// if one of those structs was since redefined, which layoutStructs (run at
+// the end of parsing) would have applied to every function.
+bool layoutNewStructs(bool reorderFields);
@@ -1,18 +1,49 @@
 #pragma once
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 struct SymbolInfo {
-    std::string typeName;
+    int slot = -1; // index into Function::slots
 };
 
+// Block-scoped name -> SymbolInfo map. A single open-addressed table holds
+// every name seen so far; each entry points at its innermost live binding
+// and each binding at the one it shadows. Bindings double as the undo log:
+// popScope unwinds them back to the mark taken by pushScope. Lookup is one
+// probe sequence at any nesting depth and pushScope does not allocate.
 class SymbolTable {
 public:
     void pushScope();
     void popScope();
-    bool declare(const std::string& name, const SymbolInfo& info);
-    const SymbolInfo* lookup(const std::string& name) const;
+    // False if `name` is already declared in the innermost scope.
+    bool declare(std::string_view name, const SymbolInfo& info);
+    const SymbolInfo* lookup(std::string_view name) const;
+    // Pops every scope. Names stay interned so the next function reuses them.
+    void clear();
+    size_t depth() const { return scopeMarks.size(); }
+
 private:
-    std::vector<std::unordered_map<std::string, SymbolInfo>> scopes;
+    struct Entry {
+        std::string name;
+        uint32_t hash = 0;
+        int binding = -1; // innermost live binding, -1 if none
+        bool occupied = false;
+    };
+    struct Binding {
+        SymbolInfo info;
+        uint32_t entry;   // owning Entry
+        int shadowed;     // binding this one hides, -1 if none
+        uint32_t depth;   // scope depth it was declared at
+    };
+
+    std::vector<Entry> entries;     // power-of-two capacity, at most half full
+    size_t occupiedEntries = 0;
+    std::vector<Binding> bindings;  // in declaration order: the undo log
+    std::vector<size_t> scopeMarks; // bindings.size() at each pushScope
+
+    static uint32_t hashName(std::string_view name);
+    size_t probe(std::string_view name, uint32_t hash) const; // matching or free entry
+    void grow();
 };
@@ -0,0 +1,8 @@
+#pragma once
+#include "lexer.h"
+#include "parser.tab.hh"
+
+// Maps a hand-lexer token to the bison token code and fills lval the way
+// lexer.l does: identifiers, float and string literals are strdup'd (the
+// grammar actions free them), numbers and character literals go in ival.
+int bisonTokenFor(const Token& tok, YYSTYPE& lval);
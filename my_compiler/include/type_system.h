@@ -1,6 +1,10 @@
 #pragma once
 #include <string>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
+#include "mem_stats.h"
 
 enum class TypeKind {
     Int,
@@ -13,7 +17,23 @@ enum class TypeKind {
     Function
 };
 
-struct StructField { std::string name; size_t index = 0; struct Type* type = nullptr; };
+struct StructField {
+    std::string name;
+    size_t index = 0;  // position in the emitted LLVM struct type
+    struct Type* type = nullptr;
+    size_t offset = 0; // bytes from the start of the struct
+};
+
+// Memory layout of a struct, computed by layoutStructs (struct_layout.h).
+// Fields keep declaration order; `index` says where each one sits in memory.
+struct StructLayout {
+    std::vector<StructField> fields;
+    std::unordered_map<std::string, size_t> byName; // field name -> fields index
+    std::vector<size_t> memoryOrder;                // fields indices by offset
+    size_t size = 0;    // rounded up to align, as sizeof reports it
+    size_t align = 1;
+    size_t padding = 0; // bytes of size not covered by a field
+};
 
 struct Type {
     TypeKind kind;
@@ -21,7 +41,8 @@ struct Type {
     std::vector<Type*> params;       // for Function: parameter types
     size_t arrayLength = 0;          // for Array
     std::string structName;          // for Struct
-    std::vector<StructField> fields; // for Struct
+    StructLayout* layout = nullptr;  // for Struct: null until defined
+    Type* pointerType = nullptr;     // canonical PointerTo(this), created on first use
 
     static Type* Int();
     static Type* Char();
@@ -30,15 +51,30 @@ struct Type {
     static Type* PointerTo(Type* elem);
     static Type* ArrayOf(Type* elem, size_t len);
     static Type* FunctionOf(Type* ret, const std::vector<Type*>& params);
-    static Type* StructNamed(const std::string& name, const std::vector<StructField>& fields);
+    static Type* StructNamed(const std::string& name); // one Type per struct name
 };
 
-// Simple global type singletons
+// Simple global type singletons. The pools are shared by the parser and
+// sema threads under -fpipeline, so growing them (and filling a pointer
+// type cache) takes a lock.
+inline std::mutex& typePoolMutex() { static std::mutex m; return m; }
 inline Type* Type::Int() { static Type t{TypeKind::Int}; return &t; }
 inline Type* Type::Char() { static Type t{TypeKind::Char}; return &t; }
 inline Type* Type::Float() { static Type t{TypeKind::Float}; return &t; }
 inline Type* Type::Void() { static Type t{TypeKind::Void}; return &t; }
-inline Type* Type::PointerTo(Type* elem) { static std::vector<Type> pool; pool.push_back(Type{TypeKind::Pointer}); pool.back().element = elem; return &pool.back(); }
-inline Type* Type::ArrayOf(Type* elem, size_t len) { static std::vector<Type> pool; pool.push_back(Type{TypeKind::Array}); pool.back().element = elem; pool.back().arrayLength = len; return &pool.back(); }
-inline Type* Type::FunctionOf(Type* ret, const std::vector<Type*>& params) { static std::vector<Type> pool; pool.push_back(Type{TypeKind::Function}); pool.back().element = ret; pool.back().params = params; return &pool.back(); }
-inline Type* Type::StructNamed(const std::string& name, const std::vector<StructField>& fields) { static std::vector<Type> pool; pool.push_back(Type{TypeKind::Struct}); pool.back().structName = name; pool.back().fields = fields; return &pool.back(); }
+inline Type* Type::PointerTo(Type* elem) {
+    std::lock_guard<std::mutex> lock(typePoolMutex());
+    if (elem && elem->pointerType) return elem->pointerType;
+    MemTagScope tag(MemTag::Types); static std::deque<Type> pool; pool.push_back(Type{TypeKind::Pointer}); pool.back().element = elem;
+    if (elem) elem->pointerType = &pool.back();
+    return &pool.back();
+}
+inline Type* Type::ArrayOf(Type* elem, size_t len) { std::lock_guard<std::mutex> lock(typePoolMutex()); MemTagScope tag(MemTag::Types); static std::deque<Type> pool; pool.push_back(Type{TypeKind::Array}); pool.back().element = elem; pool.back().arrayLength = len; return &pool.back(); }
+inline Type* Type::FunctionOf(Type* ret, const std::vector<Type*>& params) { std::lock_guard<std::mutex> lock(typePoolMutex()); MemTagScope tag(MemTag::Types); static std::deque<Type> pool; pool.push_back(Type{TypeKind::Function}); pool.back().element = ret; pool.back().params = params; return &pool.back(); }
+inline Type* Type::StructNamed(const std::string& name) {
+    std::lock_guard<std::mutex> lock(typePoolMutex());
+    MemTagScope tag(MemTag::Types); static std::deque<Type> pool; static std::unordered_map<std::string, Type*> byName;
+    Type*& t = byName[name];
+    if (!t) { pool.push_back(Type{TypeKind::Struct}); pool.back().structName = name; t = &pool.back(); }
+    return t;
+}
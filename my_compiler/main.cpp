@@ -4,76 +4,220 @@
 #include <sstream>
 #include "error_handler.h"
 #include "lexer.h"
+#include "parser.h"
 #include "parser.tab.hh"
 #include "ir_generator.h"
 #include "semantic.h"
+#include "mem_stats.h"
+#include "options.h"
+#include "profile.h"
+#include "pipeline.h"
 
-int main(int argc, char** argv) {
-    std::string outputPath = "outputs/output.ll";
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if (arg == "-o" && i + 1 < argc) {
-            outputPath = argv[++i];
-        }
-    }
+extern std::vector<std::unique_ptr<Function>> g_functions;
 
-    // Read full input source
-    std::ostringstream buf;
-    if (argc > 1 && std::string(argv[argc - 2]) != "-o") {
-        std::ifstream in(argv[argc - 1]);
-        if (!in) {
-            std::cerr << "error: cannot open input file: " << argv[argc - 1] << "\n";
-            return 1;
-        }
-        buf << in.rdbuf();
-    } else {
-        // default demo program
-        buf << "int main() { return 1+2*3; }\n";
-    }
-    std::string source = buf.str();
-
-    ErrorHandler err;
+// Parses every unit into g_functions, then checks and emits the module.
+// False once a diagnostic has been printed.
+static bool compileSerial(const std::vector<std::string>& sources, [[maybe_unused]] const std::vector<std::string>& paths,
+                          const CompilerOptions& opts, IRGenerator& irgen, ConstEvaluator& constEval, std::string& ir) {
+    MemStats::beginPhase("parse");
 #if USE_FLEX_BISON
-    // Feed buffer into a temporary file stream for Flex/Bison
+    // Feed the units, one after another, into a temporary file for Flex/Bison
     std::string tmpPath = "build/tmp_input.mc";
     std::ofstream tmp(tmpPath);
-    tmp << source;
+    for (const auto& source : sources) tmp << source << "\n";
     tmp.close();
     FILE* f = std::fopen(tmpPath.c_str(), "r");
     if (!f) {
         std::cerr << "error: cannot reopen temp input\n";
-        return 1;
+        return false;
     }
     extern FILE* yyin;
     yyin = f;
-    extern std::vector<std::unique_ptr<Function>> g_functions;
-    if (yyparse() != 0) {
+    int parseStatus;
+    {
+        MemTagScope tag(MemTag::Parser);
+        parseStatus = yyparse();
+    }
+    if (parseStatus != 0) {
         std::cerr << "parse failed\n";
         std::fclose(f);
-        return 1;
+        return false;
     }
     std::fclose(f);
+#else
+    // each unit's functions are appended to the one module
+    for (size_t i = 0; i < sources.size(); ++i) {
+        ErrorHandler err;
+        Lexer lex(sources[i]);
+        Parser parser(lex, err);
+        bool parsed;
+        {
+            MemTagScope tag(MemTag::Parser);
+            parsed = parser.parseTranslationUnit(g_functions);
+        }
+        if (!parsed) {
+            if (sources.size() > 1) std::cerr << paths[i] << ":\n";
+            err.printAll();
+            std::cerr << "parse failed\n";
+            return false;
+        }
+    }
+#endif
     if (g_functions.empty()) {
         std::cerr << "no functions parsed\n";
-        return 1;
+        return false;
     }
-#else
-    Lexer lex(source);
-    Parser parser(lex, err);
-    auto fn = parser.parseFunction();
-    if (err.hasErrors() || !fn) {
-        err.printAll();
+
+    ErrorHandler semErr;
+    MemStats::beginPhase("sema");
+    semanticCheckModule(g_functions, semErr, opts);
+    if (semErr.hasErrors()) { semErr.printAll(); return false; }
+    if (opts.constEval) {
+        for (const auto& fn : g_functions)
+            if (!fn->isExtern && fn->reachable) constEval.add(*fn);
+        for (const auto& fn : g_functions)
+            if (!fn->isExtern && fn->reachable) constEval.fold(*fn);
+        // a function called only with constant arguments may be dead now
+        if (opts.deadFunctions) markReachableFunctions(g_functions);
+    }
+
+    MemStats::beginPhase("irgen");
+    ir = irgen.generateModuleIR(g_functions);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string outputPath = "outputs/output.ll";
+    std::vector<std::string> inputPaths;
+    bool memReport = false;
+    bool cseReport = false;
+    bool peepholeReport = false;
+    bool functionReport = false;
+    bool frameReport = false;
+    bool attributeReport = false;
+    bool constEvalReport = false;
+    bool switchTableReport = false;
+    CompilerOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "-fmem-report") {
+            memReport = true;
+        } else if (arg == "-freorder-struct-fields") {
+            opts.reorderStructFields = true;
+        } else if (arg == "-fvectorize") {
+            opts.vectorize = true;
+        } else if (arg == "-funroll-loops") {
+            opts.unrollLoops = true;
+        } else if (arg == "-fbounds-check") {
+            opts.boundsCheck = true;
+        } else if (arg == "--whole-program") {
+            opts.wholeProgram = true;
+        } else if (arg == "-fpipeline") {
+            opts.pipeline = true;
+        } else if (arg == "-fno-cse") {
+            opts.valueNumbering = false;
+        } else if (arg == "-fcse-report") {
+            cseReport = true;
+        } else if (arg == "-fno-dead-functions") {
+            opts.deadFunctions = false;
+        } else if (arg == "-fno-const-eval") {
+            opts.constEval = false;
+        } else if (arg == "-fconst-eval-report") {
+            constEvalReport = true;
+        } else if (arg == "-ffunction-report") {
+            functionReport = true;
+        } else if (arg == "-fno-peephole") {
+            opts.peephole = false;
+        } else if (arg == "-fpeephole-report") {
+            peepholeReport = true;
+        } else if (arg == "-fwrapv") {
+            opts.wrapv = true;
+        } else if (arg == "-fno-strict-aliasing") {
+            opts.strictAliasing = false;
+        } else if (arg == "-fno-function-attrs") {
+            opts.functionAttrs = false;
+        } else if (arg == "-fattribute-report") {
+            attributeReport = true;
+        } else if (arg == "-fno-switch-tables") {
+            opts.switchTables = false;
+        } else if (arg == "-fswitch-table-report") {
+            switchTableReport = true;
+        } else if (arg == "-fno-stack-coloring") {
+            opts.stackColoring = false;
+        } else if (arg == "-fframe-report") {
+            frameReport = true;
+        } else if (arg == "-fno-heap-to-stack") {
+            opts.heapToStack = false;
+        } else if (arg == "-fprofile-generate") {
+            opts.profileGenerate = "mc.profdata";
+        } else if (arg.rfind("-fprofile-generate=", 0) == 0) {
+            opts.profileGenerate = arg.substr(19);
+        } else if (arg == "-finstrument-functions") {
+            opts.instrumentFunctions = "mc.folded";
+        } else if (arg.rfind("-finstrument-functions=", 0) == 0) {
+            opts.instrumentFunctions = arg.substr(23);
+        } else if (arg == "-fheap-profile") {
+            opts.heapProfile = "mc.heap";
+        } else if (arg.rfind("-fheap-profile=", 0) == 0) {
+            opts.heapProfile = arg.substr(15);
+        } else if (arg.rfind("-fprofile-use=", 0) == 0) {
+            opts.profileUse = arg.substr(14);
+        } else {
+            inputPaths.push_back(arg);
+        }
+    }
+    if (inputPaths.size() > 1 && !opts.wholeProgram) {
+        std::cerr << "error: several input files need --whole-program\n";
         return 1;
     }
-#endif
+    if (memReport) MemStats::enable();
+    Profile profile;
+    if (!opts.profileUse.empty()) {
+        std::string error;
+        if (!profile.load(opts.profileUse, error)) {
+            std::cerr << "error: " << error << "\n";
+            return 1;
+        }
+    }
 
-    ErrorHandler semErr;
-    semanticCheckModule(g_functions, semErr);
-    if (semErr.hasErrors()) { semErr.printAll(); return 1; }
+    // Read full input sources
+    MemStats::beginPhase("read");
+    std::vector<std::string> sources;
+    for (const auto& path : inputPaths) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "error: cannot open input file: " << path << "\n";
+            return 1;
+        }
+        std::ostringstream buf;
+        buf << in.rdbuf();
+        sources.push_back(buf.str());
+    }
+    if (sources.empty()) {
+        // default demo program
+        sources.push_back("int main() { return 1+2*3; }\n");
+        inputPaths.push_back("<demo>");
+    }
 
-    IRGenerator irgen;
-    std::string ir = irgen.generateModuleIR(g_functions);
+    IRGenerator irgen(opts, opts.profileUse.empty() ? nullptr : &profile);
+    ConstEvaluator constEval;
+    std::string ir;
+    PipelineResult pipelined = PipelineResult::Serial;
+#if !USE_FLEX_BISON
+    // -fmem-report attributes allocations to sequential phases, so it
+    // keeps the serial driver
+    if (opts.pipeline && !MemStats::enabled()) pipelined = compilePipelined(sources, inputPaths, opts, irgen, constEval, ir);
+#endif
+    if (pipelined == PipelineResult::ParseFailed) return 1;
+    if (pipelined == PipelineResult::Serial) {
+        g_functions.clear();
+        constEval = ConstEvaluator();
+        if (!compileSerial(sources, inputPaths, opts, irgen, constEval, ir)) return 1;
+    }
 
+    MemStats::beginPhase("emit");
     std::ofstream out(outputPath);
     if (!out) {
         std::cerr << "error: cannot open output file: " << outputPath << "\n";
@@ -82,5 +226,61 @@ int main(int argc, char** argv) {
     out << ir;
     out.close();
     std::cout << "Wrote IR to " << outputPath << "\n";
+    if (opts.boundsCheck) {
+        const auto& b = irgen.boundsStats();
+        std::cerr << "bounds-check: " << b.removed << " of " << b.accesses << " array accesses proven in bounds, "
+                  << b.accesses - b.removed << " checked\n";
+    }
+    if (opts.wholeProgram) {
+        const auto& w = irgen.wholeProgramStats();
+        std::cerr << "whole-program: " << sources.size() << " units, " << w.inlined << " calls inlined, "
+                  << w.internalized << " functions internalized, " << w.constants << " statics made constant\n";
+    }
+    if (cseReport) {
+        const auto& v = irgen.valueNumberingStats();
+        std::cerr << "cse: " << v.before << " instructions emitted, " << v.after << " after value numbering ("
+                  << v.loads << " redundant loads, " << v.expressions << " recomputed expressions removed)\n";
+    }
+    if (constEvalReport) {
+        const auto& c = constEval.stats();
+        std::cerr << "const-eval: " << c.pure << " pure functions, " << c.folded << " calls folded (" << c.cached
+                  << " from the cache), " << c.givenUp << " left to run time\n";
+    }
+    if (functionReport) {
+        int defined = 0, emitted = 0;
+        for (const auto& fn : g_functions) {
+            if (fn->isExtern) continue;
+            ++defined;
+            emitted += fn->reachable;
+        }
+        std::cerr << "functions: " << defined << " defined, " << emitted << " emitted, " << defined - emitted
+                  << " unreachable from main removed\n";
+    }
+    if (peepholeReport) {
+        const auto& p = irgen.peepholeStats();
+        int rewrites = 0;
+        for (const auto& r : p.rules) rewrites += r.second;
+        std::cerr << "peephole: " << p.before << " instructions in, " << p.after << " out (" << rewrites
+                  << " rewrites, " << p.dead << " unused instructions removed)\n";
+        for (const auto& r : p.rules)
+            if (r.second) std::cerr << "  " << r.first << ": " << r.second << "\n";
+    }
+    if (frameReport) {
+        const auto& f = irgen.frameStats();
+        std::cerr << "frame: " << f.locals << " locals in " << f.before << " bytes, " << f.allocas << " allocas in "
+                  << f.after << " bytes after stack coloring (" << f.before - f.after << " bytes saved)\n";
+    }
+    if (attributeReport) {
+        const auto& a = irgen.attributeStats();
+        std::cerr << "attributes: " << a.functions << " functions, " << a.internal << " internal (" << a.fastcc
+                  << " fastcc), " << a.readnone << " readnone, " << a.readonly << " readonly, " << a.willreturn
+                  << " willreturn, " << a.norecurse << " norecurse\n";
+    }
+    if (switchTableReport) {
+        const auto& s = irgen.switchTableStats();
+        std::cerr << "switch-tables: " << s.switches << " switches, " << s.tables << " lowered to lookup tables ("
+                  << s.entries << " entries)\n";
+    }
+    if (MemStats::enabled()) MemStats::report(std::cerr);
     return 0;
 }
@@ -15,6 +15,7 @@ EXP_DIR="tests/expected"
 
 pass=0
 fail=0
+check_re='^;;[[:space:]]*CHECK:' # ;; cannot appear unquoted inside [[ ]]
 
 declare -a cases
 while IFS= read -r -d '' f; do cases+=("$f"); done < <(find "$CASE_DIR" -maxdepth 1 -type f -name '*.mc' -print0 | sort -z)
@@ -22,14 +23,17 @@ while IFS= read -r -d '' f; do cases+=("$f"); done < <(find "$CASE_DIR" -maxdept
 for mc in "${cases[@]}"; do
   name=$(basename "$mc" .mc)
   out="outputs/${name}.ll"
-  if ./mycc -o "$out" "$mc"; then
+  check="$EXP_DIR/${name}.check"
+  # Optional ";; FLAGS: ..." line in the check file: mycc options for the case
+  flags=()
+  [[ -f "$check" ]] && read -r -a flags <<< "$(sed -n 's/^;;[[:space:]]*FLAGS://p' "$check" | head -n 1)"
+  if ./mycc ${flags[@]+"${flags[@]}"} -o "$out" "$mc"; then
     echo "PASS compile: $mc -> $out"
     # Optional check: grep patterns from expected file if exists
-    check="$EXP_DIR/${name}.check"
     if [[ -f "$check" ]]; then
       ok=1
       while IFS= read -r line; do
-        [[ "$line" =~ ^;;[[:space:]]*CHECK: ]] || continue
+        [[ "$line" =~ $check_re ]] || continue
         pat=${line#*CHECK:}
         if ! grep -E -q "$pat" "$out"; then
           echo "FAIL check: $name missing pattern: $pat"
@@ -37,12 +41,12 @@ for mc in "${cases[@]}"; do
           break
         fi
       done < "$check"
-      if [[ $ok -eq 1 ]]; then echo "PASS checks: $name"; ((pass++)); else ((fail++)); fi
+      if [[ $ok -eq 1 ]]; then echo "PASS checks: $name"; pass=$((pass + 1)); else fail=$((fail + 1)); fi
     else
-      ((pass++))
+      pass=$((pass + 1))
     fi
   else
-    echo "FAIL compile: $mc"; ((fail++))
+    echo "FAIL compile: $mc"; fail=$((fail + 1))
   fi
 done
 
@@ -51,9 +55,9 @@ while IFS= read -r -d '' f; do
   name=$(basename "$f" .mc)
   out="outputs/${name}.ll"
   if ./mycc -o "$out" "$f"; then
-    echo "FAIL negative (succeeded): $f"; ((fail++))
+    echo "FAIL negative (succeeded): $f"; fail=$((fail + 1))
   else
-    echo "PASS negative (failed as expected): $f"; ((pass++))
+    echo "PASS negative (failed as expected): $f"; pass=$((pass + 1))
   fi
 done < <(find "$NEG_DIR" -maxdepth 1 -type f -name '*.mc' -print0 | sort -z)
 
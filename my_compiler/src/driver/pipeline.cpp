@@ -0,0 +1,114 @@
+#include "pipeline.h"
+#include "error_handler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "struct_layout.h"
+#include "work_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <thread>
+
+extern std::vector<std::unique_ptr<Function>> g_functions;
+
+namespace {
+
+// Functions parsed but not yet checked, and checked but not yet emitted.
+// Large enough to absorb the difference in speed between a short function
+// and a long one, small enough that a stalled stage stops the parser soon.
+constexpr size_t kQueueCapacity = 32;
+
+// Threads besides the three stages, for IRGenerator's text passes.
+int finishWorkers() {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(1, cores - 3);
+}
+
+} // namespace
+
+PipelineResult compilePipelined(const std::vector<std::string>& sources, const std::vector<std::string>& paths,
+                                const CompilerOptions& opts, IRGenerator& irgen, ConstEvaluator& constEval,
+                                std::string& ir) {
+    BoundedQueue<Function*> parsed(kQueueCapacity), checked(kQueueCapacity);
+    std::atomic<bool> serial{false}; // set by any stage; the others then only drain their queues
+    IncrementalChecker checker;
+    // functions the scan finds unreachable are neither checked nor emitted
+    std::future<std::unordered_set<std::string>> scan;
+    if (opts.deadFunctions) scan = std::async(std::launch::async, scanReachableFunctions, std::cref(sources));
+
+    std::thread sema([&] {
+        std::unordered_set<std::string> reachable;
+        if (opts.deadFunctions) reachable = scan.get();
+        std::vector<Function*> ready;
+        auto pass = [&] {
+            if (checker.needsSerialCheck()) serial = true;
+            if (!serial && opts.constEval) {
+                for (Function* fn : ready)
+                    if (!fn->isExtern && fn->reachable) constEval.add(*fn);
+                for (Function* fn : ready)
+                    if (!fn->isExtern && fn->reachable && !constEval.fold(*fn)) serial = true;
+            }
+            if (!serial) for (Function* fn : ready) checked.push(fn);
+            ready.clear();
+        };
+        while (auto fn = parsed.pop()) {
+            if (serial) continue;
+            if (opts.deadFunctions) (*fn)->reachable = reachable.count((*fn)->name) != 0;
+            checker.add(**fn, ready);
+            pass();
+        }
+        if (!serial) checker.finish(ready);
+        pass();
+        checked.close();
+    });
+    std::thread emit([&] {
+        ir = irgen.generateModuleIR([&]() -> const Function* {
+            auto fn = checked.pop();
+            return fn ? *fn : nullptr;
+        }, finishWorkers());
+    });
+
+    bool parseFailed = false;
+    for (size_t i = 0; i < sources.size() && !parseFailed; ++i) {
+        ErrorHandler err;
+        Lexer lex(sources[i]);
+        Parser parser(lex, err);
+        MemTagScope tag(MemTag::Parser);
+        bool ok = parser.parseTranslationUnit([&](std::unique_ptr<Function> fn) {
+            Function* f = fn.get();
+            g_functions.push_back(std::move(fn));
+            // layouts are fixed before the function that defines them moves on
+            if (!layoutNewStructs(opts.reorderStructFields)) serial = true;
+            parsed.push(f);
+        });
+        if (!ok) {
+            parseFailed = true;
+            serial = true;
+            if (sources.size() > 1) std::cerr << paths[i] << ":\n";
+            err.printAll();
+            std::cerr << "parse failed\n";
+        }
+    }
+    parsed.close();
+    sema.join();
+    emit.join();
+    if (parseFailed) return PipelineResult::ParseFailed;
+    if (serial || g_functions.empty()) return PipelineResult::Serial;
+
+    // The scan keeps a function whose name is only, say, a struct field in
+    // main; emitted but unreachable, it must go again.
+    if (opts.deadFunctions) {
+        std::vector<bool> emitted;
+        for (const auto& fn : g_functions) emitted.push_back(fn->reachable);
+        markReachableFunctions(g_functions);
+        for (size_t i = 0; i < g_functions.size(); ++i) {
+            if (emitted[i] && !g_functions[i]->reachable && !g_functions[i]->isExtern) {
+                ir = irgen.generateModuleIR(g_functions);
+                break;
+            }
+        }
+    }
+    return PipelineResult::Done;
+}
@@ -0,0 +1,186 @@
+// -fbounds-check: accesses to local arrays are guarded by a branch to a
+// trap unless an interval analysis proves the index in [0, N). Intervals
+// come from constants, locals initialized with a constant and never
+// assigned again, and the induction variables of counted for loops, and
+// are propagated through integer arithmetic.
+#include "ir_generator.h"
+#include "ast_walk.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+constexpr long long kMin = INT32_MIN;
+constexpr long long kMax = INT32_MAX;
+
+bool fits(long long lo, long long hi) { return lo >= kMin && hi <= kMax; }
+
+const VarExpr* plainVar(const Expr* e) {
+    auto v = dynamic_cast<const VarExpr*>(e);
+    return v && v->slot >= 0 && e->conv == ImplicitConv::None ? v : nullptr;
+}
+
+const NumberExpr* plainNumber(const Expr* e) {
+    auto n = dynamic_cast<const NumberExpr*>(e);
+    return n && e->conv == ImplicitConv::None ? n : nullptr;
+}
+
+const AssignExpr* assignmentTo(const Stmt* s) {
+    auto e = dynamic_cast<const ExprStmt*>(s);
+    auto a = e ? dynamic_cast<const AssignExpr*>(e->expr.get()) : nullptr;
+    return a && plainVar(a->target.get()) ? a : nullptr;
+}
+
+} // namespace
+
+void IRGenerator::analyzeRanges(const Function& fnNode, FunctionContext& fn) {
+    fn.ranges.clear();
+    fn.addressTaken.clear();
+    fn.rangeFacts = true;
+    std::vector<int> writes(fnNode.slots.size(), 0);
+    std::vector<const Expr*> init(fnNode.slots.size(), nullptr);
+    forEachStmt(fnNode, [&](const Stmt* s) {
+        if (dynamic_cast<const LabelStmt*>(s)) fn.rangeFacts = false;
+        if (auto d = dynamic_cast<const VarDeclStmt*>(s); d && d->init && d->slot >= 0) {
+            init[static_cast<size_t>(d->slot)] = d->init.get();
+            ++writes[static_cast<size_t>(d->slot)];
+        }
+    });
+    forEachExpr(fnNode, [&](const Expr* e) {
+        if (auto a = dynamic_cast<const AssignExpr*>(e)) {
+            if (auto v = dynamic_cast<const VarExpr*>(a->target.get()); v && v->slot >= 0) ++writes[static_cast<size_t>(v->slot)];
+        } else if (auto u = dynamic_cast<const UnaryExpr*>(e); u && u->op == "&") {
+            if (auto v = dynamic_cast<const VarExpr*>(u->operand.get()); v && v->slot >= 0) fn.addressTaken.insert(v->slot);
+        }
+    });
+    if (!fn.rangeFacts) return;
+    for (size_t i = 0; i < fnNode.slots.size(); ++i) {
+        const VarSlot& slot = fnNode.slots[i];
+        auto n = dynamic_cast<const NumberExpr*>(init[i]);
+        if (!n || writes[i] != 1 || slot.paramIndex >= 0 || fn.addressTaken.count(static_cast<int>(i))) continue;
+        long long v = n->value;
+        if (slot.type->kind == TypeKind::Char) v = static_cast<int8_t>(v);
+        else if (slot.type->kind == TypeKind::Int) v = static_cast<int32_t>(v);
+        else continue;
+        fn.ranges[static_cast<int>(i)] = Interval{v, v};
+    }
+}
+
+IRGenerator::Interval IRGenerator::rangeOf(const Expr* e, const FunctionContext& fn) const {
+    const Interval full{kMin, kMax};
+    const Interval charRange{INT8_MIN, INT8_MAX};
+    auto byType = [&](const Type* t) { return t && t->kind == TypeKind::Char ? charRange : full; };
+    if (!e) return full;
+    if (e->conv != ImplicitConv::None && e->conv != ImplicitConv::CharToInt && e->conv != ImplicitConv::IntToChar) return full;
+
+    auto raw = [&]() -> Interval {
+        if (auto n = dynamic_cast<const NumberExpr*>(e)) return Interval{n->value, n->value};
+        if (auto z = dynamic_cast<const SizeofExpr*>(e)) return Interval{static_cast<long long>(z->size), static_cast<long long>(z->size)};
+        if (auto v = dynamic_cast<const VarExpr*>(e)) {
+            auto it = fn.ranges.find(v->slot);
+            return it != fn.ranges.end() ? it->second : byType(e->type);
+        }
+        if (auto u = dynamic_cast<const UnaryExpr*>(e)) {
+            if (u->op == "!") return Interval{0, 1};
+            if (u->op != "-") return byType(e->type);
+            Interval r = rangeOf(u->operand.get(), fn);
+            return Interval{-r.hi, -r.lo};
+        }
+        auto b = dynamic_cast<const BinaryExpr*>(e);
+        if (!b || !e->type || e->type->kind != TypeKind::Int) return byType(e->type);
+        static const char* const boolOps[] = {"<", ">", "<=", ">=", "==", "!=", "&&", "||"};
+        for (const char* op : boolOps) if (b->op == op) return Interval{0, 1};
+        Interval l = rangeOf(b->lhs.get(), fn), r = rangeOf(b->rhs.get(), fn);
+        if (b->op == "+") return Interval{l.lo + r.lo, l.hi + r.hi};
+        if (b->op == "-") return Interval{l.lo - r.hi, l.hi - r.lo};
+        if (b->op == "*") {
+            long long c[] = {l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi};
+            return Interval{*std::min_element(c, c + 4), *std::max_element(c, c + 4)};
+        }
+        bool constRhs = r.lo == r.hi;
+        if (b->op == "/" && constRhs && r.lo > 0) return Interval{l.lo / r.lo, l.hi / r.lo};
+        if (b->op == "%" && constRhs && r.lo > 0) {
+            if (l.lo >= 0) return Interval{0, std::min(l.hi, r.lo - 1)};
+            return Interval{-(r.lo - 1), r.lo - 1};
+        }
+        if (b->op == "&" && (l.lo >= 0 || r.lo >= 0)) {
+            long long hi = l.lo >= 0 && r.lo >= 0 ? std::min(l.hi, r.hi) : l.lo >= 0 ? l.hi : r.hi;
+            return Interval{0, hi};
+        }
+        if (b->op == ">>" && constRhs && r.lo >= 0 && r.lo < 32 && l.lo >= 0) return Interval{l.lo >> r.lo, l.hi >> r.lo};
+        return full;
+    };
+    Interval r = raw();
+    if (!fits(r.lo, r.hi)) r = full; // may wrap
+    if (e->conv == ImplicitConv::IntToChar && (r.lo < charRange.lo || r.hi > charRange.hi)) return charRange;
+    return r;
+}
+
+// for (i = a; i < b; i = i + c) with c > 0, or the decreasing form with
+// i > b and i = i - c: inside the body i stays between a and the bound,
+// provided nothing else can change i. The bound is rechecked every
+// iteration, so its own range (valid throughout) is enough even if it
+// changes in the body.
+bool IRGenerator::inductionRange(const ForStmt* f, const FunctionContext& fn, int& slot, Interval& range) const {
+    if (!fn.rangeFacts) return false;
+    const Expr* start = nullptr;
+    if (auto d = dynamic_cast<const VarDeclStmt*>(f->init.get())) { slot = d->slot; start = d->init.get(); }
+    else if (auto a = assignmentTo(f->init.get())) { slot = plainVar(a->target.get())->slot; start = a->value.get(); }
+    if (!start || slot < 0 || fn.addressTaken.count(slot)) return false;
+    const VarSlot& vs = fn.node->slots[static_cast<size_t>(slot)];
+    if (vs.isStatic || vs.type->kind != TypeKind::Int) return false;
+
+    const AssignExpr* step = assignmentTo(f->iter.get());
+    if (!step || plainVar(step->target.get())->slot != slot) return false;
+    auto inc = dynamic_cast<const BinaryExpr*>(step->value.get());
+    if (!inc || (inc->op != "+" && inc->op != "-")) return false;
+    const NumberExpr* c = nullptr;
+    if (plainVar(inc->lhs.get()) && plainVar(inc->lhs.get())->slot == slot) c = plainNumber(inc->rhs.get());
+    else if (inc->op == "+" && plainVar(inc->rhs.get()) && plainVar(inc->rhs.get())->slot == slot) c = plainNumber(inc->lhs.get());
+    if (!c || c->value <= 0) return false;
+    bool up = inc->op == "+";
+
+    auto cond = dynamic_cast<const BinaryExpr*>(f->condition.get());
+    if (!cond || !plainVar(cond->lhs.get()) || plainVar(cond->lhs.get())->slot != slot) return false;
+    bool written = false;
+    forEachExpr(f->body.get(), [&](const Expr* e) {
+        if (auto a = dynamic_cast<const AssignExpr*>(e))
+            if (auto v = dynamic_cast<const VarExpr*>(a->target.get()); v && v->slot == slot) written = true;
+    });
+    if (written) return false;
+
+    Interval a = rangeOf(start, fn), b = rangeOf(cond->rhs.get(), fn);
+    if (up && (cond->op == "<" || cond->op == "<=")) {
+        range = Interval{a.lo, cond->op == "<" ? b.hi - 1 : b.hi};
+        return range.hi + c->value <= kMax; // the last step must not wrap
+    }
+    if (!up && (cond->op == ">" || cond->op == ">=")) {
+        range = Interval{cond->op == ">" ? b.lo + 1 : b.lo, a.hi};
+        return range.lo - c->value >= kMin;
+    }
+    return false;
+}
+
+void IRGenerator::checkBounds(const ArrayIndexExpr* a, const IRValue& index, FunctionContext& fn) {
+    long long n = static_cast<long long>(a->base->type->arrayLength);
+    ++bounds.accesses;
+    Interval r = rangeOf(a->index.get(), fn);
+    if (r.lo >= 0 && r.hi < n) { ++bounds.removed; return; }
+    if (fn.trapLabel.empty()) fn.trapLabel = newLabel(fn, "bounds.trap");
+    if (unlikelyWeights.empty()) unlikelyWeights = addMetadata("!{!\"branch_weights\", i32 2000, i32 1}");
+    // unsigned compare: negative indices fail too
+    std::string ok = newTemp(fn);
+    std::string okL = newLabel(fn, "bounds.ok");
+    fn.body << "  " << ok << " = icmp ult i32 " << index.reg << ", " << n << "\n";
+    fn.body << "  br i1 " << ok << ", label %" << okL << ", label %" << fn.trapLabel << ", !prof " << unlikelyWeights << "\n";
+    fn.currentTerminated = true;
+    startBlock(fn, okL);
+}
+
+void IRGenerator::emitTrap(FunctionContext& fn) {
+    if (fn.trapLabel.empty()) return;
+    intrinsicDecls.insert("declare void @llvm.trap()");
+    fn.body << fn.trapLabel << ":\n";
+    fn.body << "  call void @llvm.trap()\n";
+    fn.body << "  unreachable\n";
+}
@@ -0,0 +1,53 @@
+// Emission for the pipelined driver. Functions are drafted in module order
+// as they arrive, since drafting numbers string literals, statics and
+// metadata for the whole module; the text passes that finish a draft only
+// look at the one function and run on worker threads, each with an
+// IRGenerator of its own whose statistics are added up at the end.
+#include "ir_generator.h"
+#include "work_queue.h"
+#include <algorithm>
+#include <deque>
+#include <thread>
+
+namespace {
+
+// Drafts waiting for a worker: enough to keep them busy, and a bound on
+// how far emission runs ahead of them.
+constexpr size_t kPendingDrafts = 64;
+
+} // namespace
+
+std::string IRGenerator::generateModuleIR(const std::function<const Function*()>& next, int workers) {
+    beginModule();
+    MemTagScope modTag(MemTag::IRText);
+    struct Job { FunctionDraft draft; std::string* text; };
+    BoundedQueue<Job> jobs(kPendingDrafts);
+    std::deque<FunctionText> texts; // grows at the back only, so the workers' pointers stay valid
+    std::vector<IRGenerator> finishers(static_cast<size_t>(std::max(1, workers)), IRGenerator(opts, profile));
+    std::vector<std::thread> threads;
+    for (auto& f : finishers)
+        threads.emplace_back([&f, &jobs] {
+            while (auto job = jobs.pop()) *job->text = f.finishFunction(job->draft);
+        });
+    while (const Function* fn = next()) {
+        if (fn->isExtern || !fn->reachable) continue;
+        texts.push_back(FunctionText{fn->name, {}});
+        jobs.push(Job{draftFunction(*fn), &texts.back().text});
+    }
+    jobs.close();
+    for (auto& t : threads) t.join();
+
+    for (const auto& f : finishers) {
+        valueNumbering.before += f.valueNumbering.before;
+        valueNumbering.after += f.valueNumbering.after;
+        valueNumbering.loads += f.valueNumbering.loads;
+        valueNumbering.expressions += f.valueNumbering.expressions;
+        peepholes.before += f.peepholes.before;
+        peepholes.after += f.peepholes.after;
+        peepholes.dead += f.peepholes.dead;
+        if (peepholes.rules.empty()) peepholes.rules = f.peepholes.rules;
+        else for (size_t i = 0; i < f.peepholes.rules.size(); ++i) peepholes.rules[i].second += f.peepholes.rules[i].second;
+    }
+    std::vector<FunctionText> program(std::make_move_iterator(texts.begin()), std::make_move_iterator(texts.end()));
+    return finishModule(program);
+}
@@ -0,0 +1,125 @@
+// Heap-to-stack conversion. A pointer local qualifies when every value it
+// is given is malloc(<constant>) or 0 and every use only reaches through it
+// (p->f, p[i], *p), tests or compares it, or frees it; taking the address
+// of anything in the block (&p[i], &p->f) disqualifies it. The block can
+// then never be seen outside the call, so all of the local's mallocs share
+// one entry-block alloca sized for the largest and its free()s go away. A
+// malloc in a loop reuses the same storage, which is safe only because the
+// local is the one way to reach a block: assigning it again leaves the
+// previous block unreachable.
+#include "ir_generator.h"
+#include "ast_walk.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// Larger blocks stay on the heap so that a big buffer cannot overflow the
+// stack.
+constexpr long long kMaxStackBytes = 4096;
+
+bool constantValue(const Expr* e, long long& v) {
+    if (auto n = dynamic_cast<const NumberExpr*>(e)) { v = n->value; return true; }
+    if (auto z = dynamic_cast<const SizeofExpr*>(e)) { v = static_cast<long long>(z->size); return true; }
+    auto b = dynamic_cast<const BinaryExpr*>(e);
+    long long l, r;
+    if (!b || !constantValue(b->lhs.get(), l) || !constantValue(b->rhs.get(), r)) return false;
+    if (b->op == "+") v = l + r;
+    else if (b->op == "-") v = l - r;
+    else if (b->op == "*") v = l * r;
+    else return false;
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+const CallExpr* builtinCall(const Expr* e, const char* name) {
+    auto c = dynamic_cast<const CallExpr*>(e);
+    auto callee = c ? dynamic_cast<const VarExpr*>(c->callee.get()) : nullptr;
+    return callee && !c->target && callee->slot < 0 && callee->name == name ? c : nullptr;
+}
+
+const VarExpr* localVar(const Expr* e) {
+    auto v = dynamic_cast<const VarExpr*>(e);
+    return v && v->slot >= 0 ? v : nullptr;
+}
+
+// The local whose pointee the lvalue e lies in (p for p[i].f, p->f, *p),
+// or null.
+const VarExpr* pointeeOf(const Expr* e) {
+    for (;;) {
+        if (auto m = dynamic_cast<const MemberExpr*>(e)) e = m->base.get();
+        else if (auto a = dynamic_cast<const ArrayIndexExpr*>(e); a && a->base->type->kind == TypeKind::Array) e = a->base.get();
+        else if (auto a = dynamic_cast<const ArrayIndexExpr*>(e)) return localVar(a->base.get());
+        else if (auto pm = dynamic_cast<const PtrMemberExpr*>(e)) return localVar(pm->base.get());
+        else if (auto u = dynamic_cast<const UnaryExpr*>(e); u && u->op == "*") return localVar(u->operand.get());
+        else return nullptr;
+    }
+}
+
+} // namespace
+
+void IRGenerator::findStackAllocations(const Function& fnNode, FunctionContext& fn) {
+    fn.stackAllocs.clear();
+    fn.stackSlots.clear();
+    size_t n = fnNode.slots.size();
+    std::vector<bool> rejected(n, false);
+    std::vector<long long> bytes(n, 0);
+    std::vector<std::vector<const CallExpr*>> mallocs(n);
+    for (size_t i = 0; i < n; ++i) {
+        const VarSlot& s = fnNode.slots[i];
+        rejected[i] = s.isStatic || s.paramIndex >= 0 || s.type->kind != TypeKind::Pointer;
+    }
+
+    auto assigned = [&](int slot, const Expr* value) {
+        long long size = 0;
+        if (auto m = builtinCall(value, "malloc"); m && m->args.size() == 1 && constantValue(m->args[0].get(), size)
+                && size > 0 && size <= kMaxStackBytes) {
+            mallocs[static_cast<size_t>(slot)].push_back(m);
+            bytes[static_cast<size_t>(slot)] = std::max(bytes[static_cast<size_t>(slot)], size);
+            return;
+        }
+        auto zero = dynamic_cast<const NumberExpr*>(value);
+        if (!zero || zero->value != 0) rejected[static_cast<size_t>(slot)] = true;
+    };
+
+    // VarExprs in a position where the pointer value goes nowhere
+    std::unordered_set<const Expr*> harmless;
+    auto allow = [&](const Expr* e) { if (localVar(e)) harmless.insert(e); };
+    forEachStmt(fnNode, [&](const Stmt* s) {
+        if (auto d = dynamic_cast<const VarDeclStmt*>(s); d && d->init && d->slot >= 0) assigned(d->slot, d->init.get());
+        // statement-level assignments: their result is discarded
+        if (auto e = dynamic_cast<const ExprStmt*>(s)) {
+            if (auto a = dynamic_cast<const AssignExpr*>(e->expr.get()); a && localVar(a->target.get())) {
+                allow(a->target.get());
+                assigned(localVar(a->target.get())->slot, a->value.get());
+            }
+        }
+        if (auto i = dynamic_cast<const IfStmt*>(s)) allow(i->condition.get());
+        if (auto w = dynamic_cast<const WhileStmt*>(s)) allow(w->condition.get());
+        if (auto d = dynamic_cast<const DoWhileStmt*>(s)) allow(d->condition.get());
+        if (auto f = dynamic_cast<const ForStmt*>(s)) allow(f->condition.get());
+    });
+    forEachExpr(fnNode, [&](const Expr* e) {
+        if (auto m = dynamic_cast<const PtrMemberExpr*>(e)) allow(m->base.get());
+        else if (auto a = dynamic_cast<const ArrayIndexExpr*>(e)) allow(a->base.get());
+        else if (auto u = dynamic_cast<const UnaryExpr*>(e); u && (u->op == "*" || u->op == "!")) allow(u->operand.get());
+        else if (auto b = dynamic_cast<const BinaryExpr*>(e); b && (b->op == "==" || b->op == "!=")) { allow(b->lhs.get()); allow(b->rhs.get()); }
+        else if (auto f = builtinCall(e, "free"); f && f->args.size() == 1) allow(f->args[0].get());
+    });
+    forEachExpr(fnNode, [&](const Expr* e) {
+        if (auto v = localVar(e); v && !harmless.count(e)) rejected[static_cast<size_t>(v->slot)] = true;
+        // an address inside the block would outlive the local's next malloc
+        if (auto u = dynamic_cast<const UnaryExpr*>(e); u && u->op == "&")
+            if (auto v = pointeeOf(u->operand.get())) rejected[static_cast<size_t>(v->slot)] = true;
+        // an assignment used as a value hands the pointer on
+        if (auto a = dynamic_cast<const AssignExpr*>(e); a && !harmless.count(a->target.get()))
+            if (auto v = localVar(a->target.get())) rejected[static_cast<size_t>(v->slot)] = true;
+    });
+
+    for (size_t i = 0; i < n; ++i) {
+        if (rejected[i] || mallocs[i].empty()) continue;
+        std::string block = newTemp(fn);
+        fn.entryAllocas.push_back("  " + block + " = alloca i8, i64 " + std::to_string(bytes[i]) + ", align 16\n");
+        for (const CallExpr* m : mallocs[i]) fn.stackAllocs[m] = block;
+        fn.stackSlots.insert(static_cast<int>(i));
+    }
+}
@@ -0,0 +1,220 @@
+// Function attributes and linkage, inferred over the text of every function
+// in the module once they are finished (and, with --whole-program,
+// inlined). Each function is summarized from its own instructions:
+// - loads and stores count as memory accesses unless they go through its
+//   own allocas (or a getelementptr or bitcast of one), and loads also
+//   unless they read a constant global (string literals, switch tables);
+// - a cycle in its CFG, a call to the C library or another unit, or an
+//   indirect call means it may not return;
+// - an indirect call or a call to another unit may lead anywhere, back
+//   into this module included;
+// and the summaries of its callees are merged in, to a fixed point since
+// callers in a cycle see each other. That gives readnone, readonly,
+// willreturn and norecurse; everything gets nounwind, as the language has
+// no exceptions and the C functions it calls throw none.
+//
+// Linkage follows the rule dead function elimination uses: a unit that
+// defines main is a program and exports nothing else, a unit without main
+// is a library and exports everything. Functions that are not exported
+// become internal, and those of them whose address is never taken also use
+// fastcc, on the define and on every call.
+#include "ir_generator.h"
+#include "ir_text.h"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+struct Summary {
+    bool reads = false;  // memory besides its own allocas
+    bool writes = false;
+    bool mayNotReturn = false;
+    bool escapes = false; // an indirect call or a call to another unit
+};
+
+// Intrinsics that touch no memory the caller can see and always return.
+bool harmlessIntrinsic(std::string_view name) {
+    return name.starts_with("llvm.lifetime.") || name.starts_with("llvm.vector.reduce.");
+}
+
+// The value a "T V" operand names.
+std::string_view operandValue(std::string_view operand) { return operand.substr(operand.rfind(' ') + 1); }
+
+// True if the blocks of `lines` (a function body) form a cycle.
+bool hasCycle(const std::vector<std::string_view>& lines) {
+    std::unordered_map<std::string_view, size_t> blockOf;
+    std::vector<std::vector<std::string_view>> targets; // of each block, the first being entry:
+    for (auto line : lines) {
+        if (!line.empty() && line[0] != ' ' && line.back() == ':') {
+            blockOf.emplace(line.substr(0, line.size() - 1), targets.size());
+            targets.emplace_back();
+            continue;
+        }
+        if (targets.empty()) continue;
+        for (size_t at = line.find("label %"); at != std::string_view::npos; at = line.find("label %", at + 7)) {
+            size_t end = at + 7;
+            while (end < line.size() && irNameChar(line[end])) ++end;
+            targets.back().push_back(line.substr(at + 7, end - at - 7));
+        }
+    }
+    // depth-first search; 1 = on the path, 2 = done
+    if (targets.empty()) return false;
+    std::vector<int> state(targets.size(), 0);
+    std::vector<std::pair<size_t, size_t>> stack{{0, 0}};
+    state[0] = 1;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        if (next == targets[block].size()) {
+            state[block] = 2;
+            stack.pop_back();
+            continue;
+        }
+        auto it = blockOf.find(targets[block][next++]);
+        if (it == blockOf.end()) continue;
+        if (state[it->second] == 1) return true;
+        if (state[it->second] == 0) {
+            state[it->second] = 1;
+            stack.emplace_back(it->second, 0);
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void IRGenerator::inferFunctionAttributes(std::vector<FunctionText>& functions) {
+    std::unordered_map<std::string_view, size_t> index;
+    bool program = opts.wholeProgram;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        index.emplace(functions[i].name, i);
+        program |= functions[i].name == "main";
+    }
+    std::unordered_set<std::string_view> libc; // the C library functions called
+    for (const auto& d : libcDecls) {
+        size_t at = d.find(" @");
+        libc.insert(std::string_view(d).substr(at + 2, d.find('(', at) - at - 2));
+    }
+
+    std::unordered_set<std::string_view> constants;
+    for (const auto& g : globalDefs) {
+        size_t eq = g.find(" = ");
+        if (g.find(" constant ", eq) != std::string::npos) constants.insert(std::string_view(g).substr(0, eq));
+    }
+
+    std::vector<Summary> summaries(functions.size());
+    std::vector<std::vector<size_t>> calls(functions.size());
+    std::vector<bool> addressTaken(functions.size(), false);
+    for (size_t f = 0; f < functions.size(); ++f) {
+        Summary& s = summaries[f];
+        std::vector<std::string_view> lines;
+        std::string_view text = functions[f].text;
+        for (size_t b = text.find('\n') + 1, e; b < text.size(); b = e + 1) { // past the define line
+            e = text.find('\n', b);
+            lines.push_back(text.substr(b, e - b));
+        }
+        std::unordered_set<std::string_view> local;    // allocas and addresses derived from them
+        std::unordered_set<std::string_view> readOnly; // constant globals and addresses derived from them
+        for (auto line : lines) {
+            IRInst inst;
+            if (!parseIRInst(line, inst)) continue;
+            std::string_view op = inst.op();
+            std::string_view callee = irDirectCallee(inst);
+            // a function named anywhere but as the callee has its address taken
+            for (size_t at = line.find('@'); at != std::string_view::npos; at = line.find('@', at + 1)) {
+                size_t end = at + 1;
+                while (end < line.size() && irNameChar(line[end])) ++end;
+                std::string_view name = line.substr(at + 1, end - at - 1);
+                if (name.data() == callee.data()) continue;
+                if (auto it = index.find(name); it != index.end()) addressTaken[it->second] = true;
+            }
+            if (op == "alloca") {
+                local.insert(inst.result);
+            } else if (op == "getelementptr" || op == "bitcast") {
+                std::string_view base = op == "bitcast" ? inst.text.substr(0, inst.text.find(" to ")) : irOperand(inst.text, 1);
+                if (local.count(operandValue(base))) local.insert(inst.result);
+                else if (constants.count(operandValue(base)) || readOnly.count(operandValue(base))) readOnly.insert(inst.result);
+            } else if (op == "load" || op == "store") {
+                std::string_view at = operandValue(irLocation(inst));
+                if (local.count(at) || (op == "load" && (constants.count(at) || readOnly.count(at)))) continue;
+                (op == "load" ? s.reads : s.writes) = true;
+            } else if (op == "call") {
+                if (harmlessIntrinsic(callee)) continue;
+                if (auto it = index.find(callee); it != index.end()) {
+                    calls[f].push_back(it->second);
+                    continue;
+                }
+                s.reads = s.writes = s.mayNotReturn = true;
+                s.escapes |= callee.empty() || (!libc.count(callee) && !callee.starts_with("llvm."));
+            }
+        }
+        s.mayNotReturn |= hasCycle(lines);
+    }
+
+    std::vector<size_t> order;
+    std::vector<bool> recursive;
+    callGraphOrder(calls, order, recursive);
+    for (size_t f = 0; f < summaries.size(); ++f) summaries[f].mayNotReturn |= recursive[f];
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t f : order) {
+            Summary& s = summaries[f];
+            Summary before = s;
+            for (size_t c : calls[f]) {
+                s.reads |= summaries[c].reads;
+                s.writes |= summaries[c].writes;
+                s.mayNotReturn |= summaries[c].mayNotReturn;
+                s.escapes |= summaries[c].escapes;
+            }
+            changed |= s.reads != before.reads || s.writes != before.writes || s.mayNotReturn != before.mayNotReturn
+                    || s.escapes != before.escapes;
+        }
+    }
+
+    std::vector<std::string> attrs(functions.size());
+    std::vector<bool> fast(functions.size(), false);
+    for (size_t f = 0; f < functions.size(); ++f) {
+        const Summary& s = summaries[f];
+        std::string& a = attrs[f];
+        a = "nounwind";
+        if (!s.reads && !s.writes) { a += " readnone"; ++functionAttrs.readnone; }
+        else if (!s.writes) { a += " readonly"; ++functionAttrs.readonly; }
+        if (!s.mayNotReturn) { a += " willreturn"; ++functionAttrs.willreturn; }
+        if (!recursive[f] && !s.escapes) { a += " norecurse"; ++functionAttrs.norecurse; }
+        ++functionAttrs.functions;
+        fast[f] = program && functions[f].name != "main" && !addressTaken[f];
+    }
+
+    for (size_t f = 0; f < functions.size(); ++f) {
+        std::string& text = functions[f].text;
+        size_t headerEnd = text.find('\n');
+        std::string out;
+        out.reserve(text.size() + 64);
+        // "define [internal ]T @name(T1 %0, ...)..."
+        std::string header = text.substr(0, headerEnd);
+        if (program && functions[f].name != "main") {
+            if (header.compare(0, 16, "define internal ") != 0) header.insert(7, "internal ");
+            ++functionAttrs.internal;
+            if (fast[f]) { header.insert(16, "fastcc "); ++functionAttrs.fastcc; }
+        }
+        header.insert(header.find(')', header.find(" @")) + 1, " " + attrs[f]);
+        out += header;
+
+        size_t copied = headerEnd;
+        for (size_t b = headerEnd + 1, e; b < text.size(); b = e + 1) {
+            e = text.find('\n', b);
+            std::string_view line = std::string_view(text).substr(b, e - b);
+            IRInst inst;
+            auto it = parseIRInst(line, inst) ? index.find(irDirectCallee(inst)) : index.end();
+            if (it == index.end()) continue;
+            out.append(text, copied, b - copied);
+            size_t call = b + static_cast<size_t>(inst.text.data() - line.data()) + 5; // past "call "
+            out.append(text, b, call - b);
+            if (fast[it->second]) out += "fastcc ";
+            out.append(text, call, e - call);
+            out += " " + attrs[it->second];
+            copied = e;
+        }
+        out.append(text, copied, std::string::npos);
+        text = std::move(out);
+    }
+}
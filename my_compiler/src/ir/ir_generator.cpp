@@ -1,6 +1,9 @@
 #include "ir_generator.h"
+#include "ast_walk.h"
+#include "struct_layout.h"
 #include "type_system.h"
-std::string IRGenerator::typeToIR(Type* t) {
+#include "mem_stats.h"
+std::string IRGenerator::typeToIR(const Type* t) {
     if (!t) return "i32";
     switch (t->kind) {
         case TypeKind::Int: return "i32";
@@ -16,17 +19,21 @@ std::string IRGenerator::typeToIR(Type* t) {
             return "[" + std::to_string(t->arrayLength) + " x " + typeToIR(t->element) + "]";
         }
         case TypeKind::Struct: {
-            ensureStructType(t->structName);
+            ensureStructType(t);
             return "%struct." + t->structName;
         }
         case TypeKind::Function: {
-            // return type for signature contexts
-            return typeToIR(t->element);
+            // "ret (params)", so that a pointer to it names a function pointer type
+            std::string sig = typeToIR(t->element) + " (";
+            for (size_t i = 0; i < t->params.size(); ++i) sig += (i ? ", " : "") + typeToIR(t->params[i]);
+            return sig + ")";
         }
     }
     return "i32";
 }
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 
 static std::string opToLlvm(const std::string& op) {
     if (op == "+") return "add";
@@ -48,13 +55,26 @@ static std::string opToLlvm(const std::string& op) {
     return "";
 }
 
-static bool isPointerIR(const std::string& t) {
-    return !t.empty() && t.back() == '*';
+// LLVM accepts float constants as the hex bits of the equivalent double,
+// which must be exactly representable in float.
+static std::string floatLiteral(double v) {
+    double d = static_cast<float>(v);
+    unsigned long long bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "0x%016llX", bits);
+    return buf;
 }
 
-static std::string pointeeIR(const std::string& t) {
-    if (isPointerIR(t)) return t.substr(0, t.size()-1);
-    return t;
+static bool isFloat(const Type* t) { return t && t->kind == TypeKind::Float; }
+static bool isPointer(const Type* t) { return t && t->kind == TypeKind::Pointer; }
+
+// Return for control reaching the end of a function without one.
+static std::string fallthroughReturn(const std::string& retIR) {
+    if (retIR == "void") return "  ret void\n";
+    if (retIR == "float") return "  ret float 0.0\n";
+    if (retIR.back() == '*') return "  ret " + retIR + " null\n";
+    return "  ret " + retIR + " 0\n";
 }
 
 void IRGenerator::ensureBlock(FunctionContext& fn) {
@@ -68,6 +88,7 @@ void IRGenerator::startBlock(FunctionContext& fn, const std::string& label) {
     fn.currentLabel = label;
     fn.currentTerminated = false;
     fn.body << label << ":\n";
+    if (!opts.profileGenerate.empty()) countBlock(fn);
 }
 
 void IRGenerator::branch(FunctionContext& fn, const std::string& target) {
@@ -79,234 +100,217 @@ void IRGenerator::branch(FunctionContext& fn, const std::string& target) {
 
 void IRGenerator::cbranch(FunctionContext& fn, const IRValue& cond, const std::string& tlabel, const std::string& flabel) {
     ensureBlock(fn);
-    fn.body << "  br i1 " << cond.reg << ", label %" << tlabel << ", label %" << flabel << "\n";
+    if (!opts.profileGenerate.empty()) countTaken(cond, fn);
+    fn.body << "  br i1 " << cond.reg << ", label %" << tlabel << ", label %" << flabel << branchWeights(fn) << "\n";
     fn.currentTerminated = true;
 }
 
-IRValue IRGenerator::toBool(const IRValue& v, FunctionContext& fn) {
-    if (v.type == "i1") return v;
+IRValue IRGenerator::toBool(const IRValue& v, const Type* t, FunctionContext& fn) {
     IRValue out; out.type = "i1"; out.reg = newTemp(fn);
-    fn.body << "  " << out.reg << " = icmp ne i32 " << v.reg << ", 0\n";
+    if (isFloat(t)) {
+        fn.body << "  " << out.reg << " = fcmp une float " << v.reg << ", 0.0\n";
+    } else if (isPointer(t)) {
+        fn.body << "  " << out.reg << " = icmp ne " << v.type << " " << v.reg << ", null\n";
+    } else {
+        fn.body << "  " << out.reg << " = icmp ne " << v.type << " " << v.reg << ", 0\n";
+    }
+    return out;
+}
+
+// Applies the implicit conversion semantic analysis recorded on e. Array
+// decay has already happened in emitValue.
+IRValue IRGenerator::convertValue(const IRValue& v, const Expr* e, FunctionContext& fn) {
+    if (e->conv == ImplicitConv::None || e->conv == ImplicitConv::ArrayToPointer) return v;
+    IRValue out; out.type = typeToIR(e->convertedType); out.reg = newTemp(fn);
+    const char* inst = "bitcast";
+    switch (e->conv) {
+        case ImplicitConv::CharToInt: inst = "sext"; break;
+        case ImplicitConv::IntToChar: inst = "trunc"; break;
+        case ImplicitConv::IntToFloat: inst = "sitofp"; break;
+        case ImplicitConv::FloatToInt: inst = "fptosi"; break;
+        case ImplicitConv::PointerCast: inst = "bitcast"; break;
+        case ImplicitConv::IntToPointer: inst = "inttoptr"; break;
+        case ImplicitConv::PointerToInt: inst = "ptrtoint"; break;
+        default: break;
+    }
+    fn.body << "  " << out.reg << " = " << inst << " " << v.type << " " << v.reg << " to " << out.type << "\n";
     return out;
 }
 
-std::string IRGenerator::ensureAlloca(const std::string& name, FunctionContext& fn) {
-    auto it = fn.locals.find(name);
-    if (it != fn.locals.end()) return it->second;
-    std::string a = newTemp(fn);
-    std::string ty = fn.localTypes.count(name) ? fn.localTypes[name] : std::string("i32");
-    fn.entryAllocas.push_back("  " + a + " = alloca " + ty + "\n");
-    fn.locals[name] = a;
-    if (!fn.localTypes.count(name)) fn.localTypes[name] = ty;
-    return a;
+std::string IRGenerator::slotAddress(int slot, FunctionContext& fn) {
+    std::string& addr = fn.slotAddr[static_cast<size_t>(slot)];
+    if (addr.empty()) {
+        const Type* type = fn.node->slots[static_cast<size_t>(slot)].type;
+        addr = newTemp(fn);
+        fn.entryAllocas.push_back("  " + addr + " = alloca " + typeToIR(type) + "\n");
+        long long size = static_cast<long long>(sizeOf(type));
+        ++frames.locals;
+        frames.before += size;
+        ++frames.allocas;
+        frames.after += size;
+    }
+    return addr;
 }
 
-IRValue IRGenerator::getStringPtr(const std::string& s, FunctionContext& fn) {
+IRValue IRGenerator::getStringPtr(const std::string& s) {
     auto it = strToGlobal.find(s);
     std::string g;
+    // the lexer hands over the literal with its C escapes still in place
+    std::string text; text.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '\\' || i + 1 == s.size()) { text += s[i]; continue; }
+        char c = s[++i];
+        text += (c == 'n' ? '\n' : c == 't' ? '\t' : c == '0' ? '\0' : c == 'r' ? '\r' : c);
+    }
+    size_t n = text.size()+1;
     if (it == strToGlobal.end()) {
         std::string name = "@.str" + std::to_string(strToGlobal.size());
         // escape string content
-        std::string esc; esc.reserve(s.size()*2);
-        for (unsigned char c : s) {
-            if (c == '\n') esc += "\\0A"; else if (c == '\t') esc += "\\09"; else if (c == '\\') esc += "\\5C"; else if (c == '"') esc += "\\22"; else esc += c;
+        std::string esc; esc.reserve(text.size()*2);
+        for (unsigned char c : text) {
+            if (c == '\n') esc += "\\0A"; else if (c == '\t') esc += "\\09"; else if (c == '\r') esc += "\\0D"; else if (c == 0) esc += "\\00"; else if (c == '\\') esc += "\\5C"; else if (c == '"') esc += "\\22"; else esc += c;
         }
-        size_t n = s.size()+1;
         globalDefs.push_back(name + " = private unnamed_addr constant [" + std::to_string(n) + " x i8] c\"" + esc + "\\00\", align 1\n");
         strToGlobal.emplace(s, name);
         g = name;
     } else {
         g = it->second;
     }
-    IRValue out; out.type = "i8*"; out.reg = newTemp(fn);
-    size_t n = s.size()+1;
-    fn.body << "  " << out.reg << " = getelementptr inbounds [" << n << " x i8], [" << n << " x i8]* " << g << ", i64 0, i64 0\n";
-    return out;
+    // a constant expression: no instruction per use
+    std::string arr = "[" + std::to_string(n) + " x i8]";
+    return IRValue{"getelementptr inbounds (" + arr + ", " + arr + "* " + g + ", i64 0, i64 0)", "i8*"};
 }
 
 IRValue IRGenerator::lvalueAddress(const Expr* e, FunctionContext& fn) {
+    IRValue addr; addr.type = typeToIR(e->type) + "*";
     if (auto v = dynamic_cast<const VarExpr*>(e)) {
-        // Prefer global if present
-        auto git = globalVars.find(v->name);
-        if (git != globalVars.end()) {
-            return IRValue{git->second, "i32*"};
-        }
-        std::string a = ensureAlloca(v->name, fn);
-        return IRValue{a, "i32*"};
+        addr.reg = slotAddress(v->slot, fn);
+        return addr;
+    }
+    if (auto u = dynamic_cast<const UnaryExpr*>(e)) { // *p
+        addr.reg = emitExpr(u->operand.get(), fn).reg;
+        return addr;
     }
     if (auto m = dynamic_cast<const MemberExpr*>(e)) {
-        // base.field where base is a local/global struct variable
-        std::string sname;
-        std::string basePtr;
-        bool isGlobal = false;
-        if (auto bv = dynamic_cast<VarExpr*>(m->base.get())) {
-            auto itL = fn.localStructName.find(bv->name);
-            if (itL != fn.localStructName.end()) { sname = itL->second; basePtr = fn.locals[bv->name]; }
-            auto itG = globalStructName.find(bv->name);
-            if (sname.empty() && itG != globalStructName.end()) { sname = itG->second; basePtr = globalVars[bv->name]; isGlobal = true; }
-        }
-        if (!sname.empty()) {
-            ensureStructType(sname);
-            // lookup field index and type
-            extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
-            size_t idx = 0; std::string fty = "i32";
-            auto &vec = g_struct_field_types[sname];
-            for (size_t i=0;i<vec.size();++i) { if (vec[i].first == m->field) { idx = i; fty = vec[i].second; break; } }
-            IRValue gep; gep.type = fty + "*"; gep.reg = newTemp(fn);
-            if (isGlobal) {
-                fn.body << "  " << gep.reg << " = getelementptr inbounds %struct." << sname << ", %struct." << sname << "* " << basePtr << ", i32 0, i32 " << idx << "\n";
-            } else {
-                fn.body << "  " << gep.reg << " = getelementptr inbounds %struct." << sname << ", %struct." << sname << "* " << basePtr << ", i32 0, i32 " << idx << "\n";
-            }
-            return gep;
-        }
+        IRValue base = lvalueAddress(m->base.get(), fn);
+        std::string sty = typeToIR(m->base->type);
+        addr.reg = newTemp(fn);
+        fn.body << "  " << addr.reg << " = getelementptr inbounds " << sty << ", " << base.type << " " << base.reg << ", i32 0, i32 " << m->fieldIndex << "\n";
+        return addr;
     }
     if (auto pm = dynamic_cast<const PtrMemberExpr*>(e)) {
-        // base->field where base is a pointer to struct
         IRValue base = emitExpr(pm->base.get(), fn);
-        // Heuristic: if base.type is %struct.X*, extract X
-        std::string sname;
-        if (base.type.rfind("%struct.", 0) == 0) {
-            auto pos = base.type.find('*');
-            sname = base.type.substr(std::string("%struct.").size(), pos - std::string("%struct.").size());
-        }
-        ensureStructType(sname);
-        extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
-        size_t idx = 0; std::string fty = "i32";
-        auto &vec = g_struct_field_types[sname];
-        for (size_t i=0;i<vec.size();++i) { if (vec[i].first == pm->field) { idx = i; fty = vec[i].second; break; } }
-        IRValue gep; gep.type = fty + "*"; gep.reg = newTemp(fn);
-        fn.body << "  " << gep.reg << " = getelementptr inbounds %struct." << (sname.empty()?std::string("S"):sname) << ", %struct." << (sname.empty()?std::string("S"):sname) << "* " << base.reg << ", i32 0, i32 " << idx << "\n";
-        return gep;
+        std::string sty = typeToIR(pm->base->valueType()->element);
+        addr.reg = newTemp(fn);
+        fn.body << "  " << addr.reg << " = getelementptr inbounds " << sty << ", " << base.type << " " << base.reg << ", i32 0, i32 " << pm->fieldIndex << "\n";
+        return addr;
     }
     if (auto idx = dynamic_cast<const ArrayIndexExpr*>(e)) {
-        // Base can be local array name or a pointer
-        if (auto v = dynamic_cast<VarExpr*>(idx->base.get())) {
-            auto it = fn.localArrayLen.find(v->name);
-            IRValue iv = emitExpr(idx->index.get(), fn);
-            // Cast index to i64
-            IRValue idx64; idx64.type = "i64"; idx64.reg = newTemp(fn);
-            fn.body << "  " << idx64.reg << " = zext i32 " << iv.reg << " to i64\n";
-            if (it != fn.localArrayLen.end()) {
-                // GEP into [N x i32]
-                std::string arr = fn.locals[v->name];
-                std::string elemTy = fn.localArrayElem.count(v->name) ? fn.localArrayElem[v->name] : std::string("i32");
-                IRValue eltPtr; eltPtr.type = elemTy + "*"; eltPtr.reg = newTemp(fn);
-                fn.body << "  " << eltPtr.reg << " = getelementptr inbounds [" << it->second << " x " << elemTy << "], [" << it->second << " x " << elemTy << "]* " << arr << ", i64 0, i64 " << idx64.reg << "\n";
-                return eltPtr;
-            } else {
-                // Treat as pointer i32*
-                IRValue basePtr = emitExpr(idx->base.get(), fn);
-                std::string elemTy = (basePtr.type == "i8*") ? std::string("i8") : std::string("i32");
-                IRValue eltPtr; eltPtr.type = elemTy + "*"; eltPtr.reg = newTemp(fn);
-                fn.body << "  " << eltPtr.reg << " = getelementptr inbounds " << elemTy << ", " << elemTy << "* " << basePtr.reg << ", i64 " << idx64.reg << "\n";
-                return eltPtr;
-            }
+        // arrays are indexed in place; other bases are pointer values
+        bool inPlace = idx->base->type->kind == TypeKind::Array;
+        IRValue base = inPlace ? lvalueAddress(idx->base.get(), fn) : emitExpr(idx->base.get(), fn);
+        IRValue iv = emitExpr(idx->index.get(), fn);
+        if (inPlace && opts.boundsCheck) checkBounds(idx, iv, fn);
+        IRValue idx64; idx64.type = "i64"; idx64.reg = newTemp(fn);
+        fn.body << "  " << idx64.reg << " = zext i32 " << iv.reg << " to i64\n";
+        addr.reg = newTemp(fn);
+        if (inPlace) {
+            std::string arrTy = typeToIR(idx->base->type);
+            fn.body << "  " << addr.reg << " = getelementptr inbounds " << arrTy << ", " << base.type << " " << base.reg << ", i64 0, i64 " << idx64.reg << "\n";
         } else {
-            // Pointer base
-            IRValue basePtr = emitExpr(idx->base.get(), fn);
-            IRValue iv = emitExpr(idx->index.get(), fn);
-            IRValue idx64; idx64.type = "i64"; idx64.reg = newTemp(fn);
-            fn.body << "  " << idx64.reg << " = zext i32 " << iv.reg << " to i64\n";
-            std::string elemTy = (basePtr.type == "i8*") ? std::string("i8") : std::string("i32");
-            IRValue eltPtr; eltPtr.type = elemTy + "*"; eltPtr.reg = newTemp(fn);
-            fn.body << "  " << eltPtr.reg << " = getelementptr inbounds " << elemTy << ", " << elemTy << "* " << basePtr.reg << ", i64 " << idx64.reg << "\n";
-            return eltPtr;
+            std::string elemTy = typeToIR(e->type);
+            fn.body << "  " << addr.reg << " = getelementptr inbounds " << elemTy << ", " << base.type << " " << base.reg << ", i64 " << idx64.reg << "\n";
         }
+        return addr;
     }
     assert(false && "unsupported lvalue");
     return IRValue{"", ""};
 }
-void IRGenerator::ensureStructType(const std::string& name) {
-    if (name.empty()) return;
-    if (usedStructs.count(name)) return;
-    usedStructs.insert(name);
-    // Query parser-registered struct field types
-    extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
-    auto it = g_struct_field_types.find(name);
-    if (it == g_struct_field_types.end() || it->second.empty()) {
-        structTypeDefs.push_back("%struct." + name + " = type { i32 }\n");
+void IRGenerator::ensureStructType(const Type* st) {
+    if (!usedStructs.insert(st->structName).second) return;
+    if (!st->layout) {
+        structTypeDefs.push_back("%struct." + st->structName + " = type opaque\n");
         return;
     }
+    // fields in memory order; LLVM's default layout inserts the same padding
     std::ostringstream ty;
-    ty << "%struct." << name << " = type { ";
-    for (size_t i=0;i<it->second.size();++i) {
+    ty << "%struct." << st->structName << " = type { ";
+    const StructLayout& l = *st->layout;
+    for (size_t i = 0; i < l.memoryOrder.size(); ++i) {
         if (i) ty << ", ";
-        ty << it->second[i].second; // IR type like i32/i8
+        ty << typeToIR(l.fields[l.memoryOrder[i]].type);
     }
     ty << " }\n";
     structTypeDefs.push_back(ty.str());
 }
 
 IRValue IRGenerator::emitExpr(const Expr* e, FunctionContext& fn) {
+    return convertValue(emitValue(e, fn), e, fn);
+}
+
+IRValue IRGenerator::emitValue(const Expr* e, FunctionContext& fn) {
     if (auto num = dynamic_cast<const NumberExpr*>(e)) {
         return IRValue{std::to_string(num->value), "i32"};
     }
     if (auto fl = dynamic_cast<const FloatLiteralExpr*>(e)) {
-        // LLVM textual float literal as decimal; keep as float
-        return IRValue{std::to_string(fl->value), "float"};
+        return IRValue{floatLiteral(fl->value), "float"};
+    }
+    if (auto z = dynamic_cast<const SizeofExpr*>(e)) {
+        return IRValue{std::to_string(z->size), "i32"};
     }
     if (auto s = dynamic_cast<const StringLiteralExpr*>(e)) {
-        return getStringPtr(s->value, fn);
+        return getStringPtr(s->value);
+    }
+    if (auto v = dynamic_cast<const VarExpr*>(e); v && v->function) {
+        declareExtern(v->function);
+        return IRValue{"@" + v->name, typeToIR(v->type)};
+    }
+    if (e->isLValue) {
+        IRValue addr = lvalueAddress(e, fn);
+        if (e->type->kind == TypeKind::Array) {
+            // decays: address of the first element
+            IRValue out; out.type = typeToIR(e->type->element) + "*"; out.reg = newTemp(fn);
+            std::string arrTy = typeToIR(e->type);
+            fn.body << "  " << out.reg << " = getelementptr inbounds " << arrTy << ", " << addr.type << " " << addr.reg << ", i64 0, i64 0\n";
+            return out;
+        }
+        IRValue out; out.type = typeToIR(e->type); out.reg = newTemp(fn);
+        fn.body << "  " << out.reg << " = load " << out.type << ", " << addr.type << " " << addr.reg << tbaaTag(e) << "\n";
+        return out;
     }
     if (auto bin = dynamic_cast<const BinaryExpr*>(e)) {
         if (bin->op == "&&" || bin->op == "||") {
-            IRValue l = emitExpr(bin->lhs.get(), fn);
-            l = toBool(l, fn);
-            IRValue r = emitExpr(bin->rhs.get(), fn);
-            r = toBool(r, fn);
+            IRValue l = toBool(emitExpr(bin->lhs.get(), fn), bin->lhs->valueType(), fn);
+            IRValue r = toBool(emitExpr(bin->rhs.get(), fn), bin->rhs->valueType(), fn);
             IRValue out; out.type = "i1"; out.reg = newTemp(fn);
-            if (bin->op == "&&") {
-                fn.body << "  " << out.reg << " = and i1 " << l.reg << ", " << r.reg << "\n";
-            } else {
-                fn.body << "  " << out.reg << " = or i1 " << l.reg << ", " << r.reg << "\n";
-            }
-            // normalize to i32 for now
+            fn.body << "  " << out.reg << " = " << (bin->op == "&&" ? "and" : "or") << " i1 " << l.reg << ", " << r.reg << "\n";
             IRValue z; z.type = "i32"; z.reg = newTemp(fn);
             fn.body << "  " << z.reg << " = zext i1 " << out.reg << " to i32\n";
             return z;
         }
         IRValue l = emitExpr(bin->lhs.get(), fn);
         IRValue r = emitExpr(bin->rhs.get(), fn);
+        const Type* lt = bin->lhs->valueType();
+        const Type* rt = bin->rhs->valueType();
         std::string op = opToLlvm(bin->op);
-        if (l.type == "float" || r.type == "float") {
-            // float arithmetic or comparison
-            IRValue lf = (l.type == "float") ? l : ensureCast(l, "float", fn);
-            IRValue rf = (r.type == "float") ? r : ensureCast(r, "float", fn);
-            if (op.rfind("icmp", 0) == 0) {
-                // fcmp ordered comparisons
-                std::string pred = (bin->op=="<"?"olt": bin->op==">"?"ogt": bin->op=="<="?"ole": bin->op==">="?"oge": bin->op=="=="?"oeq":"one");
-                IRValue cmp; cmp.type = "i1"; cmp.reg = newTemp(fn);
-                fn.body << "  " << cmp.reg << " = fcmp " << pred << " float " << lf.reg << ", " << rf.reg << "\n";
-                IRValue z; z.type = "i32"; z.reg = newTemp(fn);
-                fn.body << "  " << z.reg << " = zext i1 " << cmp.reg << " to i32\n";
-                return z;
-            } else {
-                std::string fop = (bin->op=="+"?"fadd": bin->op=="-"?"fsub": bin->op=="*"?"fmul":"fdiv");
-                IRValue out; out.type = "float"; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = " << fop << " float " << lf.reg << ", " << rf.reg << "\n";
-                return out;
-            }
-        }
         if (op.rfind("icmp", 0) == 0) {
             IRValue cmp; cmp.type = "i1"; cmp.reg = newTemp(fn);
-            fn.body << "  " << cmp.reg << " = " << op << " i32 " << l.reg << ", " << r.reg << "\n";
+            if (isFloat(lt)) {
+                std::string pred = (bin->op=="<"?"olt": bin->op==">"?"ogt": bin->op=="<="?"ole": bin->op==">="?"oge": bin->op=="=="?"oeq":"une");
+                fn.body << "  " << cmp.reg << " = fcmp " << pred << " float " << l.reg << ", " << r.reg << "\n";
+            } else {
+                // pointers order as unsigned addresses
+                if (isPointer(lt) && op[6] == 's') op[6] = 'u';
+                fn.body << "  " << cmp.reg << " = " << op << " " << l.type << " " << l.reg << ", " << r.reg << "\n";
+            }
             IRValue z; z.type = "i32"; z.reg = newTemp(fn);
             fn.body << "  " << z.reg << " = zext i1 " << cmp.reg << " to i32\n";
             return z;
         }
-        // Pointer arithmetic: ptr +/- i32
-        if ((bin->op == "+" || bin->op == "-") && (isPointerIR(l.type) || isPointerIR(r.type))) {
-            IRValue base;
-            IRValue idx;
-            if (isPointerIR(l.type) && r.type == "i32") { base = l; idx = r; }
-            else if (isPointerIR(r.type) && l.type == "i32" && bin->op == "+") { base = r; idx = l; }
-            else {
-                // fallback integer op
-                IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = " << op << " i32 " << l.reg << ", " << r.reg << "\n";
-                return out;
-            }
+        if (isPointer(lt) || isPointer(rt)) {
+            // ptr +/- int, int + ptr
+            IRValue base = isPointer(lt) ? l : r;
+            IRValue idx = isPointer(lt) ? r : l;
             if (bin->op == "-") {
                 IRValue neg; neg.type = "i32"; neg.reg = newTemp(fn);
                 fn.body << "  " << neg.reg << " = sub i32 0, " << idx.reg << "\n";
@@ -314,140 +318,103 @@ IRValue IRGenerator::emitExpr(const Expr* e, FunctionContext& fn) {
             }
             IRValue idx64; idx64.type = "i64"; idx64.reg = newTemp(fn);
             fn.body << "  " << idx64.reg << " = sext i32 " << idx.reg << " to i64\n";
-            std::string elemTy = pointeeIR(base.type);
-            IRValue outp; outp.type = base.type; outp.reg = newTemp(fn);
-            fn.body << "  " << outp.reg << " = getelementptr inbounds " << elemTy << ", " << elemTy << "* " << base.reg << ", i64 " << idx64.reg << "\n";
-            return outp;
+            std::string elemTy = typeToIR(e->type->element);
+            IRValue out; out.type = base.type; out.reg = newTemp(fn);
+            fn.body << "  " << out.reg << " = getelementptr inbounds " << elemTy << ", " << base.type << " " << base.reg << ", i64 " << idx64.reg << "\n";
+            return out;
         }
-        IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-        fn.body << "  " << out.reg << " = " << op << " i32 " << l.reg << ", " << r.reg << "\n";
-        return out;
-    }
-    if (auto v = dynamic_cast<const VarExpr*>(e)) {
-        // Load from local or global
-        auto git = globalVars.find(v->name);
-        IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-        if (git != globalVars.end()) {
-            std::string ty = globalVarTypes[v->name].empty() ? std::string("i32") : globalVarTypes[v->name];
-            fn.body << "  " << out.reg << " = load " << ty << ", " << ty << "* " << git->second << "\n";
-            out.type = ty;
+        IRValue out; out.type = typeToIR(e->type); out.reg = newTemp(fn);
+        if (isFloat(e->type)) {
+            std::string fop = (bin->op=="+"?"fadd": bin->op=="-"?"fsub": bin->op=="*"?"fmul": bin->op=="/"?"fdiv":"frem");
+            fn.body << "  " << out.reg << " = " << fop << " float " << l.reg << ", " << r.reg << "\n";
         } else {
-            std::string a = ensureAlloca(v->name, fn);
-            std::string ty = fn.localTypes[v->name].empty() ? std::string("i32") : fn.localTypes[v->name];
-            fn.body << "  " << out.reg << " = load " << ty << ", " << ty << "* " << a << "\n";
-            out.type = ty;
+            // signed overflow is undefined in C
+            bool nsw = !opts.wrapv && (op == "add" || op == "sub" || op == "mul");
+            fn.body << "  " << out.reg << " = " << op << (nsw ? " nsw" : "") << " i32 " << l.reg << ", " << r.reg << "\n";
         }
         return out;
     }
     if (auto un = dynamic_cast<const UnaryExpr*>(e)) {
+        if (un->op == "&") return lvalueAddress(un->operand.get(), fn);
         IRValue v = emitExpr(un->operand.get(), fn);
         if (un->op == "-") {
-            IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-            fn.body << "  " << out.reg << " = sub i32 0, " << v.reg << "\n";
+            IRValue out; out.type = v.type; out.reg = newTemp(fn);
+            if (isFloat(e->type)) fn.body << "  " << out.reg << " = fneg float " << v.reg << "\n";
+            else fn.body << "  " << out.reg << " = sub" << (opts.wrapv ? "" : " nsw") << " i32 0, " << v.reg << "\n";
             return out;
         }
         if (un->op == "!") {
+            const Type* ot = un->operand->valueType();
             IRValue cmp; cmp.type = "i1"; cmp.reg = newTemp(fn);
-            fn.body << "  " << cmp.reg << " = icmp eq i32 " << v.reg << ", 0\n";
+            if (isFloat(ot)) fn.body << "  " << cmp.reg << " = fcmp oeq float " << v.reg << ", 0.0\n";
+            else fn.body << "  " << cmp.reg << " = icmp eq " << v.type << " " << v.reg << (isPointer(ot) ? ", null\n" : ", 0\n");
             IRValue z; z.type = "i32"; z.reg = newTemp(fn);
             fn.body << "  " << z.reg << " = zext i1 " << cmp.reg << " to i32\n";
             return z;
         }
-        if (un->op == "&") {
-            IRValue addr = lvalueAddress(un->operand.get(), fn);
-            return addr;
-        }
-        if (un->op == "*") {
-            // load from pointer
-            std::string elemTy = pointeeIR(v.type);
-            IRValue out; out.type = elemTy; out.reg = newTemp(fn);
-            fn.body << "  " << out.reg << " = load " << elemTy << ", " << elemTy << "* " << v.reg << "\n";
-            return out;
-        }
     }
     if (auto asn = dynamic_cast<const AssignExpr*>(e)) {
         IRValue addr = lvalueAddress(asn->target.get(), fn);
         IRValue val = emitExpr(asn->value.get(), fn);
-        std::string dataTy = pointeeIR(addr.type);
-        std::string vTy = val.type;
-        if (dataTy != vTy) {
-            // simple int widening/narrowing between i8 and i32
-            IRValue casted = val;
-            if (dataTy == "i32" && vTy == "i8") {
-                casted.type = "i32"; casted.reg = newTemp(fn);
-                fn.body << "  " << casted.reg << " = zext i8 " << val.reg << " to i32\n";
-            } else if (dataTy == "i8" && vTy == "i32") {
-                casted.type = "i8"; casted.reg = newTemp(fn);
-                fn.body << "  " << casted.reg << " = trunc i32 " << val.reg << " to i8\n";
-            }
-            val = casted;
-        }
-        fn.body << "  store " << dataTy << " " << val.reg << ", " << dataTy << "* " << addr.reg << "\n";
+        fn.body << "  store " << val.type << " " << val.reg << ", " << addr.type << " " << addr.reg << tbaaTag(asn->target.get()) << "\n";
         return val;
     }
     if (auto call = dynamic_cast<const CallExpr*>(e)) {
-        if (auto calleeVar = dynamic_cast<VarExpr*>(call->callee.get())) {
+        auto calleeVar = dynamic_cast<const VarExpr*>(call->callee.get());
+        // a malloc the escape analysis moved to the stack; its size is a constant
+        if (auto it = fn.stackAllocs.find(call); it != fn.stackAllocs.end()) return IRValue{it->second, "i8*"};
+        std::vector<IRValue> vals;
+        for (const auto& arg : call->args) vals.push_back(emitExpr(arg.get(), fn));
+        if (calleeVar && !call->target && calleeVar->slot < 0) {
             const std::string& name = calleeVar->name;
-            if (name == "printf") {
-                IRValue fmt = emitExpr(call->args[0].get(), fn);
-                IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = call i32 (i8*, ...) @printf(i8* " << fmt.reg;
-                for (size_t i=1;i<call->args.size();++i) {
-                    IRValue ai = emitExpr(call->args[i].get(), fn);
-                    fn.body << ", " << ai.type << " " << ai.reg;
+            if (name == "printf" || name == "scanf") {
+                libcDecls.insert("declare i32 @" + name + "(i8*, ...)");
+                for (auto& v : vals) {
+                    if (v.type != "float") continue;
+                    // variadic floats are passed as double
+                    IRValue d; d.type = "double"; d.reg = newTemp(fn);
+                    fn.body << "  " << d.reg << " = fpext float " << v.reg << " to double\n";
+                    v = d;
                 }
-                fn.body << ")\n";
-                return out;
-            }
-            if (name == "scanf") {
-                IRValue fmt = emitExpr(call->args[0].get(), fn);
                 IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = call i32 (i8*, ...) @scanf(i8* " << fmt.reg << ")\n";
+                fn.body << "  " << out.reg << " = call i32 (i8*, ...) @" << name << "(";
+                for (size_t i = 0; i < vals.size(); ++i) fn.body << (i ? ", " : "") << vals[i].type << " " << vals[i].reg;
+                fn.body << ")\n";
                 return out;
             }
             if (name == "malloc") {
-                usedMalloc = true;
-                IRValue sz = emitExpr(call->args[0].get(), fn);
+                libcDecls.insert("declare noalias i8* @malloc(i64)");
+                IRValue sz; sz.type = "i64"; sz.reg = newTemp(fn);
+                fn.body << "  " << sz.reg << " = sext i32 " << vals[0].reg << " to i64\n";
                 IRValue out; out.type = "i8*"; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = call i8* @malloc(i64 " << sz.reg << ")\n";
+                if (!opts.heapProfile.empty())
+                    fn.body << "  " << out.reg << " = call i8* @__heap.malloc(i64 " << sz.reg << ", i32 " << heapSite(call, fn) << ")\n";
+                else
+                    fn.body << "  " << out.reg << " = call i8* @malloc(i64 " << sz.reg << ")\n";
                 return out;
             }
             if (name == "free") {
-                usedFree = true;
-                IRValue p = emitExpr(call->args[0].get(), fn);
-                fn.body << "  call void @free(i8* " << p.reg << ")\n";
+                auto p = dynamic_cast<const VarExpr*>(call->args[0].get());
+                if (p && fn.stackSlots.count(p->slot)) return IRValue{"0", "i32"};
+                libcDecls.insert("declare void @free(i8*)");
+                fn.body << "  call void @" << (opts.heapProfile.empty() ? "free" : "__heap.free") << "(i8* " << vals[0].reg << ")\n";
                 return IRValue{"0","i32"};
             }
-            // Known function definitions or externs
-            auto itR = funcRetIR.find(name);
-            if (itR != funcRetIR.end()) {
-                std::string retTy = itR->second;
-                IRValue out; out.type = retTy; out.reg = newTemp(fn);
-                fn.body << "  " << out.reg << " = call " << retTy << " @" << name << "(";
-                const auto& ptys = funcParamIR[name];
-                for (size_t i=0;i<call->args.size();++i) {
-                    IRValue ai = emitExpr(call->args[i].get(), fn);
-                    std::string wanted = (i < ptys.size() ? ptys[i] : ai.type);
-                    ai = ensureCast(ai, wanted, fn);
-                    if (i) fn.body << ", ";
-                    fn.body << wanted << " " << ai.reg;
-                }
-                fn.body << ")\n";
-                usedFunctions.insert(name);
-                return out;
-            }
         }
-        // Generic direct call with i32 args and i32 return
-        IRValue out; out.type = "i32"; out.reg = newTemp(fn);
-        // Try function pointer call
-        IRValue cal = emitExpr(call->callee.get(), fn);
-        fn.body << "  " << out.reg << " = call i32 " << cal.reg << "(";
-        for (size_t i=0;i<call->args.size();++i) {
-            IRValue ai = emitExpr(call->args[i].get(), fn);
-            if (i) fn.body << ", ";
-            fn.body << ai.type << " " << ai.reg;
+        std::string callee;
+        if (call->target) {
+            callee = "@" + call->target->name;
+            declareExtern(call->target);
+        } else {
+            callee = emitExpr(call->callee.get(), fn).reg;
         }
+        IRValue out; out.type = typeToIR(e->type);
+        fn.body << "  ";
+        if (out.type != "void") { out.reg = newTemp(fn); fn.body << out.reg << " = "; }
+        fn.body << "call " << out.type << " " << callee << "(";
+        for (size_t i = 0; i < vals.size(); ++i) fn.body << (i ? ", " : "") << vals[i].type << " " << vals[i].reg;
         fn.body << ")\n";
+        if (out.type == "void") return IRValue{"0", "i32"};
         return out;
     }
     assert(false && "unsupported expr");
@@ -456,8 +423,16 @@ IRValue IRGenerator::emitExpr(const Expr* e, FunctionContext& fn) {
 
 void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
     if (auto r = dynamic_cast<const ReturnStmt*>(s)) {
-        IRValue v = emitExpr(r->value.get(), fn);
-        fn.body << "  ret i32 " << v.reg << "\n";
+        std::string retTy = typeToIR(fn.node->returnType);
+        if (!r->value || retTy == "void") {
+            if (r->value) (void)emitExpr(r->value.get(), fn);
+            if (!opts.instrumentFunctions.empty()) instrumentExit(fn);
+            fn.body << "  ret void\n";
+        } else {
+            IRValue v = emitExpr(r->value.get(), fn);
+            if (!opts.instrumentFunctions.empty()) instrumentExit(fn);
+            fn.body << "  ret " << retTy << " " << v.reg << "\n";
+        }
         fn.currentTerminated = true;
         return;
     }
@@ -470,42 +445,50 @@ void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
         std::string bodyL = newLabel(fn, "while.body");
         std::string endL  = newLabel(fn, "while.end");
         branch(fn, condL);
-        fn.currentLabel = condL; fn.currentTerminated = false; fn.body << condL << ":\n";
-        IRValue c = toBool(emitExpr(w->condition.get(), fn), fn);
+        startBlock(fn, condL);
+        IRValue c = toBool(emitExpr(w->condition.get(), fn), w->condition->valueType(), fn);
         cbranch(fn, c, bodyL, endL);
-        fn.currentLabel = bodyL; fn.currentTerminated = false; fn.body << bodyL << ":\n";
+        startBlock(fn, bodyL);
+        fn.loopStack.push_back(LoopTargets{condL, endL, fn.scopes.size()});
         emitStmt(w->body.get(), fn);
+        fn.loopStack.pop_back();
         branch(fn, condL);
-        fn.currentLabel = endL; fn.currentTerminated = false; fn.body << endL << ":\n";
+        startBlock(fn, endL);
         return;
     }
     if (auto i = dynamic_cast<const IfStmt*>(s)) {
         std::string thenL = newLabel(fn, "if.then");
         std::string elseL = newLabel(fn, "if.else");
         std::string endL  = newLabel(fn, "if.end");
-        IRValue c = toBool(emitExpr(i->condition.get(), fn), fn);
+        IRValue c = toBool(emitExpr(i->condition.get(), fn), i->condition->valueType(), fn);
         cbranch(fn, c, thenL, (i->elseBranch?elseL:endL));
-        fn.currentLabel = thenL; fn.currentTerminated = false; fn.body << thenL << ":\n";
+        startBlock(fn, thenL);
         emitStmt(i->thenBranch.get(), fn);
         branch(fn, endL);
         if (i->elseBranch) {
-            fn.currentLabel = elseL; fn.currentTerminated = false; fn.body << elseL << ":\n";
+            startBlock(fn, elseL);
             emitStmt(i->elseBranch.get(), fn);
             branch(fn, endL);
         }
-        fn.currentLabel = endL; fn.currentTerminated = false; fn.body << endL << ":\n";
+        startBlock(fn, endL);
         return;
     }
     if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+        openScope(b, fn);
         emitBlock(b, fn);
+        closeScope(fn);
         return;
     }
     if (auto brk = dynamic_cast<const BreakStmt*>(s)) {
-        if (!fn.loopStack.empty()) branch(fn, fn.loopStack.back().breakLabel);
+        if (fn.loopStack.empty()) return;
+        endScopes(fn.loopStack.back().scopes, fn);
+        branch(fn, fn.loopStack.back().breakLabel);
         return;
     }
     if (auto cont = dynamic_cast<const ContinueStmt*>(s)) {
-        if (!fn.loopStack.empty()) branch(fn, fn.loopStack.back().continueLabel);
+        if (fn.loopStack.empty()) return;
+        endScopes(fn.loopStack.back().scopes, fn);
+        branch(fn, fn.loopStack.back().continueLabel);
         return;
     }
     if (auto g = dynamic_cast<const GotoStmt*>(s)) {
@@ -522,12 +505,12 @@ void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
         std::string endL  = newLabel(fn, "do.end");
         branch(fn, bodyL);
         startBlock(fn, bodyL);
-        fn.loopStack.push_back(LoopTargets{condL, endL});
+        fn.loopStack.push_back(LoopTargets{condL, endL, fn.scopes.size()});
         emitStmt(dw->body.get(), fn);
         fn.loopStack.pop_back();
         branch(fn, condL);
         startBlock(fn, condL);
-        IRValue c = toBool(emitExpr(dw->condition.get(), fn), fn);
+        IRValue c = toBool(emitExpr(dw->condition.get(), fn), dw->condition->valueType(), fn);
         cbranch(fn, c, bodyL, endL);
         startBlock(fn, endL);
         return;
@@ -537,28 +520,47 @@ void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
         std::string bodyL = newLabel(fn, "for.body");
         std::string iterL = newLabel(fn, "for.iter");
         std::string endL  = newLabel(fn, "for.end");
-        if (f->init) emitStmt(f->init.get(), fn);
+        openScope(f, fn);
+        // bounds checks in the body can rely on the induction variable's range
+        int inductionSlot = -1;
+        Interval induction{};
+        bool ranged = opts.boundsCheck && inductionRange(f, fn, inductionSlot, induction);
+        // a vectorized loop has run init; the scalar loop below is its tail
+        bool vectorized = opts.vectorize && vectorizeFor(f, fn);
+        if (f->init && !vectorized) emitStmt(f->init.get(), fn);
+        auto body = [&] {
+            if (ranged) fn.ranges[inductionSlot] = induction;
+            emitStmt(f->body.get(), fn);
+            if (ranged) fn.ranges.erase(inductionSlot);
+        };
+        // an unrolled loop leaves this one the iterations it did not run
+        if (!vectorized && opts.unrollLoops && unrollFor(f, fn, body)) {
+            closeScope(fn);
+            return;
+        }
         branch(fn, condL);
         startBlock(fn, condL);
         if (f->condition) {
-            IRValue c = toBool(emitExpr(f->condition.get(), fn), fn);
+            IRValue c = toBool(emitExpr(f->condition.get(), fn), f->condition->valueType(), fn);
             cbranch(fn, c, bodyL, endL);
         } else {
             branch(fn, bodyL);
         }
         startBlock(fn, bodyL);
-        fn.loopStack.push_back(LoopTargets{iterL, endL});
-        emitStmt(f->body.get(), fn);
+        fn.loopStack.push_back(LoopTargets{iterL, endL, fn.scopes.size()});
+        body();
         fn.loopStack.pop_back();
         branch(fn, iterL);
         startBlock(fn, iterL);
         if (f->iter) emitStmt(f->iter.get(), fn);
         branch(fn, condL);
         startBlock(fn, endL);
+        closeScope(fn);
         return;
     }
     if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
         IRValue v = emitExpr(sw->value.get(), fn);
+        if (opts.switchTables && switchTable(sw, v, fn)) return;
         std::string endL = newLabel(fn, "switch.end");
         std::string defaultL = sw->defaultBody.empty() ? endL : newLabel(fn, "switch.default");
         // Prepare labels for cases
@@ -571,20 +573,25 @@ void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
         for (auto& kv : caseLabels) {
             fn.body << "    i32 " << kv.first << ", label %" << kv.second << "\n";
         }
+        // No branch_weights: with the cases marked cold llc stops copying
+        // the code after the switch into each of them, which made the
+        // branchy kernel slower under -fprofile-use.
         fn.body << "  ]\n";
+        fn.currentTerminated = true;
         // Push break target
-        fn.loopStack.push_back(LoopTargets{"", endL});
+        fn.loopStack.push_back(LoopTargets{"", endL, fn.scopes.size()});
         // Emit cases
         for (size_t i=0;i<sw->cases.size();++i) {
+            branch(fn, caseLabels[i].second); // fallthrough from the case before
             startBlock(fn, caseLabels[i].second);
             for (const auto& st : sw->cases[i].statements) {
                 if (fn.currentTerminated) break;
                 emitStmt(st.get(), fn);
             }
-            // fallthrough allowed: no forced branch
         }
         // Default
         if (defaultL != endL) {
+            branch(fn, defaultL);
             startBlock(fn, defaultL);
             for (const auto& st : sw->defaultBody) {
                 if (fn.currentTerminated) break;
@@ -592,51 +599,33 @@ void IRGenerator::emitStmt(const Stmt* s, FunctionContext& fn) {
             }
         }
         // End
+        branch(fn, endL);
         startBlock(fn, endL);
         fn.loopStack.pop_back();
         return;
     }
     if (auto vd = dynamic_cast<const VarDeclStmt*>(s)) {
+        std::string ty = typeToIR(vd->type);
+        std::string addr;
         if (vd->isStatic) {
-            // global variable
-            std::string g = sanitizeGlobal(vd->name);
-            if (!globalVars.count(vd->name)) {
-                long init = 0;
-                if (vd->init) {
-                    if (auto num = dynamic_cast<NumberExpr*>(vd->init.get())) init = num->value;
-                }
-                std::string gty = "i32";
-                if (vd->type && vd->type->kind == TypeKind::Char) gty = "i8";
-                globalDefs.push_back(g + " = internal global " + gty + " " + std::to_string(init) + ", align 4\n");
-                globalVars[vd->name] = g;
-                globalVarTypes[vd->name] = gty;
-            }
-            if (vd->init && !dynamic_cast<NumberExpr*>(vd->init.get())) {
-                // runtime init: store at entry
-                IRValue a; a.type = globalVarTypes[vd->name] + "*"; a.reg = g;
-                IRValue val = emitExpr(vd->init.get(), fn);
-                fn.body << "  store " << globalVarTypes[vd->name] << " " << val.reg << ", " << globalVarTypes[vd->name] << "* " << a.reg << "\n";
-            }
+            // module global, initialized once; statics sharing a name get a suffix
+            std::string key = vd->name;
+            for (int n = 1; globalVars.count(key); ++n) key = vd->name + "." + std::to_string(n);
+            addr = sanitizeGlobal(key);
+            globalVars[key] = addr;
+            long init = 0;
+            if (auto num = dynamic_cast<NumberExpr*>(vd->init.get()); num && vd->init->conv == ImplicitConv::None) init = num->value;
+            std::string initText = vd->type->kind == TypeKind::Int || vd->type->kind == TypeKind::Char ? std::to_string(init)
+                                 : isFloat(vd->type) ? floatLiteral(0) : isPointer(vd->type) ? "null" : "zeroinitializer";
+            globalDefs.push_back(addr + " = internal global " + ty + " " + initText + ", align 4\n");
+            fn.slotAddr[static_cast<size_t>(vd->slot)] = addr;
+            if (!vd->init || (dynamic_cast<NumberExpr*>(vd->init.get()) && vd->init->conv == ImplicitConv::None)) return;
         } else {
-            if (vd->type && vd->type->kind == TypeKind::Array) {
-                // allocate array
-                size_t n = vd->type->arrayLength;
-                std::string a = newTemp(fn);
-                std::string elem = (vd->type->element && vd->type->element->kind == TypeKind::Char) ? std::string("i8") : std::string("i32");
-                fn.entryAllocas.push_back("  " + a + " = alloca [" + std::to_string(n) + " x " + elem + "]\n");
-                fn.locals[vd->name] = a;
-                fn.localArrayLen[vd->name] = n;
-                fn.localTypes[vd->name] = "[" + std::to_string(n) + " x " + elem + "]";
-                fn.localArrayElem[vd->name] = elem;
-            } else {
-                std::string a = ensureAlloca(vd->name, fn);
-                if (vd->init) {
-                    IRValue val = emitExpr(vd->init.get(), fn);
-                    std::string ty = fn.localTypes[vd->name].empty() ? std::string("i32") : fn.localTypes[vd->name];
-                    fn.body << "  store " << ty << " " << val.reg << ", " << ty << "* " << a << "\n";
-                }
-            }
+            addr = slotAddress(vd->slot, fn);
+            if (!vd->init) return;
         }
+        IRValue val = emitExpr(vd->init.get(), fn);
+        fn.body << "  store " << ty << " " << val.reg << ", " << ty << "* " << addr << tbaaTag(vd->type) << "\n";
         return;
     }
 }
@@ -648,18 +637,26 @@ void IRGenerator::emitBlock(const BlockStmt* blk, FunctionContext& fn) {
     }
 }
 
+void IRGenerator::beginFunction(const Function& fnNode, FunctionContext& fn) {
+    fn.node = &fnNode;
+    fn.slotAddr.assign(fnNode.slots.size(), std::string());
+    // the entry label itself is written when the allocas are spliced in
+    fn.currentLabel = "entry";
+    if (opts.boundsCheck || opts.unrollLoops) analyzeRanges(fnNode, fn);
+    if (opts.heapToStack) findStackAllocations(fnNode, fn);
+    fn.colorSlots = opts.stackColoring;
+    forEachStmt(fnNode, [&](const Stmt* s) { if (dynamic_cast<const LabelStmt*>(s)) fn.colorSlots = false; });
+    if (!opts.profileGenerate.empty()) countBlock(fn);
+}
+
 void IRGenerator::emitFunctionPrologue(const Function& fnNode, FunctionContext& fn) {
-    // Map parameters to allocas and store incoming values
+    // Parameters live in allocas so they can be assigned and have their address taken
     for (size_t i = 0; i < fnNode.detailedParams.size(); ++i) {
         const auto& p = fnNode.detailedParams[i];
         std::string ty = typeToIR(p.type);
-        std::string a = newTemp(fn);
-        fn.entryAllocas.push_back("  " + a + " = alloca " + ty + "\n");
-        fn.locals[p.name] = a;
-        fn.localTypes[p.name] = ty;
+        std::string a = slotAddress(p.slot, fn);
         // Get LLVM argument name: %0, %1, ...
-        std::string arg = "%" + std::to_string(i);
-        fn.body << "  store " << ty << " " << arg << ", " << ty << "* " << a << "\n";
+        fn.body << "  store " << ty << " %" << i << ", " << ty << "* " << a << tbaaTag(p.type) << "\n";
     }
 }
 
@@ -671,134 +668,149 @@ std::string IRGenerator::getOrCreateLabel(FunctionContext& fn, const std::string
     return l;
 }
 
-std::string IRGenerator::generateModuleIR(const Function& fn) {
-    FunctionContext ctx;
-    // entry label will be auto-created
-    ctx.currentLabel.clear();
+// Buffered so that the globals, struct types and declarations it collects
+// can be printed ahead of it.
+std::string IRGenerator::emitFunction(const Function& fnNode) {
+    FunctionDraft draft = draftFunction(fnNode);
+    return finishFunction(draft);
+}
 
+IRGenerator::FunctionDraft IRGenerator::draftFunction(const Function& fnNode) {
+    MemTagScope fnTag(MemTag::FunctionContext);
+    FunctionContext ctx;
+    std::string retIR = typeToIR(fnNode.returnType);
     std::ostringstream out;
-    // Emit header
-    out << "; ModuleID = 'my_compiler'\n";
-    out << "source_filename = \"my_compiler\"\n\n";
-
-    // Function signature: i32 with i32 params
-    out << "define i32 @" << fn.name << "(";
-    for (size_t i=0;i<fn.detailedParams.size();++i) {
+    out << "define " << retIR << " @" << fnNode.name << "(";
+    for (size_t i = 0; i < fnNode.detailedParams.size(); ++i) {
         if (i) out << ", ";
-        out << "i32 %" << i;
-    }
-    out << ") {\n";
-
-    // Prologue
-    ensureBlock(ctx);
-
-    // Emit entry allocas later
-    emitFunctionPrologue(fn, ctx);
-    // Body
-    if (fn.bodyBlock) {
-        emitBlock(fn.bodyBlock.get(), ctx);
-    } else if (!fn.body.empty()) {
-        // Legacy single return
-        if (auto ret = dynamic_cast<ReturnStmt*>(fn.body.front().get())) {
-            IRValue v = emitExpr(ret->value.get(), ctx);
-            ctx.body << "  ret i32 " << v.reg << "\n";
-        } else {
-            ctx.body << "  ret i32 0\n";
-        }
-    } else {
-        ctx.body << "  ret i32 0\n";
+        out << typeToIR(fnNode.detailedParams[i].type) << " %" << i;
     }
+    out << ")";
 
-    // If the block wasn't terminated, ensure a return
+    beginFunction(fnNode, ctx);
+    emitFunctionPrologue(fnNode, ctx);
+    if (!opts.instrumentFunctions.empty()) instrumentEntry(ctx);
+    if (fnNode.bodyBlock) {
+        emitBlock(fnNode.bodyBlock.get(), ctx);
+    } else {
+        for (const auto& st : fnNode.body) {
+            if (ctx.currentTerminated) break;
+            emitStmt(st.get(), ctx);
+        }
+    }
     if (!ctx.currentTerminated) {
-        ctx.body << "  ret i32 0\n";
+        if (!opts.instrumentFunctions.empty()) instrumentExit(ctx);
+        ctx.body << fallthroughReturn(retIR);
     }
+    emitTrap(ctx);
 
     // Splice entry allocas at top
-    std::ostringstream bodyFull;
-    bodyFull << "entry:\n";
-    for (auto& a : ctx.entryAllocas) bodyFull << a;
-    bodyFull << ctx.body.str();
-    out << bodyFull.str();
-    out << "}\n\n";
-
-    // Struct type defs
+    MemTagScope textTag(MemTag::IRText);
+    out << functionAttributes(fnNode) << " {\n";
+    out << "entry:\n";
+    for (auto& a : ctx.entryAllocas) out << a;
+    return FunctionDraft{&fnNode, out.str(), ctx.body.str(), ctx.tempCounter, std::move(ctx.entryAllocas)};
+}
+
+std::string IRGenerator::finishFunction(FunctionDraft& draft) {
+    MemTagScope textTag(MemTag::IRText);
+    FunctionContext ctx;
+    ctx.tempCounter = draft.temps;
+    ctx.entryAllocas = std::move(draft.allocas);
+    std::string& body = draft.body;
+    if (opts.valueNumbering) body = numberValues(body, ctx);
+    if (opts.peephole) body = applyPeepholes(body, ctx);
+    return draft.head + body + "}\n\n";
+}
+
+std::string IRGenerator::addMetadata(const std::string& node) {
+    metadata.push_back(node);
+    return "!" + std::to_string(metadata.size() - 1);
+}
+
+void IRGenerator::declareExtern(const Function* f) {
+    if (!f->isExtern) return;
+    std::string d = "declare " + typeToIR(f->returnType) + " @" + f->name + "(";
+    for (size_t i = 0; i < f->detailedParams.size(); ++i) d += (i ? ", " : "") + typeToIR(f->detailedParams[i].type);
+    externDecls.insert(d + ")");
+}
+
+std::string IRGenerator::moduleText(const std::string& functions) {
+    std::ostringstream out;
+    out << "; ModuleID = 'my_compiler'\n";
+    out << "source_filename = \"my_compiler\"\n\n";
     for (auto& td : structTypeDefs) out << td;
-    // Globals
     for (auto& g : globalDefs) out << g;
-
-    // Declares
-    out << "declare i32 @printf(i8*, ...)\n";
-    out << "declare i32 @scanf(i8*, ...)\n";
-    if (usedMalloc) out << "declare noalias i8* @malloc(i64)\n";
-    if (usedFree) out << "declare void @free(i8*)\n";
+    if (!structTypeDefs.empty() || !globalDefs.empty()) out << "\n";
+    out << functions;
+    std::vector<std::string> dtors; // the runtimes' functions that write their data at exit
+    if (!profileCounters.empty()) { out << profileRuntime(); dtors.push_back("@__prof.dump"); }
+    if (!instrumented.empty()) { out << instrumentRuntime(); dtors.push_back("@__instr.dump"); }
+    if (!opts.heapProfile.empty()) { out << heapRuntime(); dtors.push_back("@__heap.dump"); }
+    if (!dtors.empty()) {
+        std::string entry = "{ i32, void ()*, i8* }";
+        out << "@llvm.global_dtors = appending global [" << dtors.size() << " x " << entry << "] [";
+        for (size_t i = 0; i < dtors.size(); ++i) out << (i ? ", " : "") << entry << " { i32 65535, void ()* " << dtors[i] << ", i8* null }";
+        out << "]\n\n";
+    }
+    for (const auto& d : libcDecls) out << d << "\n";
+    for (const auto& d : externDecls) out << d << "\n";
+    for (const auto& d : intrinsicDecls) out << d << "\n";
+    if (!metadata.empty()) out << "\n";
+    for (size_t i = 0; i < metadata.size(); ++i) out << "!" << i << " = " << metadata[i] << "\n";
     return out.str();
 }
 
+std::string IRGenerator::generateModuleIR(const Function& fn) {
+    return moduleText(emitFunction(fn));
+}
+
 std::string IRGenerator::generateModuleIR(const std::vector<std::unique_ptr<Function>>& fns) {
-    // Reset module state
+    beginModule();
+    // Functions are buffered so struct types and globals can precede them
+    MemTagScope modTag(MemTag::IRText);
+    std::vector<FunctionText> program;
+    for (const auto& fn : fns) {
+        if (fn->isExtern || !fn->reachable) continue;
+        MemStats::beginFunction(fn->name);
+        program.push_back(FunctionText{fn->name, emitFunction(*fn)});
+        MemStats::endFunction();
+    }
+    return finishModule(program);
+}
+
+void IRGenerator::beginModule() {
     strToGlobal.clear();
     globalDefs.clear();
     globalVars.clear();
-    globalVarTypes.clear();
-    usedMalloc = usedFree = false;
-    usedFunctions.clear();
-
-    std::ostringstream mod;
-    mod << "; ModuleID = 'my_compiler'\n";
-    mod << "source_filename = \"my_compiler\"\n\n";
-
-    // Record function declarations for calls between functions
-    funcParamIR.clear(); funcRetIR.clear();
-    for (const auto& fn : fns) {
-        std::vector<std::string> params;
-        for (const auto& p : fn->detailedParams) params.push_back(typeToIR(p.type));
-        funcParamIR[fn->name] = std::move(params);
-        funcRetIR[fn->name] = typeToIR(fn->returnType);
-    }
+    usedStructs.clear();
+    structTypeDefs.clear();
+    libcDecls.clear();
+    intrinsicDecls.clear();
+    externDecls.clear();
+    metadata.clear();
+    tbaaNodes.clear();
+    profileCounters.clear();
+    instrumented.clear();
+    heapSites.clear();
+    unlikelyWeights.clear();
+    bounds = BoundsStats{};
+    valueNumbering = ValueNumberingStats{};
+    peepholes = PeepholeStats{};
+    wholeProgram = WholeProgramStats{};
+    frames = FrameStats{};
+    functionAttrs = AttributeStats{};
+    switchTables = SwitchTableStats{};
+}
 
-    // Emit all functions
-    for (const auto& fn : fns) {
-        FunctionContext ctx;
-        ctx.currentLabel.clear();
-
-        std::string retIR = typeToIR(fn->returnType);
-        mod << "define " << retIR << " @" << fn->name << "(";
-        for (size_t i=0;i<fn->detailedParams.size();++i) {
-            if (i) mod << ", ";
-            mod << typeToIR(fn->detailedParams[i].type) << " %" << i;
-        }
-        mod << ") {\n";
-        ensureBlock(ctx);
-        emitFunctionPrologue(*fn, ctx);
-        if (fn->bodyBlock) {
-            emitBlock(fn->bodyBlock.get(), ctx);
-        } else if (!fn->body.empty()) {
-            if (auto ret = dynamic_cast<ReturnStmt*>(fn->body.front().get())) {
-                IRValue v = emitExpr(ret->value.get(), ctx);
-                ctx.body << "  ret " << retIR << " " << v.reg << "\n";
-            } else {
-                ctx.body << "  ret " << retIR << " 0\n";
-            }
-        } else {
-            ctx.body << "  ret " << retIR << " 0\n";
-        }
-        if (!ctx.currentTerminated) {
-            ctx.body << "  ret " << retIR << " 0\n";
-        }
-        std::ostringstream bodyFull;
-        bodyFull << "entry:\n";
-        for (auto& a : ctx.entryAllocas) bodyFull << a;
-        bodyFull << ctx.body.str();
-        mod << bodyFull.str();
-        mod << "}\n\n";
-    }
-
-    for (auto& td : structTypeDefs) mod << td;
-    for (auto& g : globalDefs) mod << g;
-    mod << "declare i32 @printf(i8*, ...)\n";
-    mod << "declare i32 @scanf(i8*, ...)\n";
-    if (usedMalloc) mod << "declare noalias i8* @malloc(i64)\n";
-    if (usedFree) mod << "declare void @free(i8*)\n";
-    return mod.str();
+std::string IRGenerator::finishModule(std::vector<FunctionText>& program) {
+    // --whole-program: every function, optimized together
+    if (opts.wholeProgram) optimizeWholeProgram(program);
+    if (opts.functionAttrs) inferFunctionAttributes(program);
+    std::string functions;
+    size_t size = 0;
+    for (const auto& f : program) size += f.text.size();
+    functions.reserve(size);
+    for (const auto& f : program) functions += f.text;
+    return moduleText(functions);
 }
@@ -0,0 +1,109 @@
+#include "ir_text.h"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+bool parseIRInst(std::string_view line, IRInst& inst) {
+    if (line.size() < 3 || line[0] != ' ' || line[2] == ' ' || line[2] == ']') return false;
+    size_t eq = line.find(" = ");
+    if (line[2] == '%' && eq != std::string_view::npos) {
+        inst.result = line.substr(2, eq - 2);
+        inst.text = line.substr(eq + 3);
+    } else {
+        inst.result = {};
+        inst.text = line.substr(2);
+    }
+    return true;
+}
+
+std::string_view irOperand(std::string_view text, int n) {
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '(' || c == '[' || c == '<' || c == '{') ++depth;
+        else if (c == ')' || c == ']' || c == '>' || c == '}') --depth;
+        else if (c == ',' && depth == 0) {
+            if (n-- == 0) return text.substr(start, i - start);
+            start = i + 2;
+        }
+    }
+    return n == 0 ? text.substr(std::min(start, text.size())) : std::string_view{};
+}
+
+std::string_view irLocation(const IRInst& inst) {
+    std::string_view op = inst.op();
+    return op == "load" || op == "store" ? irOperand(inst.text, 1) : std::string_view{};
+}
+
+int irTempIndex(std::string_view name) {
+    if (name.size() < 3 || name[0] != '%' || name[1] != 't') return -1;
+    int n = 0;
+    for (char c : name.substr(2)) {
+        if (c < '0' || c > '9') return -1;
+        n = n * 10 + (c - '0');
+    }
+    return n;
+}
+
+std::string_view irDirectCallee(const IRInst& inst) {
+    if (inst.op() != "call") return {};
+    size_t at = inst.text.find(" @");
+    if (at == std::string_view::npos) return {};
+    size_t open = inst.text.find('(', at);
+    return inst.text.substr(at + 2, open - at - 2);
+}
+
+void callGraphOrder(const std::vector<std::vector<size_t>>& calls, std::vector<size_t>& order, std::vector<bool>& recursive) {
+    size_t n = calls.size();
+    order.clear();
+    recursive.assign(n, false);
+    std::vector<int> number(n, -1), low(n, 0);
+    std::vector<bool> onStack(n, false);
+    std::vector<size_t> stack;
+    int counter = 0;
+    std::function<void(size_t)> visit = [&](size_t v) {
+        number[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack[v] = true;
+        for (size_t w : calls[v]) {
+            if (w == v) recursive[v] = true;
+            if (number[w] < 0) { visit(w); low[v] = std::min(low[v], low[w]); }
+            else if (onStack[w]) low[v] = std::min(low[v], number[w]);
+        }
+        if (low[v] != number[v]) return;
+        size_t first = order.size();
+        size_t w;
+        do {
+            w = stack.back();
+            stack.pop_back();
+            onStack[w] = false;
+            order.push_back(w);
+        } while (w != v);
+        if (order.size() - first > 1)
+            for (size_t k = first; k < order.size(); ++k) recursive[order[k]] = true;
+    };
+    for (size_t i = 0; i < n; ++i) if (number[i] < 0) visit(i);
+}
+
+bool irPure(std::string_view op) {
+    static const std::unordered_set<std::string_view> pure = {
+        "add", "sub", "mul", "sdiv", "srem", "udiv", "urem", "shl", "lshr", "ashr", "and", "or", "xor",
+        "fneg", "fadd", "fsub", "fmul", "fdiv", "frem", "icmp", "fcmp", "select", "getelementptr",
+        "zext", "sext", "trunc", "fpext", "fptrunc", "sitofp", "fptosi", "bitcast", "ptrtoint", "inttoptr",
+        "extractelement", "insertelement", "shufflevector",
+    };
+    return pure.count(op) != 0;
+}
+
+bool renameTemps(std::string_view line, const std::vector<std::string>& to, std::string& out) {
+    size_t copied = 0;
+    forEachTemp(line, [&](int n, size_t b, size_t e) {
+        if (static_cast<size_t>(n) >= to.size() || to[static_cast<size_t>(n)].empty()) return;
+        out.append(line, copied, b - copied);
+        out += to[static_cast<size_t>(n)];
+        copied = e;
+    });
+    if (copied) out.append(line, copied);
+    return copied != 0;
+}
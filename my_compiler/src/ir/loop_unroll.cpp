@@ -0,0 +1,179 @@
+// Loop unrolling (-funroll-loops) for counted for loops:
+//
+//   for (i = start; i < bound; i = i + c) body      also <=, and > or >=
+//                                                   counting down by i - c
+//
+// where i is an int local whose address is never taken, c is a positive
+// constant, and neither i nor anything the bound reads is assigned in the
+// body. The body must only leave through its end: no return, goto or
+// label, and no break or continue that would leave it.
+//
+// With start and bound constant, or locals that only ever hold one constant
+// (the facts bounds checking collects), the trip count is known: a loop of
+// at most kMaxFullTrips iterations whose copies fit kUnrollBudget becomes
+// that many copies of body and step. Otherwise a loop that runs as many
+// copies as fit the budget (at most kMaxFactor) per test goes first; the
+// test asks whether the last of those iterations would still meet the
+// condition, in i64 so that it cannot overflow, and the loop itself runs
+// what is left. Sizes are counted in AST nodes.
+#include "ir_generator.h"
+#include "ast_walk.h"
+#include <cstdint>
+#include <unordered_set>
+
+namespace {
+
+constexpr long long kMaxFullTrips = 16;
+constexpr long long kMaxFactor = 4;
+constexpr size_t kUnrollBudget = 128; // nodes in all the copies of a body
+
+const VarExpr* plainVar(const Expr* e) {
+    auto v = dynamic_cast<const VarExpr*>(e);
+    return v && v->slot >= 0 && e->conv == ImplicitConv::None ? v : nullptr;
+}
+
+const NumberExpr* plainNumber(const Expr* e) {
+    auto n = dynamic_cast<const NumberExpr*>(e);
+    return n && e->conv == ImplicitConv::None ? n : nullptr;
+}
+
+const AssignExpr* assignmentTo(const Stmt* s) {
+    auto e = dynamic_cast<const ExprStmt*>(s);
+    auto a = e ? dynamic_cast<const AssignExpr*>(e->expr.get()) : nullptr;
+    return a && plainVar(a->target.get()) ? a : nullptr;
+}
+
+// True if control only leaves s through its end; `breaks` and `continues`
+// say whether those are caught by a statement inside the body.
+bool selfContained(const Stmt* s, bool breaks, bool continues) {
+    if (!s) return true;
+    if (dynamic_cast<const ReturnStmt*>(s) || dynamic_cast<const GotoStmt*>(s) || dynamic_cast<const LabelStmt*>(s)) return false;
+    if (dynamic_cast<const BreakStmt*>(s)) return breaks;
+    if (dynamic_cast<const ContinueStmt*>(s)) return continues;
+    if (auto d = dynamic_cast<const VarDeclStmt*>(s)) return !d->isStatic;
+    if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+        for (const auto& st : b->statements)
+            if (!selfContained(st.get(), breaks, continues)) return false;
+        return true;
+    }
+    if (auto i = dynamic_cast<const IfStmt*>(s))
+        return selfContained(i->thenBranch.get(), breaks, continues) && selfContained(i->elseBranch.get(), breaks, continues);
+    if (auto w = dynamic_cast<const WhileStmt*>(s)) return selfContained(w->body.get(), true, true);
+    if (auto dw = dynamic_cast<const DoWhileStmt*>(s)) return selfContained(dw->body.get(), true, true);
+    if (auto f = dynamic_cast<const ForStmt*>(s)) return selfContained(f->body.get(), true, true);
+    if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+        for (const auto& c : sw->cases)
+            for (const auto& st : c.statements)
+                if (!selfContained(st.get(), true, false)) return false;
+        for (const auto& st : sw->defaultBody)
+            if (!selfContained(st.get(), true, false)) return false;
+        return true;
+    }
+    return true;
+}
+
+size_t nodes(const Stmt* s) {
+    size_t n = 0;
+    forEachStmt(s, [&](const Stmt*) { ++n; });
+    forEachExpr(s, [&](const Expr*) { ++n; });
+    return n;
+}
+
+} // namespace
+
+bool IRGenerator::unrollFor(const ForStmt* f, FunctionContext& fn, const std::function<void()>& body) {
+    if (!fn.rangeFacts || !f->body || !selfContained(f->body.get(), false, false)) return false;
+    int slot = -1;
+    const Expr* start = nullptr;
+    if (auto d = dynamic_cast<const VarDeclStmt*>(f->init.get())) { slot = d->slot; start = d->init.get(); }
+    else if (auto a = assignmentTo(f->init.get())) { slot = plainVar(a->target.get())->slot; start = a->value.get(); }
+    if (!start || slot < 0 || fn.addressTaken.count(slot)) return false;
+    const VarSlot& vs = fn.node->slots[static_cast<size_t>(slot)];
+    if (vs.isStatic || vs.type->kind != TypeKind::Int) return false;
+
+    // i = i + c, i = c + i or i = i - c
+    const AssignExpr* step = assignmentTo(f->iter.get());
+    if (!step || plainVar(step->target.get())->slot != slot) return false;
+    auto inc = dynamic_cast<const BinaryExpr*>(step->value.get());
+    if (!inc || (inc->op != "+" && inc->op != "-")) return false;
+    const NumberExpr* c = nullptr;
+    if (plainVar(inc->lhs.get()) && plainVar(inc->lhs.get())->slot == slot) c = plainNumber(inc->rhs.get());
+    else if (inc->op == "+" && plainVar(inc->rhs.get()) && plainVar(inc->rhs.get())->slot == slot) c = plainNumber(inc->lhs.get());
+    if (!c || c->value <= 0) return false;
+    bool up = inc->op == "+";
+
+    auto cond = dynamic_cast<const BinaryExpr*>(f->condition.get());
+    if (!cond || !plainVar(cond->lhs.get()) || plainVar(cond->lhs.get())->slot != slot) return false;
+    const std::string& op = cond->op;
+    if (up ? op != "<" && op != "<=" && op != "!=" : op != ">" && op != ">=") return false;
+    const Expr* bound = cond->rhs.get();
+    if (bound->valueType()->kind != TypeKind::Int) return false;
+
+    std::unordered_set<int> written;
+    forEachExpr(f->body.get(), [&](const Expr* e) {
+        if (auto a = dynamic_cast<const AssignExpr*>(e))
+            if (auto v = dynamic_cast<const VarExpr*>(a->target.get()); v && v->slot >= 0) written.insert(v->slot);
+    });
+    if (written.count(slot)) return false;
+    // evaluated once per group of copies instead of once per iteration
+    std::function<bool(const Expr*)> invariant = [&](const Expr* e) {
+        if (dynamic_cast<const NumberExpr*>(e) || dynamic_cast<const SizeofExpr*>(e)) return true;
+        if (auto v = dynamic_cast<const VarExpr*>(e)) {
+            if (v->slot < 0 || written.count(v->slot) || fn.addressTaken.count(v->slot)) return false;
+            const VarSlot& s = fn.node->slots[static_cast<size_t>(v->slot)];
+            return !s.isStatic && (s.type->kind == TypeKind::Int || s.type->kind == TypeKind::Char);
+        }
+        if (auto u = dynamic_cast<const UnaryExpr*>(e)) return u->op == "-" && invariant(u->operand.get());
+        if (auto b = dynamic_cast<const BinaryExpr*>(e))
+            return (b->op == "+" || b->op == "-" || b->op == "*") && invariant(b->lhs.get()) && invariant(b->rhs.get());
+        return false;
+    };
+    if (!invariant(bound)) return false;
+
+    size_t size = nodes(f->body.get()) + nodes(f->iter.get());
+    long long factor = kMaxFactor;
+    while (factor > 1 && static_cast<size_t>(factor) * size > kUnrollBudget) --factor;
+    Interval s = rangeOf(start, fn), b = rangeOf(bound, fn);
+    if (s.lo == s.hi && b.lo == b.hi) {
+        long long n = -1, i = s.lo, e = b.lo, d = c->value;
+        if (op == "<") n = i < e ? (e - i + d - 1) / d : 0;
+        else if (op == "<=") n = i <= e ? (e - i) / d + 1 : 0;
+        else if (op == ">") n = i > e ? (i - e + d - 1) / d : 0;
+        else if (op == ">=") n = i >= e ? (i - e) / d + 1 : 0;
+        else if (e >= i && (e - i) % d == 0) n = (e - i) / d; // !=
+        long long last = up ? i + n * d : i - n * d;
+        if (n >= 0 && n <= kMaxFullTrips && static_cast<size_t>(n) * size <= kUnrollBudget
+            && last >= INT32_MIN && last <= INT32_MAX) {
+            for (long long k = 0; k < n; ++k) {
+                body();
+                emitStmt(f->iter.get(), fn);
+            }
+            return true;
+        }
+        if (n >= 0 && n < factor) return false;
+    }
+    if (op == "!=" || factor < 2) return false;
+
+    std::string condL = newLabel(fn, "unroll.cond");
+    std::string bodyL = newLabel(fn, "unroll.body");
+    std::string endL = newLabel(fn, "unroll.end");
+    branch(fn, condL);
+    startBlock(fn, condL);
+    IRValue iv = emitExpr(cond->lhs.get(), fn);
+    std::string i64 = newTemp(fn), last = newTemp(fn), b64 = newTemp(fn), more = newTemp(fn);
+    fn.body << "  " << i64 << " = sext i32 " << iv.reg << " to i64\n";
+    fn.body << "  " << last << " = " << (up ? "add" : "sub") << " i64 " << i64 << ", " << (factor - 1) * c->value << "\n";
+    IRValue bv = emitExpr(bound, fn);
+    fn.body << "  " << b64 << " = sext i32 " << bv.reg << " to i64\n";
+    const char* pred = op == "<" ? "slt" : op == "<=" ? "sle" : op == ">" ? "sgt" : "sge";
+    fn.body << "  " << more << " = icmp " << pred << " i64 " << last << ", " << b64 << "\n";
+    cbranch(fn, IRValue{more, "i1"}, bodyL, endL);
+    startBlock(fn, bodyL);
+    for (long long k = 0; k < factor; ++k) {
+        body();
+        emitStmt(f->iter.get(), fn);
+    }
+    branch(fn, condL);
+    startBlock(fn, endL);
+    return false;
+}
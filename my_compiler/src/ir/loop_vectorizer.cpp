@@ -0,0 +1,428 @@
+// Loop vectorizer for counted loops over local arrays:
+//
+//   for (i = start; i < end; i = i + 1) {
+//       a[i + c] = <expr>;          element-wise update
+//       s = s + <expr>;             sum reduction
+//       if (b[i] < m) m = b[i];     min (or max with >) reduction
+//   }
+//
+// Every array access is at i plus a constant and local arrays are distinct
+// allocas, so the only loop-carried dependence possible is between a store
+// and an access of the same array at another offset; such loops are
+// rejected. Whole vectors of VF iterations run with <4 x i32> values, or
+// <16 x i8> for char arrays (char arithmetic is done in 8 bits, so only
+// operators that commute with truncation are allowed there). The scalar
+// loop emitted after the vector loop runs the remaining iterations.
+#include "ir_generator.h"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+struct IRGenerator::VectorLoop {
+    enum class Kind { Store, Sum, Min, Max };
+    struct Item {
+        Kind kind;
+        const Expr* value;                     // stored or reduced value
+        const ArrayIndexExpr* target = nullptr; // Store
+        int slot = -1;                         // reduction variable
+        std::string acc;                       // accumulator alloca
+    };
+
+    const Function* function = nullptr;
+    const Expr* start = nullptr; // initial value of the induction variable
+    const Expr* end = nullptr;   // exclusive bound
+    int induction = -1;
+    bool narrow = false;         // i8 lanes
+    bool elementKnown = false;
+    int width = 4;
+    std::string elemIR = "i32";
+    std::string vecIR = "<4 x i32>";
+    std::vector<Item> items;
+    std::unordered_set<int> written;    // scalar slots assigned in the body
+    std::unordered_set<int> invariants; // scalar slots read in the body
+    std::unordered_map<int, std::vector<long>> offsets; // array slot -> accessed offsets
+    std::unordered_set<int> storedArrays;
+    bool usesInduction = false;
+
+    // filled in while emitting
+    std::string iv;
+    std::string ivVector;
+    std::unordered_map<int, std::string> splats; // invariant slot -> splatted value
+
+    const VarSlot& slotOf(int slot) const { return function->slots[static_cast<size_t>(slot)]; }
+
+    static const VarExpr* var(const Expr* e) {
+        auto v = dynamic_cast<const VarExpr*>(e);
+        return v && v->slot >= 0 && e->conv == ImplicitConv::None ? v : nullptr;
+    }
+    bool isInduction(const Expr* e) const { auto v = var(e); return v && v->slot == induction; }
+    bool isScalarInt(int slot) const {
+        const Type* t = slotOf(slot).type;
+        return t->kind == TypeKind::Int || t->kind == TypeKind::Char;
+    }
+
+    // a[i], a[i + c], a[c + i], a[i - c] on a local array
+    bool access(const ArrayIndexExpr* a, int& slot, long& off) const {
+        auto base = dynamic_cast<const VarExpr*>(a->base.get());
+        if (!base || base->slot < 0 || a->base->type->kind != TypeKind::Array) return false;
+        const Expr* idx = a->index.get();
+        if (idx->conv != ImplicitConv::None) return false;
+        slot = base->slot;
+        if (isInduction(idx)) { off = 0; return true; }
+        auto b = dynamic_cast<const BinaryExpr*>(idx);
+        if (!b || (b->op != "+" && b->op != "-")) return false;
+        auto ln = dynamic_cast<const NumberExpr*>(b->lhs.get());
+        auto rn = dynamic_cast<const NumberExpr*>(b->rhs.get());
+        if (isInduction(b->lhs.get()) && rn) { off = b->op == "+" ? rn->value : -rn->value; return true; }
+        if (b->op == "+" && ln && isInduction(b->rhs.get())) { off = ln->value; return true; }
+        return false;
+    }
+
+    bool element(const ArrayIndexExpr* a, bool store) {
+        int slot; long off;
+        if (!access(a, slot, off)) return false;
+        TypeKind k = a->type->kind;
+        if (k != TypeKind::Int && k != TypeKind::Char) return false;
+        if (!elementKnown) {
+            elementKnown = true;
+            narrow = k == TypeKind::Char;
+            width = narrow ? 16 : 4;
+            elemIR = narrow ? "i8" : "i32";
+            vecIR = "<" + std::to_string(width) + " x " + elemIR + ">";
+        } else if (narrow != (k == TypeKind::Char)) {
+            return false;
+        }
+        offsets[slot].push_back(off);
+        if (store) storedArrays.insert(slot);
+        return true;
+    }
+
+    bool convOk(const Expr* e) const {
+        if (e->conv == ImplicitConv::None) return true;
+        return narrow && (e->conv == ImplicitConv::CharToInt || e->conv == ImplicitConv::IntToChar);
+    }
+
+    bool vectorizable(const Expr* e) {
+        if (!e || !convOk(e)) return false;
+        if (dynamic_cast<const NumberExpr*>(e) || dynamic_cast<const SizeofExpr*>(e)) return true;
+        if (auto v = dynamic_cast<const VarExpr*>(e)) {
+            if (v->slot < 0) return false;
+            if (v->slot == induction) { usesInduction = true; return true; }
+            if (written.count(v->slot) || !isScalarInt(v->slot)) return false;
+            invariants.insert(v->slot);
+            return true;
+        }
+        if (auto a = dynamic_cast<const ArrayIndexExpr*>(e)) return element(a, false);
+        if (auto u = dynamic_cast<const UnaryExpr*>(e)) return u->op == "-" && vectorizable(u->operand.get());
+        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
+            static const std::unordered_set<std::string> anyWidth{"+", "-", "*", "&", "|", "^"};
+            static const std::unordered_set<std::string> wideOnly{"/", "%", "<<", ">>", "<", ">", "<=", ">=", "==", "!="};
+            if (!anyWidth.count(b->op) && !(wideOnly.count(b->op) && !narrow)) return false;
+            return vectorizable(b->lhs.get()) && vectorizable(b->rhs.get());
+        }
+        return false;
+    }
+
+    // end of the range: evaluated once before the vector loop
+    bool invariant(const Expr* e) const {
+        if (!e) return false;
+        if (dynamic_cast<const NumberExpr*>(e) || dynamic_cast<const SizeofExpr*>(e)) return true;
+        if (auto v = dynamic_cast<const VarExpr*>(e))
+            return v->slot >= 0 && v->slot != induction && !written.count(v->slot) && isScalarInt(v->slot);
+        if (auto u = dynamic_cast<const UnaryExpr*>(e)) return u->op == "-" && invariant(u->operand.get());
+        if (auto b = dynamic_cast<const BinaryExpr*>(e)) return b->op != "/" && b->op != "%" && invariant(b->lhs.get()) && invariant(b->rhs.get());
+        return false;
+    }
+
+    static bool flatten(const Stmt* s, std::vector<const Stmt*>& out) {
+        if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+            for (const auto& st : b->statements) if (!flatten(st.get(), out)) return false;
+            return true;
+        }
+        if (auto e = dynamic_cast<const ExprStmt*>(s); e && !e->expr) return true; // struct/typedef
+        out.push_back(s);
+        return true;
+    }
+
+    static const AssignExpr* assignment(const Stmt* s) {
+        if (auto b = dynamic_cast<const BlockStmt*>(s); b && b->statements.size() == 1) s = b->statements[0].get();
+        auto e = dynamic_cast<const ExprStmt*>(s);
+        return e ? dynamic_cast<const AssignExpr*>(e->expr.get()) : nullptr;
+    }
+
+    bool sameElement(const Expr* a, const Expr* b) const {
+        auto x = dynamic_cast<const ArrayIndexExpr*>(a);
+        auto y = dynamic_cast<const ArrayIndexExpr*>(b);
+        int sx, sy; long ox, oy;
+        return x && y && access(x, sx, ox) && access(y, sy, oy) && sx == sy && ox == oy
+            && a->conv == ImplicitConv::None && b->conv == ImplicitConv::None;
+    }
+
+    bool reduction(const Stmt* s) {
+        if (auto ifs = dynamic_cast<const IfStmt*>(s)) {
+            // if (x < m) m = x;  if (m > x) m = x;  and the max forms
+            auto c = dynamic_cast<const BinaryExpr*>(ifs->condition.get());
+            const AssignExpr* a = assignment(ifs->thenBranch.get());
+            if (ifs->elseBranch || !c || !a || !var(a->target.get()) || a->value->conv != ImplicitConv::None) return false;
+            int m = var(a->target.get())->slot;
+            bool less = c->op == "<" || c->op == "<=";
+            if (!less && c->op != ">" && c->op != ">=") return false;
+            const Expr* x;
+            if (var(c->rhs.get()) && var(c->rhs.get())->slot == m) x = c->lhs.get();
+            else if (var(c->lhs.get()) && var(c->lhs.get())->slot == m) { x = c->rhs.get(); less = !less; }
+            else return false;
+            if (!sameElement(x, a->value.get()) || !vectorizable(x)) return false;
+            items.push_back(Item{less ? Kind::Min : Kind::Max, x, nullptr, m, ""});
+            return true;
+        }
+        const AssignExpr* a = assignment(s);
+        auto target = a ? var(a->target.get()) : nullptr;
+        auto sum = a ? dynamic_cast<const BinaryExpr*>(a->value.get()) : nullptr;
+        if (!target || !sum || sum->op != "+" || a->value->conv != ImplicitConv::None) return false;
+        const Expr* x;
+        if (var(sum->lhs.get()) && var(sum->lhs.get())->slot == target->slot) x = sum->rhs.get();
+        else if (var(sum->rhs.get()) && var(sum->rhs.get())->slot == target->slot) x = sum->lhs.get();
+        else return false;
+        if (!vectorizable(x)) return false;
+        items.push_back(Item{Kind::Sum, x, nullptr, target->slot, ""});
+        return true;
+    }
+
+    bool analyze(const ForStmt* f) {
+        // for (i = start; i < end; i = i + 1)
+        const AssignExpr* init = assignment(f->init.get());
+        auto cond = dynamic_cast<const BinaryExpr*>(f->condition.get());
+        const AssignExpr* step = assignment(f->iter.get());
+        if (!init || !cond || !step || cond->op != "<" || !var(init->target.get())) return false;
+        induction = var(init->target.get())->slot;
+        start = init->value.get();
+        end = cond->rhs.get();
+        if (slotOf(induction).type->kind != TypeKind::Int || !isInduction(cond->lhs.get()) || !isInduction(step->target.get())) return false;
+        auto inc = dynamic_cast<const BinaryExpr*>(step->value.get());
+        if (!inc || inc->op != "+") return false;
+        auto one = dynamic_cast<const NumberExpr*>(isInduction(inc->lhs.get()) ? inc->rhs.get() : isInduction(inc->rhs.get()) ? inc->lhs.get() : nullptr);
+        if (!one || one->value != 1) return false;
+
+        std::vector<const Stmt*> body;
+        if (!flatten(f->body.get(), body) || body.empty()) return false;
+        // scalars assigned anywhere in the body are never invariant
+        for (const Stmt* s : body) {
+            const AssignExpr* a = assignment(s);
+            if (auto ifs = dynamic_cast<const IfStmt*>(s)) a = assignment(ifs->thenBranch.get());
+            if (a && var(a->target.get())) written.insert(var(a->target.get())->slot);
+        }
+        if (written.count(induction) || !invariant(cond->rhs.get())) return false;
+        for (const Stmt* s : body) {
+            const AssignExpr* a = assignment(s);
+            if (a && dynamic_cast<const ArrayIndexExpr*>(a->target.get())) {
+                if (!element(static_cast<const ArrayIndexExpr*>(a->target.get()), true) || !convOk(a->value.get())) return false;
+                if (!vectorizable(a->value.get())) return false;
+                items.push_back(Item{Kind::Store, a->value.get(), static_cast<const ArrayIndexExpr*>(a->target.get()), -1, ""});
+            } else if (!reduction(s)) {
+                return false;
+            }
+        }
+        if (!elementKnown) return false;
+        std::unordered_set<int> reduced;
+        for (const auto& it : items) {
+            if (it.kind == Kind::Store) continue;
+            if (narrow || slotOf(it.slot).type->kind != TypeKind::Int || !reduced.insert(it.slot).second) return false;
+        }
+        // a stored array may only be accessed at the offset it is stored at
+        for (int a : storedArrays) {
+            const auto& o = offsets[a];
+            for (long x : o) if (x != o.front()) return false;
+        }
+        // too short for a single vector
+        auto s0 = dynamic_cast<const NumberExpr*>(init->value.get());
+        auto e0 = dynamic_cast<const NumberExpr*>(cond->rhs.get());
+        if (s0 && e0 && e0->value - s0->value < width) return false;
+        return true;
+    }
+
+    std::string splatConstant(long v) const {
+        if (narrow) v = static_cast<int8_t>(v);
+        std::string out = "<";
+        for (int i = 0; i < width; ++i) out += (i ? ", " : "") + elemIR + " " + std::to_string(v);
+        return out + ">";
+    }
+    std::string lanes() const {
+        std::string out = "<";
+        for (int i = 0; i < width; ++i) out += (i ? ", " : "") + elemIR + " " + std::to_string(i);
+        return out + ">";
+    }
+};
+
+IRValue IRGenerator::vectorElementAddress(const ArrayIndexExpr* a, const VectorLoop& loop, FunctionContext& fn) {
+    int slot; long off;
+    loop.access(a, slot, off);
+    std::string idx = loop.iv;
+    if (off) {
+        idx = newTemp(fn);
+        fn.body << "  " << idx << " = add i32 " << loop.iv << ", " << off << "\n";
+    }
+    std::string idx64 = newTemp(fn);
+    fn.body << "  " << idx64 << " = sext i32 " << idx << " to i64\n";
+    std::string arrTy = typeToIR(a->base->type);
+    std::string elem = newTemp(fn);
+    fn.body << "  " << elem << " = getelementptr inbounds " << arrTy << ", " << arrTy << "* " << slotAddress(slot, fn) << ", i64 0, i64 " << idx64 << "\n";
+    IRValue out; out.type = loop.vecIR + "*"; out.reg = newTemp(fn);
+    fn.body << "  " << out.reg << " = bitcast " << loop.elemIR << "* " << elem << " to " << out.type << "\n";
+    return out;
+}
+
+IRValue IRGenerator::emitVector(const Expr* e, const VectorLoop& loop, FunctionContext& fn) {
+    IRValue out; out.type = loop.vecIR;
+    if (auto n = dynamic_cast<const NumberExpr*>(e)) { out.reg = loop.splatConstant(n->value); return out; }
+    if (auto z = dynamic_cast<const SizeofExpr*>(e)) { out.reg = loop.splatConstant(static_cast<long>(z->size)); return out; }
+    if (auto v = dynamic_cast<const VarExpr*>(e)) {
+        out.reg = v->slot == loop.induction ? loop.ivVector : loop.splats.at(v->slot);
+        return out;
+    }
+    if (auto a = dynamic_cast<const ArrayIndexExpr*>(e)) {
+        IRValue addr = vectorElementAddress(a, loop, fn);
+        out.reg = newTemp(fn);
+        fn.body << "  " << out.reg << " = load " << loop.vecIR << ", " << addr.type << " " << addr.reg << ", align " << (loop.narrow ? 1 : 4) << "\n";
+        return out;
+    }
+    if (auto u = dynamic_cast<const UnaryExpr*>(e)) {
+        IRValue v = emitVector(u->operand.get(), loop, fn);
+        out.reg = newTemp(fn);
+        fn.body << "  " << out.reg << " = sub " << loop.vecIR << " zeroinitializer, " << v.reg << "\n";
+        return out;
+    }
+    auto b = static_cast<const BinaryExpr*>(e);
+    IRValue l = emitVector(b->lhs.get(), loop, fn);
+    IRValue r = emitVector(b->rhs.get(), loop, fn);
+    static const std::unordered_map<std::string, std::string> ops{
+        {"+", "add"}, {"-", "sub"}, {"*", "mul"}, {"/", "sdiv"}, {"%", "srem"}, {"&", "and"}, {"|", "or"},
+        {"^", "xor"}, {"<<", "shl"}, {">>", "ashr"}, {"<", "icmp slt"}, {">", "icmp sgt"}, {"<=", "icmp sle"},
+        {">=", "icmp sge"}, {"==", "icmp eq"}, {"!=", "icmp ne"}};
+    const std::string& op = ops.at(b->op);
+    out.reg = newTemp(fn);
+    fn.body << "  " << out.reg << " = " << op << " " << loop.vecIR << " " << l.reg << ", " << r.reg << "\n";
+    if (op.rfind("icmp", 0) == 0) {
+        std::string bits = out.reg;
+        out.reg = newTemp(fn);
+        fn.body << "  " << out.reg << " = zext <" << loop.width << " x i1> " << bits << " to " << loop.vecIR << "\n";
+    }
+    return out;
+}
+
+bool IRGenerator::vectorizeFor(const ForStmt* f, FunctionContext& fn) {
+    VectorLoop loop;
+    loop.function = fn.node;
+    if (!loop.analyze(f)) return false;
+    // vector accesses are not bounds checked, so under -fbounds-check only
+    // loops whose every access is proven in bounds are vectorized
+    if (opts.boundsCheck) {
+        Interval s = rangeOf(loop.start, fn), e = rangeOf(loop.end, fn);
+        for (const auto& [slot, offs] : loop.offsets) {
+            long long n = static_cast<long long>(loop.slotOf(slot).type->arrayLength);
+            for (long off : offs)
+                if (s.lo + off < 0 || e.hi - 1 + off >= n) return false;
+        }
+    }
+    const std::string& vec = loop.vecIR;
+    auto splat = [&](const std::string& scalar) {
+        std::string ins = newTemp(fn), out = newTemp(fn);
+        fn.body << "  " << ins << " = insertelement " << vec << " undef, " << loop.elemIR << " " << scalar << ", i32 0\n";
+        fn.body << "  " << out << " = shufflevector " << vec << " " << ins << ", " << vec << " undef, <" << loop.width << " x i32> zeroinitializer\n";
+        return out;
+    };
+
+    emitStmt(f->init.get(), fn);
+    IRValue end = emitExpr(static_cast<const BinaryExpr*>(f->condition.get())->rhs.get(), fn);
+    for (int slot : loop.invariants) {
+        std::string ty = typeToIR(loop.slotOf(slot).type);
+        std::string v = newTemp(fn);
+        fn.body << "  " << v << " = load " << ty << ", " << ty << "* " << slotAddress(slot, fn) << "\n";
+        if (ty != loop.elemIR) {
+            std::string t = newTemp(fn);
+            fn.body << "  " << t << " = trunc " << ty << " " << v << " to " << loop.elemIR << "\n";
+            v = t;
+        }
+        loop.splats[slot] = splat(v);
+    }
+    for (auto& it : loop.items) {
+        if (it.kind == VectorLoop::Kind::Store) continue;
+        it.acc = newTemp(fn);
+        fn.entryAllocas.push_back("  " + it.acc + " = alloca " + vec + "\n");
+        std::string init = "zeroinitializer";
+        if (it.kind != VectorLoop::Kind::Sum) {
+            // min/max start from the variable's value, which is then folded in for free
+            std::string m = newTemp(fn);
+            fn.body << "  " << m << " = load i32, i32* " << slotAddress(it.slot, fn) << "\n";
+            init = splat(m);
+        }
+        fn.body << "  store " << vec << " " << init << ", " << vec << "* " << it.acc << "\n";
+    }
+
+    std::string condL = newLabel(fn, "vec.cond");
+    std::string bodyL = newLabel(fn, "vec.body");
+    std::string endL = newLabel(fn, "vec.end");
+    std::string ivAddr = slotAddress(loop.induction, fn);
+    branch(fn, condL);
+    startBlock(fn, condL);
+    loop.iv = newTemp(fn);
+    fn.body << "  " << loop.iv << " = load i32, i32* " << ivAddr << "\n";
+    std::string left = newTemp(fn);
+    fn.body << "  " << left << " = sub i32 " << end.reg << ", " << loop.iv << "\n";
+    IRValue more; more.type = "i1"; more.reg = newTemp(fn);
+    fn.body << "  " << more.reg << " = icmp sge i32 " << left << ", " << loop.width << "\n";
+    cbranch(fn, more, bodyL, endL);
+
+    startBlock(fn, bodyL);
+    if (loop.usesInduction) {
+        std::string base = loop.iv;
+        if (loop.narrow) {
+            base = newTemp(fn);
+            fn.body << "  " << base << " = trunc i32 " << loop.iv << " to i8\n";
+        }
+        std::string s = splat(base);
+        loop.ivVector = newTemp(fn);
+        fn.body << "  " << loop.ivVector << " = add " << vec << " " << s << ", " << loop.lanes() << "\n";
+    }
+    for (const auto& it : loop.items) {
+        IRValue v = emitVector(it.value, loop, fn);
+        if (it.kind == VectorLoop::Kind::Store) {
+            IRValue addr = vectorElementAddress(it.target, loop, fn);
+            fn.body << "  store " << vec << " " << v.reg << ", " << addr.type << " " << addr.reg << ", align " << (loop.narrow ? 1 : 4) << "\n";
+            continue;
+        }
+        std::string acc = newTemp(fn), next = newTemp(fn);
+        fn.body << "  " << acc << " = load " << vec << ", " << vec << "* " << it.acc << "\n";
+        if (it.kind == VectorLoop::Kind::Sum) {
+            fn.body << "  " << next << " = add " << vec << " " << acc << ", " << v.reg << "\n";
+        } else {
+            std::string c = newTemp(fn);
+            fn.body << "  " << c << " = icmp " << (it.kind == VectorLoop::Kind::Min ? "slt " : "sgt ") << vec << " " << v.reg << ", " << acc << "\n";
+            fn.body << "  " << next << " = select <" << loop.width << " x i1> " << c << ", " << vec << " " << v.reg << ", " << vec << " " << acc << "\n";
+        }
+        fn.body << "  store " << vec << " " << next << ", " << vec << "* " << it.acc << "\n";
+    }
+    std::string next = newTemp(fn);
+    fn.body << "  " << next << " = add i32 " << loop.iv << ", " << loop.width << "\n";
+    fn.body << "  store i32 " << next << ", i32* " << ivAddr << "\n";
+    branch(fn, condL);
+
+    startBlock(fn, endL);
+    for (const auto& it : loop.items) {
+        if (it.kind == VectorLoop::Kind::Store) continue;
+        const char* name = it.kind == VectorLoop::Kind::Sum ? "add" : it.kind == VectorLoop::Kind::Min ? "smin" : "smax";
+        std::string intrinsic = std::string("llvm.vector.reduce.") + name + ".v4i32";
+        intrinsicDecls.insert("declare i32 @" + intrinsic + "(<4 x i32>)");
+        std::string acc = newTemp(fn), r = newTemp(fn);
+        fn.body << "  " << acc << " = load " << vec << ", " << vec << "* " << it.acc << "\n";
+        fn.body << "  " << r << " = call i32 @" << intrinsic << "(" << vec << " " << acc << ")\n";
+        std::string addr = slotAddress(it.slot, fn);
+        if (it.kind == VectorLoop::Kind::Sum) {
+            std::string s = newTemp(fn), t = newTemp(fn);
+            fn.body << "  " << s << " = load i32, i32* " << addr << "\n";
+            fn.body << "  " << t << " = add i32 " << s << ", " << r << "\n";
+            r = t;
+        }
+        fn.body << "  store i32 " << r << ", i32* " << addr << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,307 @@
+// Peephole rewrites over the emitted text of one function. Each rule in
+// kRules looks at one instruction and the instructions defining its
+// operands, and either replaces its result by a value that already exists
+// or replaces the instruction with a cheaper one, which the rules then see
+// again. The rules target what the emitter produces for conditions: every
+// comparison is widened with zext i1 to i32 and tested again with
+// icmp ne 0 by an if or a loop, and ! compares with 0 once more. Pure
+// instructions left without uses are removed afterwards, walking the body
+// backwards so that a whole chain goes at once. Every step is a single
+// pass, with the operand definitions in a table indexed by temp number.
+#include "ir_generator.h"
+#include "ir_text.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <deque>
+
+namespace {
+
+// "op [flags] T A, B" split into its parts.
+struct Binary { std::string_view head, type, a, b; };
+
+bool parseBinary(std::string_view text, Binary& x) {
+    std::string_view first = irOperand(text, 0);
+    if (first.size() == text.size()) return false;
+    x.b = text.substr(first.size() + 2);
+    if (x.b.find(',') != std::string_view::npos && !irOperand(x.b, 1).empty()) return false;
+    size_t sp = first.rfind(' ');
+    if (sp == std::string_view::npos) return false;
+    x.a = first.substr(sp + 1);
+    first = first.substr(0, sp);
+    sp = first.rfind(' ');
+    if (sp == std::string_view::npos) return false;
+    x.type = first.substr(sp + 1);
+    x.head = first.substr(0, sp);
+    return true;
+}
+
+bool intType(std::string_view t) {
+    return t.size() > 1 && t[0] == 'i' && t.find_first_not_of("0123456789", 1) == std::string_view::npos;
+}
+
+bool intConstant(std::string_view s, long long& v) {
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    return ec == std::errc() && end == s.data() + s.size();
+}
+
+// v as a value of integer type t (i8..i64), two's complement.
+long long wrap(long long v, std::string_view t) {
+    int bits = std::stoi(std::string(t.substr(1)));
+    if (bits >= 64) return v;
+    unsigned long long m = (1ULL << bits) - 1, u = static_cast<unsigned long long>(v) & m;
+    return u >> (bits - 1) ? static_cast<long long>(u | ~m) : static_cast<long long>(u);
+}
+
+// The predicate testing the opposite of p, for an icmp or (float) an fcmp;
+// the two share names (ult, uge, ...) with different inverses.
+const char* invertedPredicate(std::string_view p, bool fcmp) {
+    static const char* const icmpPairs[][2] = {
+        {"eq", "ne"}, {"slt", "sge"}, {"sgt", "sle"}, {"ult", "uge"}, {"ugt", "ule"},
+    };
+    static const char* const fcmpPairs[][2] = {
+        {"oeq", "une"}, {"one", "ueq"}, {"olt", "uge"}, {"ogt", "ule"}, {"ole", "ugt"}, {"oge", "ult"}, {"ord", "uno"},
+    };
+    auto find = [&](const auto& pairs) -> const char* {
+        for (const auto& pr : pairs) {
+            if (p == pr[0]) return pr[1];
+            if (p == pr[1]) return pr[0];
+        }
+        return nullptr;
+    };
+    return fcmp ? find(fcmpPairs) : find(icmpPairs);
+}
+
+// What a rule does with the instruction it matched.
+struct Rewrite {
+    enum Kind { None, Value, Text } kind = None;
+    std::string s; // the value standing in for the result, or the new instruction
+};
+Rewrite value(std::string_view v) { return {Rewrite::Value, std::string(v)}; }
+Rewrite text(std::string s) { return {Rewrite::Text, std::move(s)}; }
+
+struct Match {
+    std::string_view text; // after "%r = "
+    Binary x;              // valid when binary is set
+    bool binary = false;
+    const std::vector<std::string_view>& defs; // %tN -> its instruction, "" if not seen (yet)
+
+    // The instruction defining v, "" for constants and arguments.
+    std::string_view def(std::string_view v) const {
+        int n = irTempIndex(v);
+        return n >= 0 && static_cast<size_t>(n) < defs.size() ? defs[static_cast<size_t>(n)] : std::string_view{};
+    }
+    // X when v is "zext i1 X to T" of the instruction's own type.
+    std::string_view widened(std::string_view v) const {
+        std::string_view d = def(v);
+        std::string_view suffix = " to ";
+        if (!d.starts_with("zext i1 ") || !d.ends_with(x.type) || d.size() < 8 + suffix.size() + x.type.size()) return {};
+        d = d.substr(8, d.size() - 8 - x.type.size());
+        return d.ends_with(suffix) ? d.substr(0, d.size() - suffix.size()) : std::string_view{};
+    }
+};
+
+Rewrite zextNe(const Match& m) {
+    if (m.x.head != "icmp ne" || m.x.b != "0") return {};
+    std::string_view v = m.widened(m.x.a);
+    return v.empty() ? Rewrite{} : value(v);
+}
+
+Rewrite zextEq(const Match& m) {
+    if (m.x.head != "icmp eq" || m.x.b != "0") return {};
+    std::string_view v = m.widened(m.x.a);
+    return v.empty() ? Rewrite{} : text("xor i1 " + std::string(v) + ", true");
+}
+
+Rewrite notNot(const Match& m) {
+    if (m.x.type != "i1" || m.x.b != "true") return {};
+    Binary y;
+    if (!parseBinary(m.def(m.x.a), y) || y.head != "xor" || y.type != "i1" || y.b != "true") return {};
+    return value(y.a);
+}
+
+Rewrite notCompare(const Match& m) {
+    if (m.x.type != "i1" || m.x.b != "true") return {};
+    std::string_view d = m.def(m.x.a);
+    Binary y;
+    if (!(d.starts_with("icmp ") || d.starts_with("fcmp ")) || !parseBinary(d, y)) return {};
+    const char* inverse = invertedPredicate(y.head.substr(5), y.head.starts_with("fcmp "));
+    if (!inverse) return {};
+    return text(std::string(y.head.substr(0, 5)) + inverse + " " + std::string(y.type) + " " + std::string(y.a) + ", " + std::string(y.b));
+}
+
+Rewrite negNeg(const Match& m) {
+    if (m.x.a != "0") return {};
+    Binary y;
+    if (!m.def(m.x.b).starts_with("sub") || !parseBinary(m.def(m.x.b), y) || y.a != "0" || y.type != m.x.type) return {};
+    return value(y.b);
+}
+
+Rewrite fnegFneg(const Match& m) {
+    std::string_view v = m.text.substr(m.text.rfind(' ') + 1);
+    std::string_view d = m.def(v);
+    return d.starts_with("fneg ") ? value(d.substr(d.rfind(' ') + 1)) : Rewrite{};
+}
+
+Rewrite negConstant(const Match& m) {
+    long long c;
+    if (m.x.a != "0" || !intType(m.x.type) || !intConstant(m.x.b, c) || c == INT64_MIN) return {};
+    return value(std::to_string(wrap(-c, m.x.type)));
+}
+
+Rewrite addZero(const Match& m) {
+    if (!intType(m.x.type)) return {};
+    if (m.x.b == "0") return value(m.x.a);
+    if (m.x.a == "0") return value(m.x.b);
+    return {};
+}
+
+// x op 0 -> x for sub and the shifts
+Rewrite rightZero(const Match& m) {
+    return intType(m.x.type) && m.x.b == "0" ? value(m.x.a) : Rewrite{};
+}
+
+Rewrite mulOne(const Match& m) {
+    if (!intType(m.x.type)) return {};
+    if (m.x.b == "1") return value(m.x.a);
+    if (m.x.a == "1") return value(m.x.b);
+    return {};
+}
+
+Rewrite mulZero(const Match& m) {
+    return intType(m.x.type) && (m.x.a == "0" || m.x.b == "0") ? value("0") : Rewrite{};
+}
+
+Rewrite divOne(const Match& m) {
+    return intType(m.x.type) && m.x.b == "1" ? value(m.x.a) : Rewrite{};
+}
+
+struct Rule {
+    const char* name;
+    std::string_view op;
+    bool binary; // needs the "op T A, B" form
+    Rewrite (*apply)(const Match&);
+};
+
+const Rule kRules[] = {
+    {"icmp ne (zext i1 x), 0 -> x", "icmp", true, zextNe},
+    {"icmp eq (zext i1 x), 0 -> !x", "icmp", true, zextEq},
+    {"!!x -> x", "xor", true, notNot},
+    {"!(a cmp b) -> a !cmp b", "xor", true, notCompare},
+    {"0 - (0 - x) -> x", "sub", true, negNeg},
+    {"fneg (fneg x) -> x", "fneg", false, fnegFneg},
+    {"0 - C -> -C", "sub", true, negConstant},
+    {"x + 0 -> x", "add", true, addZero},
+    {"x - 0 -> x", "sub", true, rightZero},
+    {"x * 1 -> x", "mul", true, mulOne},
+    {"x * 0 -> 0", "mul", true, mulZero},
+    {"x << 0 -> x", "shl", true, rightZero},
+    {"x >> 0 -> x", "ashr", true, rightZero},
+    {"x >>> 0 -> x", "lshr", true, rightZero},
+    {"x / 1 -> x", "sdiv", true, divOne},
+};
+constexpr size_t kRuleCount = sizeof kRules / sizeof kRules[0];
+
+// A rewritten instruction is offered to the rules again, this many times
+// at most.
+constexpr int kMaxRewrites = 4;
+
+} // namespace
+
+std::string IRGenerator::applyPeepholes(const std::string& body, const FunctionContext& fn) {
+    if (peepholes.rules.empty())
+        for (const auto& r : kRules) peepholes.rules.emplace_back(r.name, 0);
+
+    // a kept line and, for an instruction, its text and result (-1 if none
+    // or not a temp)
+    struct Line { std::string_view line, text; int result = -1; bool inst = false; };
+    size_t temps = static_cast<size_t>(fn.tempCounter);
+    std::vector<std::string> to(temps); // replaced %tN -> value standing in for it
+    std::vector<std::string_view> defs(temps);
+    std::vector<int> uses(temps, 0); // by the kept lines, phis counted last
+    auto countUses = [&](std::string_view text, int delta) {
+        forEachTemp(text, [&](int n, size_t, size_t) { uses[static_cast<size_t>(n)] += delta; });
+    };
+    std::deque<std::string> rewritten; // storage for lines that differ from the body
+    std::vector<Line> lines;
+    std::vector<size_t> phis;
+    std::string renamed;
+    for (size_t b = 0, e; b < body.size(); b = e + 1) {
+        e = body.find('\n', b);
+        if (e == std::string::npos) e = body.size();
+        std::string_view line = std::string_view(body).substr(b, e - b);
+        IRInst inst;
+        if (!parseIRInst(line, inst)) {
+            countUses(line, 1);
+            lines.push_back({line, {}, -1, false});
+            continue;
+        }
+        ++peepholes.before;
+        renamed.clear();
+        if (renameTemps(line, to, renamed)) {
+            line = rewritten.emplace_back(renamed);
+            parseIRInst(line, inst);
+        }
+        int result = irTempIndex(inst.result);
+        bool replaced = false;
+        for (int round = 0; result >= 0 && round < kMaxRewrites && !replaced; ++round) {
+            std::string_view op = inst.op();
+            if (std::none_of(std::begin(kRules), std::end(kRules), [&](const Rule& r) { return r.op == op; })) break;
+            Match m{inst.text, {}, false, defs};
+            m.binary = parseBinary(inst.text, m.x);
+            Rewrite rw;
+            size_t r = 0;
+            for (; r < kRuleCount; ++r) {
+                if (kRules[r].op != op || (kRules[r].binary && !m.binary)) continue;
+                rw = kRules[r].apply(m);
+                if (rw.kind != Rewrite::None) break;
+            }
+            if (rw.kind == Rewrite::None) break;
+            ++peepholes.rules[r].second;
+            if (rw.kind == Rewrite::Value) {
+                to[static_cast<size_t>(result)] = std::move(rw.s);
+                replaced = true;
+            } else {
+                line = rewritten.emplace_back("  " + std::string(inst.result) + " = " + rw.s);
+                parseIRInst(line, inst);
+            }
+        }
+        if (replaced) continue;
+        if (result >= 0) defs[static_cast<size_t>(result)] = inst.text;
+        if (inst.op() == "phi") phis.push_back(lines.size());
+        else countUses(inst.text, 1);
+        lines.push_back({line, inst.text, result, true});
+    }
+    // a phi can name a value replaced further down
+    for (size_t i : phis) {
+        Line& l = lines[i];
+        renamed.clear();
+        if (renameTemps(l.line, to, renamed)) {
+            IRInst inst;
+            l.line = rewritten.emplace_back(renamed);
+            parseIRInst(l.line, inst);
+            l.text = inst.text;
+        }
+        countUses(l.text, 1);
+    }
+
+    // backwards, so that an instruction only feeding dead ones is seen
+    // after them
+    std::vector<bool> dead(lines.size(), false);
+    for (size_t i = lines.size(); i-- > 0;) {
+        const Line& l = lines[i];
+        if (l.result < 0 || uses[static_cast<size_t>(l.result)] > 0 || !irPure(l.text.substr(0, l.text.find(' ')))) continue;
+        dead[i] = true;
+        ++peepholes.dead;
+        countUses(l.text, -1);
+    }
+
+    std::string out;
+    out.reserve(body.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (dead[i]) continue;
+        peepholes.after += lines[i].inst;
+        out.append(lines[i].line) += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,824 @@
+// Block-count profiling: -fprofile-generate instrumentation and its runtime,
+// and the -fprofile-use side that turns counts into branch weights and
+// cold functions. Also -finstrument-functions, timing every call,
+// and -fheap-profile, tracking malloc and free, with their runtimes.
+#include "ir_generator.h"
+#include "profile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+bool Profile::load(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) { error = "cannot open profile: " + path; return false; }
+    std::string line;
+    for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string function, label;
+        long long n;
+        if (!(fields >> function >> label >> n) || n < 0) {
+            error = path + ":" + std::to_string(lineNo) + ": malformed profile line";
+            return false;
+        }
+        counts[function + " " + label] = n;
+        functions.insert(function);
+    }
+    return true;
+}
+
+long long Profile::count(const std::string& function, const std::string& label) const {
+    auto it = counts.find(function + " " + label);
+    return it == counts.end() ? -1 : it->second;
+}
+
+long long Profile::taken(const std::string& function, const std::string& label) const {
+    return count(function, label + "/taken");
+}
+
+namespace {
+
+// Counts scaled to fit branch_weights' i32 operands. The +1 keeps a branch
+// that never ran from being treated as impossible.
+std::string weightsNode(const std::vector<long long>& counts) {
+    long long max = *std::max_element(counts.begin(), counts.end());
+    long long scale = max / UINT32_MAX + 1;
+    std::string node = "!{!\"branch_weights\"";
+    for (long long c : counts) node += ", i32 " + std::to_string(c / scale + 1);
+    return node + "}";
+}
+
+std::string cString(const std::string& s) {
+    std::string out;
+    for (unsigned char c : s) {
+        if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+            static const char hex[] = "0123456789ABCDEF";
+            out += '\\'; out += hex[c >> 4]; out += hex[c & 15];
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\\00";
+}
+
+} // namespace
+
+void IRGenerator::countBlock(FunctionContext& fn) {
+    std::string counter = "@__prof.c." + std::to_string(profileCounters.size());
+    profileCounters.push_back(fn.node->name + " " + fn.currentLabel);
+    std::string v = newTemp(fn), n = newTemp(fn);
+    fn.body << "  " << v << " = load i64, i64* " << counter << "\n";
+    fn.body << "  " << n << " = add i64 " << v << ", 1\n";
+    fn.body << "  store i64 " << n << ", i64* " << counter << "\n";
+}
+
+void IRGenerator::countTaken(const IRValue& cond, FunctionContext& fn) {
+    std::string counter = "@__prof.c." + std::to_string(profileCounters.size());
+    profileCounters.push_back(fn.node->name + " " + fn.currentLabel + "/taken");
+    std::string one = newTemp(fn), v = newTemp(fn), n = newTemp(fn);
+    fn.body << "  " << one << " = zext i1 " << cond.reg << " to i64\n";
+    fn.body << "  " << v << " = load i64, i64* " << counter << "\n";
+    fn.body << "  " << n << " = add i64 " << v << ", " << one << "\n";
+    fn.body << "  store i64 " << n << ", i64* " << counter << "\n";
+}
+
+std::string IRGenerator::branchWeights(const FunctionContext& fn) {
+    if (!profile) return "";
+    long long n = profile->count(fn.node->name, fn.currentLabel);
+    long long t = profile->taken(fn.node->name, fn.currentLabel);
+    if (n < 0 || t < 0) return "";
+    return ", !prof " + addMetadata(weightsNode({t, std::max(0LL, n - t)}));
+}
+
+// Only functions that never ran are marked. No function_entry_count: with
+// one llc lays out and tail-duplicates by profile counts, and it stopped
+// copying the tests after a switch into its cases in the branchy kernel.
+std::string IRGenerator::functionAttributes(const Function& fnNode) {
+    if (!profile || !profile->hasFunction(fnNode.name)) return "";
+    return profile->count(fnNode.name, "entry") > 0 ? "" : " cold";
+}
+
+// One i64 per counter and a destructor that writes "name count" lines to
+// the -fprofile-generate file when the program exits.
+std::string IRGenerator::profileRuntime() {
+    std::ostringstream out;
+    size_t n = profileCounters.size();
+    std::string nameTable = "[" + std::to_string(n) + " x i8*]";
+    std::string counterTable = "[" + std::to_string(n) + " x i64*]";
+    for (size_t i = 0; i < n; ++i) out << "@__prof.c." << i << " = internal global i64 0\n";
+    for (size_t i = 0; i < n; ++i)
+        out << "@__prof.n." << i << " = private constant [" << profileCounters[i].size() + 1 << " x i8] c\"" << cString(profileCounters[i]) << "\"\n";
+    out << "@__prof.names = internal constant " << nameTable << " [";
+    for (size_t i = 0; i < n; ++i) {
+        std::string arr = "[" + std::to_string(profileCounters[i].size() + 1) + " x i8]";
+        out << (i ? ", " : "") << "i8* getelementptr inbounds (" << arr << ", " << arr << "* @__prof.n." << i << ", i64 0, i64 0)";
+    }
+    out << "]\n";
+    out << "@__prof.counters = internal constant " << counterTable << " [";
+    for (size_t i = 0; i < n; ++i) out << (i ? ", " : "") << "i64* @__prof.c." << i;
+    out << "]\n";
+    std::string path = opts.profileGenerate;
+    std::string pathArr = "[" + std::to_string(path.size() + 1) + " x i8]";
+    out << "@__prof.file = private constant " << pathArr << " c\"" << cString(path) << "\"\n";
+    out << "@__prof.mode = private constant [2 x i8] c\"w\\00\"\n";
+    out << "@__prof.fmt = private constant [9 x i8] c\"%s %lld\\0A\\00\"\n\n";
+    out << "define internal void @__prof.dump() {\n"
+        << "entry:\n"
+        << "  %file = call i8* @fopen(i8* getelementptr inbounds (" << pathArr << ", " << pathArr << "* @__prof.file, i64 0, i64 0), "
+        << "i8* getelementptr inbounds ([2 x i8], [2 x i8]* @__prof.mode, i64 0, i64 0))\n"
+        << "  %failed = icmp eq i8* %file, null\n"
+        << "  br i1 %failed, label %done, label %loop\n"
+        << "loop:\n"
+        << "  %i = phi i64 [ 0, %entry ], [ %next, %loop ]\n"
+        << "  %namep = getelementptr inbounds " << nameTable << ", " << nameTable << "* @__prof.names, i64 0, i64 %i\n"
+        << "  %name = load i8*, i8** %namep\n"
+        << "  %counterp = getelementptr inbounds " << counterTable << ", " << counterTable << "* @__prof.counters, i64 0, i64 %i\n"
+        << "  %counter = load i64*, i64** %counterp\n"
+        << "  %count = load i64, i64* %counter\n"
+        << "  %w = call i32 (i8*, i8*, ...) @fprintf(i8* %file, i8* getelementptr inbounds ([9 x i8], [9 x i8]* @__prof.fmt, i64 0, i64 0), i8* %name, i64 %count)\n"
+        << "  %next = add i64 %i, 1\n"
+        << "  %more = icmp ult i64 %next, " << n << "\n"
+        << "  br i1 %more, label %loop, label %close\n"
+        << "close:\n"
+        << "  %c = call i32 @fclose(i8* %file)\n"
+        << "  br label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+    libcDecls.insert("declare i8* @fopen(i8*, i8*)");
+    libcDecls.insert("declare i32 @fprintf(i8*, i8*, ...)");
+    libcDecls.insert("declare i32 @fclose(i8*)");
+    return out.str();
+}
+
+void IRGenerator::instrumentEntry(FunctionContext& fn) {
+    fn.hookId = static_cast<int>(instrumented.size());
+    instrumented.push_back(fn.node->name);
+    fn.body << "  call void @__instr.enter(i32 " << fn.hookId << ")\n";
+}
+
+void IRGenerator::instrumentExit(FunctionContext& fn) {
+    fn.body << "  call void @__instr.exit(i32 " << fn.hookId << ")\n";
+}
+
+namespace {
+
+constexpr size_t kRingEvents = 4096;
+constexpr size_t kContexts = 16384;
+constexpr size_t kStackDepth = 1024;
+
+} // namespace
+
+// The hooks append the function's id (~id for an exit) and the cycle
+// counter to a ring buffer, which is drained when it fills: each event is
+// replayed against a shadow stack of the calls still open. A call that
+// returns is charged its time less that of its callees (its self time) on
+// its node of the calling context tree, one node per distinct chain of
+// calls, and on its function; its whole time goes to the function's total
+// only for the outermost of its activations, so recursion is not counted
+// twice. Draining stops the clock of the calls open while it runs.
+//
+// At exit a destructor drains what is left, closes the calls exit() was
+// made from, and writes a "main;f;g cycles" line of self time per context
+// (the collapsed stacks flamegraph.pl reads) to the file, and a table of
+// calls, self and total cycles per function, hottest first, to the file
+// with ".table" appended. Programs are single-threaded, so the buffer
+// needs no atomics. Contexts past kContexts are charged to their caller's,
+// and calls nested deeper than kStackDepth to the deepest one tracked.
+std::string IRGenerator::instrumentRuntime() {
+    std::ostringstream out, strings;
+    size_t n = instrumented.size();
+    auto array = [](size_t count, const char* type) { return "[" + std::to_string(count) + " x " + type + "]"; };
+    // the address of element i of the global g, an array of count types
+    auto at = [&](const char* g, size_t count, const char* type, const char* i) {
+        std::string a = array(count, type);
+        return "getelementptr inbounds " + a + ", " + a + "* @__instr." + g + ", i64 0, i64 " + i;
+    };
+    int stringCount = 0;
+    auto str = [&](const std::string& text) {
+        std::string g = "@__instr.s." + std::to_string(stringCount++);
+        std::string a = array(text.size() + 1, "i8");
+        strings << g << " = private constant " << a << " c\"" << cString(text) << "\"\n";
+        return "i8* getelementptr inbounds (" + a + ", " + a + "* " + g + ", i64 0, i64 0)";
+    };
+    const size_t R = kRingEvents, C = kContexts, D = kStackDepth;
+
+    out << "@__instr.head = internal global i64 0\n";
+    out << "@__instr.ring.id = internal global " << array(R, "i32") << " zeroinitializer\n";
+    out << "@__instr.ring.time = internal global " << array(R, "i64") << " zeroinitializer\n";
+    out << "@__instr.contexts = internal global i32 1\n"; // 0 is the root
+    for (const char* g : {"fn", "parent", "child", "sibling"})
+        out << "@__instr.cct." << g << " = internal global " << array(C, "i32") << " zeroinitializer\n";
+    out << "@__instr.cct.self = internal global " << array(C, "i64") << " zeroinitializer\n";
+    out << "@__instr.depth = internal global i32 0\n";
+    for (const char* g : {"fn", "node"})
+        out << "@__instr.stack." << g << " = internal global " << array(D, "i32") << " zeroinitializer\n";
+    for (const char* g : {"start", "child"})
+        out << "@__instr.stack." << g << " = internal global " << array(D, "i64") << " zeroinitializer\n";
+    for (const char* g : {"calls", "self", "total"})
+        out << "@__instr." << g << " = internal global " << array(n, "i64") << " zeroinitializer\n";
+    out << "@__instr.active = internal global " << array(n, "i32") << " zeroinitializer\n";
+    out << "@__instr.names = internal constant " << array(n, "i8*") << " [";
+    for (size_t i = 0; i < n; ++i) out << (i ? ", " : "") << str(instrumented[i]);
+    out << "]\n";
+    std::string file = str(opts.instrumentFunctions), table = str(opts.instrumentFunctions + ".table");
+    std::string mode = str("w"), semicolon = str(";"), count = str(" %lld\n");
+    char header[128];
+    std::snprintf(header, sizeof header, "%-24s %12s %16s %16s\n", "function", "calls", "self cycles", "total cycles");
+    std::string headerText = str(header), row = str("%-24s %12lld %16lld %16lld\n");
+    out << strings.str() << "\n";
+
+    for (bool exit : {false, true}) {
+        out << "define internal void @__instr." << (exit ? "exit" : "enter") << "(i32 %id) {\n"
+            << "entry:\n"
+            << "  %t = call i64 @llvm.readcyclecounter()\n"
+            << (exit ? "  %v = xor i32 %id, -1\n" : "")
+            << "  %h = load i64, i64* @__instr.head\n"
+            << "  %idp = " << at("ring.id", R, "i32", "%h") << "\n"
+            << "  store i32 " << (exit ? "%v" : "%id") << ", i32* %idp\n"
+            << "  %tp = " << at("ring.time", R, "i64", "%h") << "\n"
+            << "  store i64 %t, i64* %tp\n"
+            << "  %next = add i64 %h, 1\n"
+            << "  store i64 %next, i64* @__instr.head\n"
+            << "  %full = icmp eq i64 %next, " << R << "\n"
+            << "  br i1 %full, label %drain, label %done\n"
+            << "drain:\n"
+            << "  call void @__instr.drain()\n"
+            << "  br label %done\n"
+            << "done:\n"
+            << "  ret void\n"
+            << "}\n\n";
+    }
+
+    out << "define internal void @__instr.drain() {\n"
+        << "entry:\n"
+        << "  %start = call i64 @llvm.readcyclecounter()\n"
+        << "  %n = load i64, i64* @__instr.head\n"
+        << "  %empty = icmp eq i64 %n, 0\n"
+        << "  br i1 %empty, label %done, label %replay\n"
+        << "replay:\n"
+        << "  %i = phi i64 [ 0, %entry ], [ %next, %replay ]\n"
+        << "  %idp = " << at("ring.id", R, "i32", "%i") << "\n"
+        << "  %id = load i32, i32* %idp\n"
+        << "  %tp = " << at("ring.time", R, "i64", "%i") << "\n"
+        << "  %t = load i64, i64* %tp\n"
+        << "  call void @__instr.event(i32 %id, i64 %t)\n"
+        << "  %next = add i64 %i, 1\n"
+        << "  %more = icmp ult i64 %next, %n\n"
+        << "  br i1 %more, label %replay, label %pause\n"
+        << "pause:\n" // move the open calls' start past the time spent here
+        << "  store i64 0, i64* @__instr.head\n"
+        << "  %end = call i64 @llvm.readcyclecounter()\n"
+        << "  %spent = sub i64 %end, %start\n"
+        << "  %depth = load i32, i32* @__instr.depth\n"
+        << "  %deep = icmp ugt i32 %depth, " << D << "\n"
+        << "  %open = select i1 %deep, i32 " << D << ", i32 %depth\n"
+        << "  %open64 = zext i32 %open to i64\n"
+        << "  %none = icmp eq i64 %open64, 0\n"
+        << "  br i1 %none, label %done, label %shift\n"
+        << "shift:\n"
+        << "  %f = phi i64 [ 0, %pause ], [ %fnext, %shift ]\n"
+        << "  %sp = " << at("stack.start", D, "i64", "%f") << "\n"
+        << "  %s = load i64, i64* %sp\n"
+        << "  %s1 = add i64 %s, %spent\n"
+        << "  store i64 %s1, i64* %sp\n"
+        << "  %fnext = add i64 %f, 1\n"
+        << "  %fmore = icmp ult i64 %fnext, %open64\n"
+        << "  br i1 %fmore, label %shift, label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+
+    // one event: v is the id of the function entered, or ~id of the one left
+    out << "define internal void @__instr.event(i32 %v, i64 %t) {\n"
+        << "entry:\n"
+        << "  %depth = load i32, i32* @__instr.depth\n"
+        << "  %isexit = icmp slt i32 %v, 0\n"
+        << "  br i1 %isexit, label %exit, label %enter\n"
+        << "enter:\n"
+        << "  %id = sext i32 %v to i64\n"
+        << "  %cp = " << at("calls", n, "i64", "%id") << "\n"
+        << "  %c = load i64, i64* %cp\n"
+        << "  %c1 = add i64 %c, 1\n"
+        << "  store i64 %c1, i64* %cp\n"
+        << "  %ap = " << at("active", n, "i32", "%id") << "\n"
+        << "  %a = load i32, i32* %ap\n"
+        << "  %a1 = add i32 %a, 1\n"
+        << "  store i32 %a1, i32* %ap\n"
+        << "  %d1 = add i32 %depth, 1\n"
+        << "  store i32 %d1, i32* @__instr.depth\n"
+        << "  %deep = icmp uge i32 %depth, " << D << "\n"
+        << "  br i1 %deep, label %done, label %push\n"
+        << "push:\n"
+        << "  %top = icmp eq i32 %depth, 0\n"
+        << "  br i1 %top, label %find, label %caller\n"
+        << "caller:\n"
+        << "  %pd = sub i32 %depth, 1\n"
+        << "  %pd64 = zext i32 %pd to i64\n"
+        << "  %pnp = " << at("stack.node", D, "i32", "%pd64") << "\n"
+        << "  %pn = load i32, i32* %pnp\n"
+        << "  br label %find\n"
+        << "find:\n" // the child of the caller's context for this function
+        << "  %parent = phi i32 [ 0, %push ], [ %pn, %caller ]\n"
+        << "  %parent64 = zext i32 %parent to i64\n"
+        << "  %firstp = " << at("cct.child", C, "i32", "%parent64") << "\n"
+        << "  %first = load i32, i32* %firstp\n"
+        << "  br label %scan\n"
+        << "scan:\n"
+        << "  %node = phi i32 [ %first, %find ], [ %sibling, %next ]\n"
+        << "  %none = icmp eq i32 %node, 0\n"
+        << "  br i1 %none, label %add, label %check\n"
+        << "check:\n"
+        << "  %node64 = zext i32 %node to i64\n"
+        << "  %fnp = " << at("cct.fn", C, "i32", "%node64") << "\n"
+        << "  %fn = load i32, i32* %fnp\n"
+        << "  %same = icmp eq i32 %fn, %v\n"
+        << "  br i1 %same, label %found, label %next\n"
+        << "next:\n"
+        << "  %sibp = " << at("cct.sibling", C, "i32", "%node64") << "\n"
+        << "  %sibling = load i32, i32* %sibp\n"
+        << "  br label %scan\n"
+        << "add:\n"
+        << "  %count = load i32, i32* @__instr.contexts\n"
+        << "  %room = icmp ult i32 %count, " << C << "\n"
+        << "  br i1 %room, label %new, label %found\n"
+        << "new:\n"
+        << "  %new64 = zext i32 %count to i64\n"
+        << "  %nfp = " << at("cct.fn", C, "i32", "%new64") << "\n"
+        << "  store i32 %v, i32* %nfp\n"
+        << "  %npp = " << at("cct.parent", C, "i32", "%new64") << "\n"
+        << "  store i32 %parent, i32* %npp\n"
+        << "  %nsp = " << at("cct.sibling", C, "i32", "%new64") << "\n"
+        << "  store i32 %first, i32* %nsp\n"
+        << "  store i32 %count, i32* %firstp\n"
+        << "  %count1 = add i32 %count, 1\n"
+        << "  store i32 %count1, i32* @__instr.contexts\n"
+        << "  br label %found\n"
+        << "found:\n"
+        << "  %context = phi i32 [ %node, %check ], [ %parent, %add ], [ %count, %new ]\n"
+        << "  %d64 = zext i32 %depth to i64\n"
+        << "  %sfp = " << at("stack.fn", D, "i32", "%d64") << "\n"
+        << "  store i32 %v, i32* %sfp\n"
+        << "  %snp = " << at("stack.node", D, "i32", "%d64") << "\n"
+        << "  store i32 %context, i32* %snp\n"
+        << "  %ssp = " << at("stack.start", D, "i64", "%d64") << "\n"
+        << "  store i64 %t, i64* %ssp\n"
+        << "  %scp = " << at("stack.child", D, "i64", "%d64") << "\n"
+        << "  store i64 0, i64* %scp\n"
+        << "  br label %done\n"
+        << "exit:\n"
+        << "  %unmatched = icmp eq i32 %depth, 0\n"
+        << "  br i1 %unmatched, label %done, label %pop\n"
+        << "pop:\n"
+        << "  %xid = xor i32 %v, -1\n"
+        << "  %xid64 = sext i32 %xid to i64\n"
+        << "  %d = sub i32 %depth, 1\n"
+        << "  store i32 %d, i32* @__instr.depth\n"
+        << "  %xap = " << at("active", n, "i32", "%xid64") << "\n"
+        << "  %xa = load i32, i32* %xap\n"
+        << "  %xa1 = sub i32 %xa, 1\n"
+        << "  store i32 %xa1, i32* %xap\n"
+        << "  %xdeep = icmp uge i32 %d, " << D << "\n"
+        << "  br i1 %xdeep, label %done, label %frame\n"
+        << "frame:\n"
+        << "  %fd = zext i32 %d to i64\n"
+        << "  %fsp = " << at("stack.start", D, "i64", "%fd") << "\n"
+        << "  %fstart = load i64, i64* %fsp\n"
+        << "  %elapsed = sub i64 %t, %fstart\n"
+        << "  %fcp = " << at("stack.child", D, "i64", "%fd") << "\n"
+        << "  %fchild = load i64, i64* %fcp\n"
+        << "  %self = sub i64 %elapsed, %fchild\n"
+        << "  %fnodep = " << at("stack.node", D, "i32", "%fd") << "\n"
+        << "  %fnode = load i32, i32* %fnodep\n"
+        << "  %fnode64 = zext i32 %fnode to i64\n"
+        << "  %cselfp = " << at("cct.self", C, "i64", "%fnode64") << "\n"
+        << "  %cself = load i64, i64* %cselfp\n"
+        << "  %cself1 = add i64 %cself, %self\n"
+        << "  store i64 %cself1, i64* %cselfp\n"
+        << "  %selfp = " << at("self", n, "i64", "%xid64") << "\n"
+        << "  %fself = load i64, i64* %selfp\n"
+        << "  %fself1 = add i64 %fself, %self\n"
+        << "  store i64 %fself1, i64* %selfp\n"
+        << "  %outer = icmp eq i32 %xa1, 0\n"
+        << "  br i1 %outer, label %total, label %up\n"
+        << "total:\n"
+        << "  %totalp = " << at("total", n, "i64", "%xid64") << "\n"
+        << "  %ftotal = load i64, i64* %totalp\n"
+        << "  %ftotal1 = add i64 %ftotal, %elapsed\n"
+        << "  store i64 %ftotal1, i64* %totalp\n"
+        << "  br label %up\n"
+        << "up:\n"
+        << "  %root = icmp eq i32 %d, 0\n"
+        << "  br i1 %root, label %done, label %charge\n"
+        << "charge:\n" // to the caller's callee time
+        << "  %cd = sub i32 %d, 1\n"
+        << "  %cd64 = zext i32 %cd to i64\n"
+        << "  %chp = " << at("stack.child", D, "i64", "%cd64") << "\n"
+        << "  %ch = load i64, i64* %chp\n"
+        << "  %ch1 = add i64 %ch, %elapsed\n"
+        << "  store i64 %ch1, i64* %chp\n"
+        << "  br label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+
+    // "f;g;h" for a context: the chain of calls from the root
+    out << "define internal void @__instr.path(i8* %file, i32 %node) {\n"
+        << "entry:\n"
+        << "  %node64 = zext i32 %node to i64\n"
+        << "  %pp = " << at("cct.parent", C, "i32", "%node64") << "\n"
+        << "  %parent = load i32, i32* %pp\n"
+        << "  %top = icmp eq i32 %parent, 0\n"
+        << "  br i1 %top, label %leaf, label %callers\n"
+        << "callers:\n"
+        << "  call void @__instr.path(i8* %file, i32 %parent)\n"
+        << "  %s = call i32 @fputs(" << semicolon << ", i8* %file)\n"
+        << "  br label %leaf\n"
+        << "leaf:\n"
+        << "  %fp = " << at("cct.fn", C, "i32", "%node64") << "\n"
+        << "  %fn = load i32, i32* %fp\n"
+        << "  %fn64 = sext i32 %fn to i64\n"
+        << "  %np = " << at("names", n, "i8*", "%fn64") << "\n"
+        << "  %name = load i8*, i8** %np\n"
+        << "  %w = call i32 @fputs(i8* %name, i8* %file)\n"
+        << "  ret void\n"
+        << "}\n\n";
+
+    out << "define internal void @__instr.dump() {\n"
+        << "entry:\n"
+        << "  call void @__instr.drain()\n"
+        << "  %now = call i64 @llvm.readcyclecounter()\n"
+        << "  br label %unwind\n"
+        << "unwind:\n" // calls left open by exit()
+        << "  %depth = load i32, i32* @__instr.depth\n"
+        << "  %open = icmp ne i32 %depth, 0\n"
+        << "  br i1 %open, label %close, label %write\n"
+        << "close:\n"
+        << "  %top = sub i32 %depth, 1\n"
+        << "  %tracked = icmp ult i32 %top, " << D << "\n"
+        << "  br i1 %tracked, label %closeframe, label %skip\n"
+        << "closeframe:\n"
+        << "  %top64 = zext i32 %top to i64\n"
+        << "  %sfp = " << at("stack.fn", D, "i32", "%top64") << "\n"
+        << "  %id = load i32, i32* %sfp\n"
+        << "  %v = xor i32 %id, -1\n"
+        << "  call void @__instr.event(i32 %v, i64 %now)\n"
+        << "  br label %unwind\n"
+        << "skip:\n"
+        << "  store i32 %top, i32* @__instr.depth\n"
+        << "  br label %unwind\n"
+        << "write:\n"
+        << "  %file = call i8* @fopen(" << file << ", " << mode << ")\n"
+        << "  %nofile = icmp eq i8* %file, null\n"
+        << "  br i1 %nofile, label %table, label %contexts\n"
+        << "contexts:\n"
+        << "  %count = load i32, i32* @__instr.contexts\n"
+        << "  br label %context\n"
+        << "context:\n"
+        << "  %i = phi i32 [ 1, %contexts ], [ %inext, %nextcontext ]\n"
+        << "  %more = icmp ult i32 %i, %count\n"
+        << "  br i1 %more, label %visit, label %closefile\n"
+        << "visit:\n"
+        << "  %i64 = zext i32 %i to i64\n"
+        << "  %sp = " << at("cct.self", C, "i64", "%i64") << "\n"
+        << "  %self = load i64, i64* %sp\n"
+        << "  %ran = icmp sgt i64 %self, 0\n"
+        << "  br i1 %ran, label %line, label %nextcontext\n"
+        << "line:\n"
+        << "  call void @__instr.path(i8* %file, i32 %i)\n"
+        << "  %w = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << count << ", i64 %self)\n"
+        << "  br label %nextcontext\n"
+        << "nextcontext:\n"
+        << "  %inext = add i32 %i, 1\n"
+        << "  br label %context\n"
+        << "closefile:\n"
+        << "  %c = call i32 @fclose(i8* %file)\n"
+        << "  br label %table\n"
+        << "table:\n"
+        << "  %tfile = call i8* @fopen(" << table << ", " << mode << ")\n"
+        << "  %notable = icmp eq i8* %tfile, null\n"
+        << "  br i1 %notable, label %done, label %header\n"
+        << "header:\n"
+        << "  %h = call i32 @fputs(" << headerText << ", i8* %tfile)\n"
+        << "  br label %pick\n"
+        << "pick:\n" // the function not yet listed with the most self time
+        << "  br label %scan\n"
+        << "scan:\n"
+        << "  %f = phi i64 [ 0, %pick ], [ %fnext, %candidate ]\n"
+        << "  %best = phi i64 [ -1, %pick ], [ %best1, %candidate ]\n"
+        << "  %bestself = phi i64 [ -1, %pick ], [ %bestself1, %candidate ]\n"
+        << "  %end = icmp eq i64 %f, " << n << "\n"
+        << "  br i1 %end, label %picked, label %candidate\n"
+        << "candidate:\n"
+        << "  %callsp = " << at("calls", n, "i64", "%f") << "\n"
+        << "  %calls = load i64, i64* %callsp\n"
+        << "  %called = icmp ne i64 %calls, 0\n"
+        << "  %fselfp = " << at("self", n, "i64", "%f") << "\n"
+        << "  %fself = load i64, i64* %fselfp\n"
+        << "  %hotter = icmp sgt i64 %fself, %bestself\n"
+        << "  %take = and i1 %called, %hotter\n"
+        << "  %best1 = select i1 %take, i64 %f, i64 %best\n"
+        << "  %bestself1 = select i1 %take, i64 %fself, i64 %bestself\n"
+        << "  %fnext = add i64 %f, 1\n"
+        << "  br label %scan\n"
+        << "picked:\n"
+        << "  %any = icmp sge i64 %best, 0\n"
+        << "  br i1 %any, label %row, label %closetable\n"
+        << "row:\n"
+        << "  %namep = " << at("names", n, "i8*", "%best") << "\n"
+        << "  %name = load i8*, i8** %namep\n"
+        << "  %rcallsp = " << at("calls", n, "i64", "%best") << "\n"
+        << "  %rcalls = load i64, i64* %rcallsp\n"
+        << "  %rtotalp = " << at("total", n, "i64", "%best") << "\n"
+        << "  %rtotal = load i64, i64* %rtotalp\n"
+        << "  %r = call i32 (i8*, i8*, ...) @fprintf(i8* %tfile, " << row
+        << ", i8* %name, i64 %rcalls, i64 %bestself, i64 %rtotal)\n"
+        << "  store i64 0, i64* %rcallsp\n" // listed
+        << "  br label %pick\n"
+        << "closetable:\n"
+        << "  %ct = call i32 @fclose(i8* %tfile)\n"
+        << "  br label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+    intrinsicDecls.insert("declare i64 @llvm.readcyclecounter()");
+    libcDecls.insert("declare i8* @fopen(i8*, i8*)");
+    libcDecls.insert("declare i32 @fprintf(i8*, i8*, ...)");
+    libcDecls.insert("declare i32 @fputs(i8*, i8*)");
+    libcDecls.insert("declare i32 @fclose(i8*)");
+    return out.str();
+}
+
+int IRGenerator::heapSite(const CallExpr* call, const FunctionContext& fn) {
+    heapSites.push_back(fn.node->name + ":" + std::to_string(call->loc.line) + ":" + std::to_string(call->loc.column));
+    return static_cast<int>(heapSites.size() - 1);
+}
+
+namespace {
+
+constexpr size_t kSizeBuckets = 65; // 0, then [2^(k-1), 2^k) for k = 1..64
+constexpr size_t kTimelineSamples = 256;
+
+} // namespace
+
+// Every block gets a 16-byte header holding its size and the id of its
+// call site, so free finds both in constant time without a table of live
+// pointers; the 16 keeps the malloc alignment. The counters are plain
+// globals, as programs are single-threaded. Live bytes are sampled every
+// `interval` allocations and frees; when the timeline fills, every other
+// sample is dropped and the interval doubled, so it always spans the
+// whole run in at most kTimelineSamples points. Peak live bytes are exact.
+//
+// At exit a destructor writes the totals, the leaked blocks and bytes, the
+// nonempty size buckets, a line per call site that allocated (allocations,
+// bytes, blocks and bytes still live at exit) and the timeline to the
+// -fheap-profile file. free must only see pointers this runtime returned.
+std::string IRGenerator::heapRuntime() {
+    std::ostringstream out, strings;
+    size_t n = heapSites.size();
+    auto array = [](size_t count, const char* type) { return "[" + std::to_string(count) + " x " + type + "]"; };
+    // the address of element i of the global g, an array of count types
+    auto at = [&](const char* g, size_t count, const char* type, const char* i) {
+        std::string a = array(count, type);
+        return "getelementptr inbounds " + a + ", " + a + "* @__heap." + g + ", i64 0, i64 " + i;
+    };
+    int stringCount = 0;
+    auto str = [&](const std::string& text) {
+        std::string g = "@__heap.s." + std::to_string(stringCount++);
+        std::string a = array(text.size() + 1, "i8");
+        strings << g << " = private constant " << a << " c\"" << cString(text) << "\"\n";
+        return "i8* getelementptr inbounds (" + a + ", " + a + "* " + g + ", i64 0, i64 0)";
+    };
+    // "%r = load i64, ..." then "add"/"sub" of v and store back, for global g (an address)
+    auto bump = [](const std::string& r, const std::string& g, const char* op, const std::string& v) {
+        return "  " + r + " = load i64, i64* " + g + "\n  " + r + "1 = " + op + " i64 " + r + ", " + v + "\n  store i64 " + r
+             + "1, i64* " + g + "\n";
+    };
+    const size_t B = kSizeBuckets, T = kTimelineSamples;
+
+    for (const char* g : {"allocs", "bytes", "frees", "live", "peak"}) out << "@__heap." << g << " = internal global i64 0\n";
+    out << "@__heap.sizes = internal global " << array(B, "i64") << " zeroinitializer\n";
+    for (const char* g : {"allocs", "bytes", "blocks", "live"})
+        out << "@__heap.site." << g << " = internal global " << array(n, "i64") << " zeroinitializer\n";
+    out << "@__heap.sites = internal constant " << array(n, "i8*") << (n ? " [" : " zeroinitializer");
+    for (size_t i = 0; i < n; ++i) out << (i ? ", " : "") << str(heapSites[i]);
+    out << (n ? "]\n" : "\n");
+    out << "@__heap.timeline = internal global " << array(T, "i64") << " zeroinitializer\n";
+    out << "@__heap.samples = internal global i32 0\n";
+    out << "@__heap.interval = internal global i64 1\n";
+    out << "@__heap.countdown = internal global i64 1\n";
+    std::string file = str(opts.heapProfile), mode = str("w");
+    std::string totals = str("allocations %lld (%lld bytes), frees %lld, peak %lld bytes live\n");
+    std::string leaked = str("leaked %lld blocks (%lld bytes)\n");
+    std::string sizes = str("sizes\n"), bucket = str("  %12lld - %-12lld %lld\n");
+    char header[160];
+    std::snprintf(header, sizeof header, "%-28s %12s %12s %14s %13s\n", "sites", "allocations", "bytes", "leaked blocks",
+                  "leaked bytes");
+    std::string sitesHeader = str(header), siteRow = str("%-28s %12lld %12lld %14lld %13lld\n");
+    std::string timeline = str("live bytes every %lld allocations and frees:"), sample = str(" %lld"), newline = str("\n");
+    out << strings.str() << "\n";
+
+    out << "define internal noalias i8* @__heap.malloc(i64 %size, i32 %site) {\n"
+        << "entry:\n"
+        << "  %n = add i64 %size, 16\n"
+        << "  %block = call i8* @malloc(i64 %n)\n"
+        << "  %failed = icmp eq i8* %block, null\n"
+        << "  br i1 %failed, label %fail, label %track\n"
+        << "fail:\n"
+        << "  ret i8* null\n"
+        << "track:\n"
+        << "  %sizep = bitcast i8* %block to i64*\n"
+        << "  store i64 %size, i64* %sizep\n"
+        << "  %sitep8 = getelementptr inbounds i8, i8* %block, i64 8\n"
+        << "  %sitep = bitcast i8* %sitep8 to i32*\n"
+        << "  store i32 %site, i32* %sitep\n"
+        << "  %s = zext i32 %site to i64\n"
+        << "  %sap = " << at("site.allocs", n, "i64", "%s") << "\n"
+        << bump("%sa", "%sap", "add", "1")
+        << "  %sbp = " << at("site.bytes", n, "i64", "%s") << "\n"
+        << bump("%sb", "%sbp", "add", "%size")
+        << "  %sblp = " << at("site.blocks", n, "i64", "%s") << "\n"
+        << bump("%sbl", "%sblp", "add", "1")
+        << "  %slp = " << at("site.live", n, "i64", "%s") << "\n"
+        << bump("%sl", "%slp", "add", "%size")
+        << bump("%a", "@__heap.allocs", "add", "1")
+        << bump("%b", "@__heap.bytes", "add", "%size")
+        << bump("%l", "@__heap.live", "add", "%size")
+        << "  %peak = load i64, i64* @__heap.peak\n"
+        << "  %higher = icmp ugt i64 %l1, %peak\n"
+        << "  %peak1 = select i1 %higher, i64 %l1, i64 %peak\n"
+        << "  store i64 %peak1, i64* @__heap.peak\n"
+        << "  %lz = call i64 @llvm.ctlz.i64(i64 %size, i1 false)\n"
+        << "  %k = sub i64 64, %lz\n"
+        << "  %kp = " << at("sizes", B, "i64", "%k") << "\n"
+        << bump("%kn", "%kp", "add", "1")
+        << "  call void @__heap.tick(i64 %l1)\n"
+        << "  %p = getelementptr inbounds i8, i8* %block, i64 16\n"
+        << "  ret i8* %p\n"
+        << "}\n\n";
+
+    out << "define internal void @__heap.free(i8* %p) {\n"
+        << "entry:\n"
+        << "  %null = icmp eq i8* %p, null\n"
+        << "  br i1 %null, label %done, label %track\n"
+        << "track:\n"
+        << "  %block = getelementptr inbounds i8, i8* %p, i64 -16\n"
+        << "  %sizep = bitcast i8* %block to i64*\n"
+        << "  %size = load i64, i64* %sizep\n"
+        << "  %sitep8 = getelementptr inbounds i8, i8* %block, i64 8\n"
+        << "  %sitep = bitcast i8* %sitep8 to i32*\n"
+        << "  %site = load i32, i32* %sitep\n"
+        << "  %s = zext i32 %site to i64\n"
+        << "  %sblp = " << at("site.blocks", n, "i64", "%s") << "\n"
+        << bump("%sbl", "%sblp", "sub", "1")
+        << "  %slp = " << at("site.live", n, "i64", "%s") << "\n"
+        << bump("%sl", "%slp", "sub", "%size")
+        << bump("%f", "@__heap.frees", "add", "1")
+        << bump("%l", "@__heap.live", "sub", "%size")
+        << "  call void @__heap.tick(i64 %l1)\n"
+        << "  call void @free(i8* %block)\n"
+        << "  br label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+
+    out << "define internal void @__heap.tick(i64 %live) {\n"
+        << "entry:\n"
+        << "  %left = load i64, i64* @__heap.countdown\n"
+        << "  %left1 = sub i64 %left, 1\n"
+        << "  %due = icmp eq i64 %left1, 0\n"
+        << "  br i1 %due, label %sample, label %wait\n"
+        << "wait:\n"
+        << "  store i64 %left1, i64* @__heap.countdown\n"
+        << "  ret void\n"
+        << "sample:\n"
+        << "  %interval = load i64, i64* @__heap.interval\n"
+        << "  store i64 %interval, i64* @__heap.countdown\n"
+        << "  %n = load i32, i32* @__heap.samples\n"
+        << "  %n64 = zext i32 %n to i64\n"
+        << "  %tp = " << at("timeline", T, "i64", "%n64") << "\n"
+        << "  store i64 %live, i64* %tp\n"
+        << "  %n1 = add i32 %n, 1\n"
+        << "  %full = icmp eq i32 %n1, " << T << "\n"
+        << "  br i1 %full, label %halve, label %keep\n"
+        << "keep:\n"
+        << "  store i32 %n1, i32* @__heap.samples\n"
+        << "  ret void\n"
+        << "halve:\n" // keep every other sample, at twice the interval
+        << "  %i = phi i64 [ 0, %sample ], [ %inext, %halve ]\n"
+        << "  %from0 = shl i64 %i, 1\n"
+        << "  %from = add i64 %from0, 1\n"
+        << "  %fp = " << at("timeline", T, "i64", "%from") << "\n"
+        << "  %v = load i64, i64* %fp\n"
+        << "  %ip = " << at("timeline", T, "i64", "%i") << "\n"
+        << "  store i64 %v, i64* %ip\n"
+        << "  %inext = add i64 %i, 1\n"
+        << "  %more = icmp ult i64 %inext, " << T / 2 << "\n"
+        << "  br i1 %more, label %halve, label %halved\n"
+        << "halved:\n"
+        << "  store i32 " << T / 2 << ", i32* @__heap.samples\n"
+        << "  %interval2 = shl i64 %interval, 1\n"
+        << "  store i64 %interval2, i64* @__heap.interval\n"
+        << "  store i64 %interval2, i64* @__heap.countdown\n"
+        << "  ret void\n"
+        << "}\n\n";
+
+    out << "define internal void @__heap.dump() {\n"
+        << "entry:\n"
+        << "  %file = call i8* @fopen(" << file << ", " << mode << ")\n"
+        << "  %nofile = icmp eq i8* %file, null\n"
+        << "  br i1 %nofile, label %done, label %totals\n"
+        << "totals:\n"
+        << "  %allocs = load i64, i64* @__heap.allocs\n"
+        << "  %bytes = load i64, i64* @__heap.bytes\n"
+        << "  %frees = load i64, i64* @__heap.frees\n"
+        << "  %peak = load i64, i64* @__heap.peak\n"
+        << "  %live = load i64, i64* @__heap.live\n"
+        << "  %w0 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << totals
+        << ", i64 %allocs, i64 %bytes, i64 %frees, i64 %peak)\n"
+        << "  %blocks = sub i64 %allocs, %frees\n"
+        << "  %w1 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << leaked << ", i64 %blocks, i64 %live)\n"
+        << "  %w2 = call i32 @fputs(" << sizes << ", i8* %file)\n"
+        << "  br label %size\n"
+        << "size:\n"
+        << "  %k = phi i64 [ 0, %totals ], [ %knext, %nextsize ]\n"
+        << "  %kp = " << at("sizes", B, "i64", "%k") << "\n"
+        << "  %kn = load i64, i64* %kp\n"
+        << "  %seen = icmp ne i64 %kn, 0\n"
+        << "  br i1 %seen, label %bucket, label %nextsize\n"
+        << "bucket:\n"
+        << "  %zero = icmp eq i64 %k, 0\n"
+        << "  %k1 = sub i64 %k, 1\n"
+        << "  %shift = select i1 %zero, i64 0, i64 %k1\n"
+        << "  %pow = shl i64 1, %shift\n"
+        << "  %lo = select i1 %zero, i64 0, i64 %pow\n"
+        << "  %pow2 = shl i64 %pow, 1\n"
+        << "  %top = sub i64 %pow2, 1\n"
+        << "  %hi = select i1 %zero, i64 0, i64 %top\n"
+        << "  %w3 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << bucket << ", i64 %lo, i64 %hi, i64 %kn)\n"
+        << "  br label %nextsize\n"
+        << "nextsize:\n"
+        << "  %knext = add i64 %k, 1\n"
+        << "  %kmore = icmp ult i64 %knext, " << B << "\n"
+        << "  br i1 %kmore, label %size, label %sites\n"
+        << "sites:\n"
+        << "  %w4 = call i32 @fputs(" << sitesHeader << ", i8* %file)\n"
+        << "  br label %sitecheck\n"
+        << "sitecheck:\n"
+        << "  %s = phi i64 [ 0, %sites ], [ %snext, %nextsite ]\n"
+        << "  %sleft = icmp ult i64 %s, " << n << "\n"
+        << "  br i1 %sleft, label %site, label %timeline\n"
+        << "site:\n"
+        << "  %sap = " << at("site.allocs", n, "i64", "%s") << "\n"
+        << "  %sa = load i64, i64* %sap\n"
+        << "  %used = icmp ne i64 %sa, 0\n"
+        << "  br i1 %used, label %siterow, label %nextsite\n"
+        << "siterow:\n"
+        << "  %namep = " << at("sites", n, "i8*", "%s") << "\n"
+        << "  %name = load i8*, i8** %namep\n"
+        << "  %sbp = " << at("site.bytes", n, "i64", "%s") << "\n"
+        << "  %sb = load i64, i64* %sbp\n"
+        << "  %sblp = " << at("site.blocks", n, "i64", "%s") << "\n"
+        << "  %sbl = load i64, i64* %sblp\n"
+        << "  %slp = " << at("site.live", n, "i64", "%s") << "\n"
+        << "  %sl = load i64, i64* %slp\n"
+        << "  %w5 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << siteRow
+        << ", i8* %name, i64 %sa, i64 %sb, i64 %sbl, i64 %sl)\n"
+        << "  br label %nextsite\n"
+        << "nextsite:\n"
+        << "  %snext = add i64 %s, 1\n"
+        << "  br label %sitecheck\n"
+        << "timeline:\n"
+        << "  %interval = load i64, i64* @__heap.interval\n"
+        << "  %samples = load i32, i32* @__heap.samples\n"
+        << "  %samples64 = zext i32 %samples to i64\n"
+        << "  %w6 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << timeline << ", i64 %interval)\n"
+        << "  br label %samplecheck\n"
+        << "samplecheck:\n"
+        << "  %j = phi i64 [ 0, %timeline ], [ %jnext, %sample ]\n"
+        << "  %jleft = icmp ult i64 %j, %samples64\n"
+        << "  br i1 %jleft, label %sample, label %end\n"
+        << "sample:\n"
+        << "  %tp = " << at("timeline", T, "i64", "%j") << "\n"
+        << "  %tv = load i64, i64* %tp\n"
+        << "  %w7 = call i32 (i8*, i8*, ...) @fprintf(i8* %file, " << sample << ", i64 %tv)\n"
+        << "  %jnext = add i64 %j, 1\n"
+        << "  br label %samplecheck\n"
+        << "end:\n"
+        << "  %w8 = call i32 @fputs(" << newline << ", i8* %file)\n"
+        << "  %c = call i32 @fclose(i8* %file)\n"
+        << "  br label %done\n"
+        << "done:\n"
+        << "  ret void\n"
+        << "}\n\n";
+    intrinsicDecls.insert("declare i64 @llvm.ctlz.i64(i64, i1 immarg)");
+    libcDecls.insert("declare noalias i8* @malloc(i64)");
+    libcDecls.insert("declare void @free(i8*)");
+    libcDecls.insert("declare i8* @fopen(i8*, i8*)");
+    libcDecls.insert("declare i32 @fprintf(i8*, i8*, ...)");
+    libcDecls.insert("declare i32 @fputs(i8*, i8*)");
+    libcDecls.insert("declare i32 @fclose(i8*)");
+    return out.str();
+}
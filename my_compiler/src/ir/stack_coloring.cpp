@@ -0,0 +1,102 @@
+// Stack slot coloring. A local lives from the start of the block or for
+// statement that declares it (the scope sema gives it) to its end, so the
+// locals of two scopes of which neither encloses the other are never live
+// at once and can share an alloca. Scopes are entered and left in emission
+// order, which makes this a stack discipline: a scope takes its allocas
+// from those its earlier siblings gave back, of the same IR type, and makes
+// new ones only when none is free. The function's outermost block keeps
+// the allocas made on first use, which stay live throughout.
+//
+// Arrays and structs also get llvm.lifetime.start when their scope is
+// entered and llvm.lifetime.end when it is left, by falling off its end or
+// by break or continue, so that llc can overlap what this pass cannot
+// share (say, two arrays of different lengths). Scalars get no markers:
+// casting their alloca would make value numbering treat it as
+// address-taken, and mem2reg removes them anyway.
+//
+// A goto can enter a scope past its start, so functions with labels are
+// left alone.
+#include "ir_generator.h"
+#include "struct_layout.h"
+
+namespace {
+
+// The non-static locals whose scope is `s`'s: declared in it but not in a
+// nested block or for statement. Declarations directly under a switch case
+// belong to the enclosing scope, like any other statement list.
+void scopeLocals(const Stmt* s, bool owner, std::vector<const VarDeclStmt*>& out) {
+    if (!s) return;
+    if (auto d = dynamic_cast<const VarDeclStmt*>(s)) {
+        if (!d->isStatic && d->slot >= 0) out.push_back(d);
+    } else if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+        if (owner) for (const auto& st : b->statements) scopeLocals(st.get(), false, out);
+    } else if (auto f = dynamic_cast<const ForStmt*>(s)) {
+        if (owner) { scopeLocals(f->init.get(), false, out); scopeLocals(f->body.get(), false, out); }
+    } else if (auto i = dynamic_cast<const IfStmt*>(s)) {
+        scopeLocals(i->thenBranch.get(), false, out);
+        scopeLocals(i->elseBranch.get(), false, out);
+    } else if (auto w = dynamic_cast<const WhileStmt*>(s)) {
+        scopeLocals(w->body.get(), false, out);
+    } else if (auto dw = dynamic_cast<const DoWhileStmt*>(s)) {
+        scopeLocals(dw->body.get(), false, out);
+    } else if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+        for (const auto& c : sw->cases)
+            for (const auto& st : c.statements) scopeLocals(st.get(), false, out);
+        for (const auto& st : sw->defaultBody) scopeLocals(st.get(), false, out);
+    }
+}
+
+bool aggregate(const Type* t) { return t->kind == TypeKind::Array || t->kind == TypeKind::Struct; }
+
+} // namespace
+
+void IRGenerator::openScope(const Stmt* owner, FunctionContext& fn) {
+    if (!fn.colorSlots) return;
+    std::vector<const VarDeclStmt*> locals;
+    scopeLocals(owner, true, locals);
+    FunctionContext::Scope scope;
+    for (const VarDeclStmt* d : locals) {
+        const Type* type = fn.node->slots[static_cast<size_t>(d->slot)].type;
+        std::string ty = typeToIR(type);
+        auto& free = fn.freeSlots[ty];
+        std::string addr;
+        if (free.empty()) {
+            addr = slotAddress(d->slot, fn);
+        } else {
+            addr = fn.slotAddr[static_cast<size_t>(d->slot)] = free.back();
+            free.pop_back();
+            ++frames.locals;
+            frames.before += static_cast<long long>(sizeOf(type));
+        }
+        scope.slots.push_back(d->slot);
+        if (!aggregate(type)) continue;
+        size_t size = sizeOf(type);
+        std::string p = newTemp(fn);
+        fn.body << "  " << p << " = bitcast " << ty << "* " << addr << " to i8*\n";
+        fn.body << "  call void @llvm.lifetime.start.p0i8(i64 " << size << ", i8* " << p << ")\n";
+        intrinsicDecls.insert("declare void @llvm.lifetime.start.p0i8(i64 immarg, i8* nocapture)");
+        scope.markers.emplace_back(p, size);
+    }
+    fn.scopes.push_back(std::move(scope));
+}
+
+void IRGenerator::endScopes(size_t keep, FunctionContext& fn) {
+    if (fn.currentTerminated) return;
+    for (size_t i = fn.scopes.size(); i-- > keep;) {
+        const auto& markers = fn.scopes[i].markers;
+        for (auto m = markers.rbegin(); m != markers.rend(); ++m) {
+            fn.body << "  call void @llvm.lifetime.end.p0i8(i64 " << m->second << ", i8* " << m->first << ")\n";
+            intrinsicDecls.insert("declare void @llvm.lifetime.end.p0i8(i64 immarg, i8* nocapture)");
+        }
+    }
+}
+
+void IRGenerator::closeScope(FunctionContext& fn) {
+    if (!fn.colorSlots) return;
+    endScopes(fn.scopes.size() - 1, fn);
+    for (int slot : fn.scopes.back().slots) {
+        std::string ty = typeToIR(fn.node->slots[static_cast<size_t>(slot)].type);
+        fn.freeSlots[ty].push_back(fn.slotAddr[static_cast<size_t>(slot)]);
+    }
+    fn.scopes.pop_back();
+}
@@ -0,0 +1,142 @@
+// Switches that only produce a value become a lookup in a constant table.
+// Two shapes qualify, where every K is a constant (a number, or a negated
+// one):
+//
+//   case A: return K;                 case A: x = K; break;
+//
+// the same variable x (an int or char) in every case of the second. A case
+// with no statements takes the value of the one it falls through to, and
+// the default takes the same shape (or, for x, `x = K;` alone, being last).
+// The cases must be dense: at least kMinCases of them, covering at least
+// two fifths of the span from the smallest to the largest, itself no more
+// than kMaxEntries. Values in the span with no case of their own are filled
+// with the default's, so without a default the span must have no holes.
+//
+// The switch becomes one unsigned compare of the value less the smallest
+// case against the span, and a load from the table when it is within; the
+// default (or the end of the switch) is left for the values outside.
+#include "ir_generator.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+
+namespace {
+
+constexpr size_t kMinCases = 4;
+constexpr long long kMaxEntries = 1024;
+
+// The value of e after its conversion, if it is a constant.
+std::optional<long long> constant(const Expr* e) {
+    if (e->conv != ImplicitConv::None && e->conv != ImplicitConv::IntToChar) return std::nullopt;
+    long long k;
+    if (auto n = dynamic_cast<const NumberExpr*>(e)) {
+        k = n->value;
+    } else {
+        auto u = dynamic_cast<const UnaryExpr*>(e);
+        auto m = u && u->op == "-" ? dynamic_cast<const NumberExpr*>(u->operand.get()) : nullptr;
+        if (!m || m->conv != ImplicitConv::None) return std::nullopt;
+        k = -m->value;
+    }
+    return e->conv == ImplicitConv::IntToChar ? static_cast<signed char>(k) : k;
+}
+
+// The value `stmts` returns or gives `target` (set by the first assignment
+// seen); `last` allows an assignment without its break. Null if the
+// statements are not of the shape.
+std::optional<long long> produced(const std::vector<std::unique_ptr<Stmt>>& stmts, bool last, const Expr*& target) {
+    if (stmts.size() == 1)
+        if (auto r = dynamic_cast<const ReturnStmt*>(stmts[0].get())) return r->value ? constant(r->value.get()) : std::nullopt;
+    if (stmts.size() != 2 && !(last && stmts.size() == 1)) return std::nullopt;
+    if (stmts.size() == 2 && !dynamic_cast<const BreakStmt*>(stmts[1].get())) return std::nullopt;
+    auto e = dynamic_cast<const ExprStmt*>(stmts[0].get());
+    auto a = e ? dynamic_cast<const AssignExpr*>(e->expr.get()) : nullptr;
+    auto v = a ? dynamic_cast<const VarExpr*>(a->target.get()) : nullptr;
+    if (!v || v->slot < 0 || v->conv != ImplicitConv::None) return std::nullopt;
+    if (v->type->kind != TypeKind::Int && v->type->kind != TypeKind::Char) return std::nullopt;
+    if (!target) target = v;
+    else if (static_cast<const VarExpr*>(target)->slot != v->slot) return std::nullopt;
+    return constant(a->value.get());
+}
+
+} // namespace
+
+bool IRGenerator::switchTable(const SwitchStmt* sw, const IRValue& v, FunctionContext& fn) {
+    ++switchTables.switches;
+    if (sw->cases.size() < kMinCases) return false;
+    const Expr* target = nullptr; // x, or null for the return shape
+    bool returns = false, seen = false;
+    auto shape = [&](const std::vector<std::unique_ptr<Stmt>>& stmts, bool last) -> std::optional<long long> {
+        std::optional<long long> k = produced(stmts, last, target);
+        bool r = k && dynamic_cast<const ReturnStmt*>(stmts[0].get());
+        if (!k || (seen && r != returns)) return std::nullopt;
+        seen = true;
+        returns = r;
+        return k;
+    };
+
+    std::optional<long long> fallback;
+    if (!sw->defaultBody.empty() && !(fallback = shape(sw->defaultBody, true))) return false;
+    // from the last case back, so that an empty case can take the value of the next
+    std::map<long long, long long> values;
+    std::optional<long long> next = fallback;
+    bool nextIsDefault = true;
+    for (size_t i = sw->cases.size(); i-- > 0;) {
+        const SwitchCase& c = sw->cases[i];
+        if (!c.statements.empty()) {
+            if (!(next = shape(c.statements, false))) return false;
+            nextIsDefault = false;
+        } else if (!next || (nextIsDefault && sw->defaultBody.empty())) {
+            return false;
+        }
+        if (!values.emplace(c.value, *next).second) return false;
+    }
+    if (returns && typeToIR(fn.node->returnType) != "i32") return false;
+
+    long long lo = values.begin()->first, hi = values.rbegin()->first;
+    long long span = hi - lo + 1;
+    if (lo < INT32_MIN || hi > INT32_MAX || span > kMaxEntries || static_cast<long long>(values.size()) * 5 < span * 2) return false;
+    if (!fallback && static_cast<long long>(values.size()) != span) return false;
+
+    std::string ty = returns ? "i32" : typeToIR(target->type);
+    std::string table = "@switch.table" + std::to_string(switchTables.tables++);
+    std::string array = "[" + std::to_string(span) + " x " + ty + "]";
+    std::string init;
+    for (long long k = lo; k <= hi; ++k) {
+        auto it = values.find(k);
+        init += (k == lo ? "" : ", ") + ty + " " + std::to_string(it != values.end() ? it->second : *fallback);
+    }
+    globalDefs.push_back(table + " = private unnamed_addr constant " + array + " [" + init + "], align 4\n");
+    switchTables.entries += static_cast<int>(span);
+
+    std::string lookupL = newLabel(fn, "switch.lookup");
+    std::string endL = newLabel(fn, "switch.end");
+    std::string defaultL = fallback ? newLabel(fn, "switch.default") : endL;
+    std::string index = newTemp(fn), in = newTemp(fn), addr = newTemp(fn), value = newTemp(fn);
+    fn.body << "  " << index << " = sub i32 " << v.reg << ", " << lo << "\n";
+    fn.body << "  " << in << " = icmp ult i32 " << index << ", " << span << "\n";
+    cbranch(fn, IRValue{in, "i1"}, lookupL, defaultL);
+    startBlock(fn, lookupL);
+    fn.body << "  " << addr << " = getelementptr inbounds " << array << ", " << array << "* " << table << ", i32 0, i32 " << index << "\n";
+    fn.body << "  " << value << " = load " << ty << ", " << ty << "* " << addr << ", align " << (ty == "i8" ? 1 : 4) << "\n";
+    if (returns) {
+        if (!opts.instrumentFunctions.empty()) instrumentExit(fn);
+        fn.body << "  ret i32 " << value << "\n";
+        fn.currentTerminated = true;
+    } else {
+        IRValue x = lvalueAddress(target, fn);
+        fn.body << "  store " << ty << " " << value << ", " << x.type << " " << x.reg << tbaaTag(target) << "\n";
+        branch(fn, endL);
+    }
+    if (fallback) {
+        startBlock(fn, defaultL);
+        fn.loopStack.push_back(LoopTargets{"", endL, fn.scopes.size()});
+        for (const auto& st : sw->defaultBody) {
+            if (fn.currentTerminated) break;
+            emitStmt(st.get(), fn);
+        }
+        fn.loopStack.pop_back();
+        branch(fn, endL);
+    }
+    startBlock(fn, endL);
+    return true;
+}
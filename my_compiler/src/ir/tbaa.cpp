@@ -0,0 +1,69 @@
+// Type-based alias analysis metadata for loads and stores. The type tree
+// follows C's aliasing rules the way clang builds it: char may alias any
+// object, so it is the only child of the root and every other type hangs
+// off it; int, float and pointers (one node for all pointer types) are
+// distinct scalars; a struct is a node listing its fields at their offsets,
+// in memory order. An access to a struct field is tagged with the struct
+// and the field's offset, so that p->a and q->b are told apart even when
+// both are ints; any other access is tagged with its scalar type. Arrays
+// and whole structs get no tag, which LLVM takes as "may alias anything".
+#include "ir_generator.h"
+
+std::string IRGenerator::tbaaNode(const std::string& key, const std::string& node) {
+    auto it = tbaaNodes.find(key);
+    if (it != tbaaNodes.end()) return it->second;
+    return tbaaNodes[key] = addMetadata(node);
+}
+
+std::string IRGenerator::tbaaScalar(const Type* t) {
+    std::string name;
+    switch (t->kind) {
+    case TypeKind::Char: {
+        std::string root = tbaaNode("root", "!{!\"mycc TBAA\"}");
+        return tbaaNode("char", "!{!\"omnipotent char\", " + root + ", i64 0}");
+    }
+    case TypeKind::Int: name = "int"; break;
+    case TypeKind::Float: name = "float"; break;
+    case TypeKind::Pointer: name = "any pointer"; break;
+    default: return "";
+    }
+    std::string parent = tbaaScalar(Type::Char());
+    return tbaaNode(name, "!{!\"" + name + "\", " + parent + ", i64 0}");
+}
+
+std::string IRGenerator::tbaaStruct(const Type* st) {
+    if (!st->layout) return "";
+    std::string key = "struct." + st->structName;
+    if (auto it = tbaaNodes.find(key); it != tbaaNodes.end()) return it->second;
+    std::string node = "!{!\"" + key + "\"";
+    for (size_t i : st->layout->memoryOrder) {
+        const StructField& f = st->layout->fields[i];
+        std::string field = tbaaScalar(f.type);
+        if (field.empty()) return tbaaNodes[key] = "";
+        node += ", " + field + ", i64 " + std::to_string(f.offset);
+    }
+    return tbaaNode(key, node + "}");
+}
+
+std::string IRGenerator::tbaaTag(const std::string& base, const std::string& access, size_t offset) {
+    if (base.empty() || access.empty()) return "";
+    std::string off = std::to_string(offset);
+    return ", !tbaa " + tbaaNode("tag " + base + " " + access + " " + off, "!{" + base + ", " + access + ", i64 " + off + "}");
+}
+
+std::string IRGenerator::tbaaTag(const Type* t) {
+    if (!opts.strictAliasing) return "";
+    std::string scalar = tbaaScalar(t);
+    return tbaaTag(scalar, scalar, 0);
+}
+
+std::string IRGenerator::tbaaTag(const Expr* lvalue) {
+    if (!opts.strictAliasing) return "";
+    const Type* st = nullptr;
+    size_t fieldIndex = 0;
+    if (auto m = dynamic_cast<const MemberExpr*>(lvalue)) { st = m->base->type; fieldIndex = m->fieldIndex; }
+    else if (auto pm = dynamic_cast<const PtrMemberExpr*>(lvalue)) { st = pm->base->valueType()->element; fieldIndex = pm->fieldIndex; }
+    if (!st || !st->layout) return tbaaTag(lvalue->type);
+    const StructField& f = st->layout->fields[st->layout->memoryOrder[fieldIndex]];
+    return tbaaTag(tbaaStruct(st), tbaaScalar(f.type), f.offset);
+}
@@ -0,0 +1,118 @@
+// Local value numbering over the emitted text of one function. Within a
+// block, an instruction with the same opcode and operands as one seen
+// earlier is dropped and its uses are pointed at the earlier result, and a
+// load is dropped when its location was already loaded or stored with no
+// write in between that may have changed it. The earlier result's block
+// dominates every use of the dropped one, so the renaming is applied to
+// the whole function, phis included.
+//
+// An alloca whose address is only ever the pointer operand of loads and
+// stores (a local that is not address-taken) can only change through a
+// store to it. Any other store, and any call, may change every location
+// except those.
+#include "ir_generator.h"
+#include "ir_text.h"
+#include <string_view>
+
+namespace {
+
+// Lets the tables below be searched with a string_view into the body.
+struct ViewHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+using Table = std::unordered_map<std::string, std::string, ViewHash, std::equal_to<>>;
+
+} // namespace
+
+std::string IRGenerator::numberValues(const std::string& body, const FunctionContext& fn) {
+    std::vector<std::string_view> lines;
+    for (size_t b = 0, e; b < body.size(); b = e + 1) {
+        e = body.find('\n', b);
+        if (e == std::string::npos) e = body.size();
+        lines.push_back(std::string_view(body).substr(b, e - b));
+    }
+
+    size_t temps = static_cast<size_t>(fn.tempCounter);
+    std::vector<bool> privateSlot(temps, false);
+    for (const auto& a : fn.entryAllocas) {
+        size_t eq = a.find(" = alloca ");
+        if (int n = eq == std::string::npos ? -1 : irTempIndex(std::string_view(a).substr(2, eq - 2)); n >= 0)
+            privateSlot[static_cast<size_t>(n)] = true;
+    }
+    for (auto line : lines) {
+        IRInst inst;
+        std::string_view loc = parseIRInst(line, inst) ? irLocation(inst) : std::string_view{};
+        // fine as the pointer operand and nowhere else
+        size_t ptr = !loc.empty() ? static_cast<size_t>(loc.data() - line.data()) + loc.rfind(' ') + 1 : std::string_view::npos;
+        forEachTemp(line, [&](int n, size_t b, size_t) { if (b != ptr) privateSlot[static_cast<size_t>(n)] = false; });
+    }
+    auto isPrivate = [&](std::string_view loc) {
+        int n = irTempIndex(loc.substr(loc.rfind(' ') + 1));
+        return n >= 0 && privateSlot[static_cast<size_t>(n)];
+    };
+
+    std::vector<std::string> to(temps); // dropped %tN -> value replacing it
+    Table available; // instruction text -> its result
+    // "T* P" -> value last loaded or stored there, for private slots and
+    // for everything else
+    Table slotMemory, memory;
+
+    std::string out;
+    out.reserve(body.size());
+    std::string renamed;
+    bool hasPhi = false;
+    for (auto original : lines) {
+        IRInst inst;
+        if (!parseIRInst(original, inst)) {
+            if (!original.empty() && original[0] != ' ') { available.clear(); slotMemory.clear(); memory.clear(); } // a new block
+            out.append(original) += '\n';
+            continue;
+        }
+        ++valueNumbering.before;
+        renamed.clear();
+        std::string_view line = renameTemps(original, to, renamed) ? std::string_view(renamed) : original;
+        parseIRInst(line, inst);
+        std::string_view op = inst.op();
+        int result = irTempIndex(inst.result);
+        if (op == "load" && result >= 0) {
+            std::string_view loc = irLocation(inst);
+            Table& known = isPrivate(loc) ? slotMemory : memory;
+            if (auto it = known.find(loc); it != known.end()) {
+                to[static_cast<size_t>(result)] = it->second;
+                ++valueNumbering.loads;
+                continue;
+            }
+            known.emplace(loc, inst.result);
+        } else if (op == "store") {
+            std::string_view loc = irLocation(inst);
+            bool slot = isPrivate(loc);
+            // a private slot is only ever accessed with its own type
+            if (slot) slotMemory.erase(std::string(loc));
+            else memory.clear();
+            // "store T V": T is the pointer type without its '*'
+            std::string_view ty = loc.substr(0, loc.rfind(' ') - 1);
+            std::string_view stored = irOperand(inst.text, 0).substr(6);
+            if (stored.size() > ty.size() && stored.starts_with(ty) && stored[ty.size()] == ' ')
+                (slot ? slotMemory : memory).emplace(loc, stored.substr(ty.size() + 1));
+        } else if (op == "call") {
+            memory.clear();
+        } else if (irPure(op) && result >= 0) {
+            if (auto it = available.find(inst.text); it != available.end()) {
+                to[static_cast<size_t>(result)] = it->second;
+                ++valueNumbering.expressions;
+                continue;
+            }
+            available.emplace(inst.text, inst.result);
+        }
+        hasPhi |= op == "phi";
+        ++valueNumbering.after;
+        out.append(line) += '\n';
+    }
+    // a phi can name a value defined further down
+    if (hasPhi) {
+        std::string fixed;
+        if (renameTemps(out, to, fixed)) return fixed;
+    }
+    return out;
+}
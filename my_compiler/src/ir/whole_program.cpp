@@ -0,0 +1,255 @@
+// --whole-program: every unit is compiled into one module, so all call
+// sites and all stores are in view. Working on the text of the finished
+// functions:
+// - small non-recursive functions are inlined into their direct callers,
+//   callees first, so a function is inlined with its own calls expanded;
+// - statics that nothing stores to become constants and their loads are
+//   replaced by the initializer;
+// - everything but main gets internal linkage.
+#include "ir_generator.h"
+#include "ir_text.h"
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+namespace {
+
+// Callees with more instructions than this are left as calls.
+constexpr int kInlineLimit = 60;
+
+// A function split around its entry-block allocas, so that inlining can
+// hoist the callee's allocas into the caller's entry block.
+struct Body {
+    std::string header; // "define ... {"
+    std::string returnType;
+    std::vector<std::string> paramTypes;
+    std::vector<std::string> allocas;
+    std::vector<std::string> lines; // after the allocas, up to the closing brace
+    int size = 0;                   // instructions
+    int temps = 0;                  // %t0 .. %t(temps-1) may be in use
+    bool returns = false;           // has a ret (not only traps)
+};
+
+Body split(const std::string& text) {
+    Body b;
+    std::istringstream in(text);
+    std::getline(in, b.header);
+    std::string line;
+    std::getline(in, line); // entry:
+    while (std::getline(in, line) && line != "}") {
+        IRInst inst;
+        bool isInst = parseIRInst(line, inst);
+        if (isInst && inst.op() == "alloca" && b.lines.empty()) { b.allocas.push_back(line); continue; }
+        if (isInst) { ++b.size; b.returns |= inst.op() == "ret"; }
+        b.lines.push_back(line);
+    }
+    for (const auto* lines : {&b.allocas, &b.lines})
+        for (const auto& l : *lines)
+            forEachLocalName(l, [&](size_t s, size_t e) { b.temps = std::max(b.temps, irTempIndex(std::string_view(l).substr(s, e - s)) + 1); });
+    // "define [internal ]T @name(T1 %0, T2 %1)..."
+    size_t at = b.header.find(" @");
+    size_t start = b.header.rfind(' ', at - 1) + 1;
+    b.returnType = b.header.substr(start, at - start);
+    size_t open = b.header.find('(', at), close = b.header.find(')', open);
+    std::string_view params = std::string_view(b.header).substr(open + 1, close - open - 1);
+    for (int i = 0; !params.empty(); ++i) {
+        std::string_view p = irOperand(params, i);
+        if (p.empty()) break;
+        b.paramTypes.emplace_back(p.substr(0, p.rfind(' ')));
+    }
+    return b;
+}
+
+std::string join(const Body& b) {
+    std::string out = b.header + "\nentry:\n";
+    for (const auto& a : b.allocas) out += a + "\n";
+    for (const auto& l : b.lines) out += l + "\n";
+    return out + "}\n\n";
+}
+
+std::string renamed(std::string_view line, const std::function<std::string(std::string_view)>& to) {
+    std::string out;
+    size_t copied = 0;
+    forEachLocalName(line, [&](size_t b, size_t e) {
+        out.append(line, copied, b - copied);
+        out += to(line.substr(b + 1, e - b - 1));
+        copied = e;
+    });
+    return out.append(line, copied);
+}
+
+} // namespace
+
+void IRGenerator::optimizeWholeProgram(std::vector<FunctionText>& functions) {
+    std::unordered_map<std::string, size_t> index;
+    std::vector<Body> bodies;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        index.emplace(functions[i].name, i);
+        bodies.push_back(split(functions[i].text));
+    }
+    std::vector<std::vector<size_t>> calls(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        for (const auto& line : bodies[i].lines) {
+            IRInst inst;
+            if (!parseIRInst(line, inst)) continue;
+            if (auto it = index.find(std::string(irDirectCallee(inst))); it != index.end()) calls[i].push_back(it->second);
+        }
+    }
+
+    // callees first; a function in a cycle (or calling itself) is recursive
+    std::vector<size_t> order;
+    std::vector<bool> recursive;
+    callGraphOrder(calls, order, recursive);
+
+    auto inlinable = [&](size_t callee) {
+        const Body& b = bodies[callee];
+        return functions[callee].name != "main" && !recursive[callee] && b.returns && b.size <= kInlineLimit;
+    };
+    for (size_t f : order) {
+        Body& caller = bodies[f];
+        std::vector<std::string> lines;
+        lines.reserve(caller.lines.size());
+        int before = wholeProgram.inlined;
+        for (auto& line : caller.lines) {
+            IRInst inst;
+            auto it = parseIRInst(line, inst) ? index.find(std::string(irDirectCallee(inst))) : index.end();
+            if (it == index.end() || it->second == f || !inlinable(it->second)) { lines.push_back(std::move(line)); continue; }
+            const Body& callee = bodies[it->second];
+
+            // parameters become the arguments, the callee's temps are
+            // renumbered after the caller's and its labels get a suffix
+            std::string_view text = inst.text;
+            size_t open = text.find('(', text.find(" @"));
+            std::string_view argText = text.substr(open + 1, text.rfind(')') - open - 1);
+            std::vector<std::string> args;
+            for (size_t i = 0; i < callee.paramTypes.size(); ++i)
+                args.emplace_back(irOperand(argText, static_cast<int>(i)).substr(callee.paramTypes[i].size() + 1));
+            std::string suffix = ".i" + std::to_string(wholeProgram.inlined++);
+            int base = caller.temps;
+            caller.temps += callee.temps;
+            auto to = [&](std::string_view name) {
+                if (!name.empty() && name.find_first_not_of("0123456789") == std::string_view::npos)
+                    return args[static_cast<size_t>(std::stoi(std::string(name)))];
+                if (int n = irTempIndex("%" + std::string(name)); n >= 0) return "%t" + std::to_string(base + n);
+                if (name.substr(0, 7) == "struct.") return "%" + std::string(name);
+                return "%" + std::string(name) + suffix;
+            };
+            for (const auto& a : callee.allocas) caller.allocas.push_back(renamed(a, to));
+
+            std::string result(inst.result);
+            std::string label = "entry" + suffix;
+            std::vector<std::pair<std::string, std::string>> returns; // value, block
+            lines.push_back("  br label %" + label);
+            lines.push_back(label + ":");
+            for (const auto& l : callee.lines) {
+                if (!l.empty() && l[0] != ' ') {
+                    label = l.substr(0, l.size() - 1) + suffix;
+                    lines.push_back(label + ":");
+                    continue;
+                }
+                std::string r = renamed(l, to);
+                IRInst ri;
+                if (parseIRInst(r, ri) && ri.op() == "ret") {
+                    if (ri.text != "ret void") returns.emplace_back(ri.text.substr(5 + callee.returnType.size()), label);
+                    lines.push_back("  br label %ret" + suffix);
+                    continue;
+                }
+                lines.push_back(std::move(r));
+            }
+            lines.push_back("ret" + suffix + ":");
+            if (!result.empty()) {
+                std::string phi = "  " + result + " = phi " + callee.returnType + " ";
+                for (size_t i = 0; i < returns.size(); ++i)
+                    phi += (i ? ", [ " : "[ ") + returns[i].first + ", %" + returns[i].second + " ]";
+                lines.push_back(phi);
+            }
+        }
+        caller.lines = std::move(lines);
+        if (wholeProgram.inlined == before) continue;
+        // the arguments stored to the callee's parameter slots are now
+        // known values for its loads
+        if (opts.valueNumbering) {
+            FunctionContext ctx;
+            ctx.tempCounter = caller.temps;
+            ctx.entryAllocas = caller.allocas;
+            std::string text;
+            for (const auto& l : caller.lines) text += l + "\n";
+            ValueNumberingStats saved = valueNumbering; // -fcse-report counts each instruction once
+            std::istringstream in(numberValues(text, ctx));
+            valueNumbering = saved;
+            caller.lines.clear();
+            caller.size = 0;
+            for (std::string l; std::getline(in, l); caller.lines.push_back(l)) {
+                IRInst inst;
+                caller.size += parseIRInst(l, inst);
+            }
+        }
+    }
+
+    // statics whose every use is a load
+    std::unordered_map<std::string, std::string> initial; // @g -> "T C"
+    for (const auto& g : globalDefs) {
+        size_t eq = g.find(" = internal global ");
+        if (eq == std::string::npos) continue;
+        std::string rest = g.substr(eq + 19);
+        initial.emplace(g.substr(0, eq), rest.substr(0, rest.find(',')));
+    }
+    auto globalsIn = [](const std::string& line, const std::function<void(const std::string&)>& f) {
+        for (size_t i = line.find('@'); i != std::string::npos; i = line.find('@', i + 1)) {
+            size_t j = i + 1;
+            while (j < line.size() && irNameChar(line[j])) ++j;
+            f(line.substr(i, j - i));
+        }
+    };
+    for (const auto& b : bodies) {
+        for (const auto& line : b.lines) {
+            IRInst inst;
+            bool load = parseIRInst(line, inst) && inst.op() == "load";
+            std::string_view loc = load ? irLocation(inst) : std::string_view{};
+            globalsIn(line, [&](const std::string& g) {
+                if (!load || loc.substr(loc.rfind(' ') + 1) != g) initial.erase(g);
+            });
+        }
+    }
+    if (!initial.empty()) {
+        for (auto& g : globalDefs) {
+            size_t eq = g.find(" = internal global ");
+            if (eq == std::string::npos || !initial.count(g.substr(0, eq))) continue;
+            g.replace(eq, 19, " = internal constant ");
+            ++wholeProgram.constants;
+        }
+        for (auto& b : bodies) {
+            std::unordered_map<std::string, std::string> folded;
+            std::vector<std::string> lines;
+            for (auto& line : b.lines) {
+                IRInst inst;
+                if (parseIRInst(line, inst) && inst.op() == "load") {
+                    std::string_view loc = irLocation(inst);
+                    auto it = initial.find(std::string(loc.substr(loc.rfind(' ') + 1)));
+                    if (it != initial.end()) {
+                        folded.emplace(inst.result.substr(1), it->second.substr(it->second.find(' ') + 1));
+                        continue;
+                    }
+                }
+                lines.push_back(std::move(line));
+            }
+            if (!folded.empty()) {
+                for (auto& line : lines) {
+                    line = renamed(line, [&](std::string_view name) {
+                        auto it = folded.find(std::string(name));
+                        return it != folded.end() ? it->second : "%" + std::string(name);
+                    });
+                }
+            }
+            b.lines = std::move(lines);
+        }
+    }
+
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        if (functions[i].name != "main") {
+            bodies[i].header.insert(7, "internal ");
+            ++wholeProgram.internalized;
+        }
+        functions[i].text = join(bodies[i]);
+    }
+}
@@ -0,0 +1,300 @@
+#include "lexer.h"
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define LEXER_SIMD 1
+#else
+#define LEXER_SIMD 0
+#endif
+
+namespace {
+// ---- character classes (scalar) ----
+inline bool isSpace(unsigned char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+inline bool isDigit(unsigned char c) { return c >= '0' && c <= '9'; }
+inline bool isIdentStart(unsigned char c) { return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_'; }
+inline bool isIdentChar(unsigned char c) { return isIdentStart(c) || isDigit(c); }
+
+// ---- vector helpers: one width per build, scalar loops handle the tail ----
+#if LEXER_SIMD
+#if defined(__AVX2__)
+using Vec = __m256i;
+constexpr size_t kVec = 32;
+inline Vec vload(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline Vec vset(char c) { return _mm256_set1_epi8(c); }
+inline Vec veq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec vlt(Vec a, Vec b) { return _mm256_cmpgt_epi8(b, a); }
+inline Vec vadd(Vec a, Vec b) { return _mm256_add_epi8(a, b); }
+inline uint32_t vmask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+constexpr uint32_t kFullMask = 0xFFFFFFFFu;
+#else
+using Vec = __m128i;
+constexpr size_t kVec = 16;
+inline Vec vload(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline Vec vset(char c) { return _mm_set1_epi8(c); }
+inline Vec veq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+inline Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec vlt(Vec a, Vec b) { return _mm_cmplt_epi8(a, b); }
+inline Vec vadd(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+inline uint32_t vmask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+constexpr uint32_t kFullMask = 0xFFFFu;
+#endif
+
+// lo <= c <= hi, by biasing lo to -128 and doing one signed compare
+inline Vec vrange(Vec c, char lo, char hi) {
+    Vec t = vadd(c, vset(static_cast<char>(0x80 - static_cast<unsigned char>(lo))));
+    return vlt(t, vset(static_cast<char>(0x80 + (hi - lo) + 1)));
+}
+inline Vec vspace(Vec c) {
+    return vor(vor(veq(c, vset(' ')), veq(c, vset('\n'))), vrange(c, '\t', '\r')); // \t \n \v \f \r
+}
+inline Vec vdigit(Vec c) { return vrange(c, '0', '9'); }
+inline Vec vident(Vec c) {
+    Vec lower = vor(c, vset(0x20));
+    return vor(vor(vrange(lower, 'a', 'z'), vdigit(c)), veq(c, vset('_')));
+}
+#endif
+
+// Returns the first position in [p, end) whose byte is not in the class.
+template <typename VecClass, typename ScalarClass>
+inline const char* scanWhile(const char* p, const char* end, VecClass vcls, ScalarClass scls) {
+#if LEXER_SIMD
+    while (static_cast<size_t>(end - p) >= kVec) {
+        uint32_t miss = ~vmask(vcls(vload(p))) & kFullMask;
+        if (miss) return p + __builtin_ctz(miss);
+        p += kVec;
+    }
+#else
+    (void)vcls;
+#endif
+    while (p < end && scls(static_cast<unsigned char>(*p))) ++p;
+    return p;
+}
+
+// Returns the first position in [p, end) holding a, b or c (or end).
+inline const char* findFirstOf(const char* p, const char* end, char a, char b, char c) {
+#if LEXER_SIMD
+    Vec va = vset(a), vb = vset(b), vc = vset(c);
+    while (static_cast<size_t>(end - p) >= kVec) {
+        Vec v = vload(p);
+        uint32_t hit = vmask(vor(vor(veq(v, va), veq(v, vb)), veq(v, vc)));
+        if (hit) return p + __builtin_ctz(hit);
+        p += kVec;
+    }
+#endif
+    while (p < end && *p != a && *p != b && *p != c) ++p;
+    return p;
+}
+
+#if LEXER_SIMD
+struct VecSpace { Vec operator()(Vec c) const { return vspace(c); } };
+struct VecDigit { Vec operator()(Vec c) const { return vdigit(c); } };
+struct VecIdent { Vec operator()(Vec c) const { return vident(c); } };
+#else
+struct VecSpace { int operator()(int c) const { return c; } };
+using VecDigit = VecSpace;
+using VecIdent = VecSpace;
+#endif
+
+// ---- keywords: perfect hash on (first byte + last byte + 5 * length) & 63 ----
+struct Keyword { const char* text; unsigned char len; Token::Kind kind; };
+
+constexpr unsigned keywordHash(unsigned char first, unsigned char last, size_t len) {
+    return (first + last + 5u * static_cast<unsigned>(len)) & 63u;
+}
+
+struct KeywordTable {
+    Keyword slots[64] = {};
+    constexpr KeywordTable() {
+        const Keyword all[] = {
+            {"int", 3, Token::KwInt}, {"float", 5, Token::KwFloat}, {"return", 6, Token::KwReturn},
+            {"char", 4, Token::KwChar}, {"void", 4, Token::KwVoid}, {"struct", 6, Token::KwStruct},
+            {"typedef", 7, Token::KwTypedef}, {"static", 6, Token::KwStatic}, {"extern", 6, Token::KwExtern},
+            {"sizeof", 6, Token::KwSizeof}, {"if", 2, Token::KwIf}, {"else", 4, Token::KwElse},
+            {"while", 5, Token::KwWhile}, {"for", 3, Token::KwFor}, {"do", 2, Token::KwDo},
+            {"switch", 6, Token::KwSwitch}, {"case", 4, Token::KwCase}, {"default", 7, Token::KwDefault},
+            {"break", 5, Token::KwBreak}, {"continue", 8, Token::KwContinue}, {"goto", 4, Token::KwGoto},
+        };
+        for (const auto& k : all) {
+            slots[keywordHash(static_cast<unsigned char>(k.text[0]), static_cast<unsigned char>(k.text[k.len - 1]), k.len)] = k;
+        }
+    }
+};
+constexpr KeywordTable kKeywords;
+
+inline Token::Kind classifyIdentifier(std::string_view id) {
+    if (id.size() < 2 || id.size() > 8) return Token::Identifier;
+    const Keyword& k = kKeywords.slots[keywordHash(static_cast<unsigned char>(id.front()), static_cast<unsigned char>(id.back()), id.size())];
+    if (k.text && k.len == id.size() && std::memcmp(k.text, id.data(), id.size()) == 0) return k.kind;
+    return Token::Identifier;
+}
+
+const char* kKindNames[] = {
+    "end", "identifier", "number", "int", "return", "+", "-", "*", "/", "(", ")", "{", "}", ";", "=",
+    "float-literal", "string-literal",
+    "float", "char", "void", "struct", "typedef", "static", "extern", "sizeof",
+    "if", "else", "while", "for", "do", "switch", "case", "default", "break", "continue", "goto",
+    "%", "&", "|", "^", "!", "~", "<", ">", "<=", ">=", "==", "!=",
+    "&&", "||", "<<", ">>", "->", ".", ",", ":", "[", "]",
+    "unknown"
+};
+static_assert(sizeof(kKindNames) / sizeof(kKindNames[0]) == Token::Unknown + 1, "token name table out of sync");
+}
+
+const char* tokenKindName(Token::Kind k) { return kKindNames[k]; }
+
+Lexer::Lexer(std::string_view input) : input(input) {}
+
+void Lexer::newlinesIn(size_t from, size_t to) {
+    const char* p = input.data() + from;
+    const char* end = input.data() + to;
+    while ((p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p))))) {
+        ++line;
+        ++p;
+        lineStart = static_cast<size_t>(p - input.data());
+    }
+}
+
+void Lexer::skipTrivia() {
+    const char* base = input.data();
+    const char* end = base + input.size();
+    for (;;) {
+        const char* p = base + index;
+        const char* q = scanWhile(p, end, VecSpace{}, isSpace);
+        if (q != p) newlinesIn(index, static_cast<size_t>(q - base));
+        index = static_cast<size_t>(q - base);
+        if (end - q < 2 || q[0] != '/') return;
+        if (q[1] == '/') {
+            index = static_cast<size_t>(findFirstOf(q + 2, end, '\n', '\n', '\n') - base);
+            continue;
+        }
+        if (q[1] == '*') {
+            const char* s = q + 2;
+            int savedLine = line;
+            size_t savedLineStart = lineStart;
+            bool closed = false;
+            while (!closed) {
+                s = findFirstOf(s, end, '*', '\n', '\n');
+                if (s == end) break;
+                if (*s == '\n') { ++line; lineStart = static_cast<size_t>(++s - base); continue; }
+                if (s + 1 < end && s[1] == '/') closed = true;
+                ++s;
+            }
+            if (!closed) {
+                // unterminated comment: like lexer.l, fall back to '/' and '*' tokens
+                line = savedLine;
+                lineStart = savedLineStart;
+                return;
+            }
+            index = static_cast<size_t>(s + 1 - base);
+            continue;
+        }
+        return;
+    }
+}
+
+Token Lexer::next() {
+    skipTrivia();
+    Token tok;
+    tok.loc.line = line;
+    tok.loc.column = static_cast<int>(index - lineStart) + 1;
+    const char* base = input.data();
+    const char* end = base + input.size();
+    const char* p = base + index;
+    if (p == end) { tok.kind = Token::End; tok.lexeme = input.substr(index, 0); return tok; }
+
+    auto finish = [&](Token::Kind k, const char* stop) {
+        tok.kind = k;
+        tok.lexeme = std::string_view(p, static_cast<size_t>(stop - p));
+        index = static_cast<size_t>(stop - base);
+        return tok;
+    };
+
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (isIdentStart(c)) {
+        const char* q = scanWhile(p + 1, end, VecIdent{}, isIdentChar);
+        Token::Kind k = classifyIdentifier(std::string_view(p, static_cast<size_t>(q - p)));
+        return finish(k, q);
+    }
+    if (isDigit(c) || (c == '.' && p + 1 < end && isDigit(static_cast<unsigned char>(p[1])))) {
+        const char* q = scanWhile(p, end, VecDigit{}, isDigit);
+        bool isFloat = false;
+        if (q < end && *q == '.') {
+            isFloat = true;
+            q = scanWhile(q + 1, end, VecDigit{}, isDigit);
+        }
+        if (isFloat && q < end && (*q == 'e' || *q == 'E')) {
+            const char* e = q + 1;
+            if (e < end && (*e == '+' || *e == '-')) ++e;
+            if (e < end && isDigit(static_cast<unsigned char>(*e))) q = scanWhile(e, end, VecDigit{}, isDigit);
+        }
+        if (isFloat) return finish(Token::FloatLiteral, q);
+        // saturates like the strtol of lexer.l
+        long v = 0;
+        if (std::from_chars(p, q, v).ec == std::errc::result_out_of_range) v = LONG_MAX;
+        tok.intValue = v;
+        return finish(Token::Number, q);
+    }
+    if (c == '"') {
+        // "([^\\\n]|\\.)*" ; the lexeme drops the quotes
+        const char* q = p + 1;
+        for (;;) {
+            q = findFirstOf(q, end, '"', '\\', '\n');
+            if (q == end || *q == '\n') { q = nullptr; break; }
+            if (*q == '"') break;
+            if (q + 1 >= end || q[1] == '\n') { q = nullptr; break; }
+            q += 2;
+        }
+        if (q) {
+            tok.kind = Token::StringLiteral;
+            tok.lexeme = std::string_view(p + 1, static_cast<size_t>(q - p - 1));
+            index = static_cast<size_t>(q + 1 - base);
+            return tok;
+        }
+        return finish(Token::Unknown, p + 1);
+    }
+    if (c == '\'') {
+        // '([^\\\n]|\\.)' -> Number holding the character code
+        if (end - p >= 3 && p[1] != '\\' && p[1] != '\n' && p[2] == '\'') {
+            tok.intValue = static_cast<unsigned char>(p[1]);
+            return finish(Token::Number, p + 3);
+        }
+        if (end - p >= 4 && p[1] == '\\' && p[2] != '\n' && p[3] == '\'') {
+            char e = p[2];
+            tok.intValue = e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e == '0' ? 0 : static_cast<unsigned char>(e);
+            return finish(Token::Number, p + 4);
+        }
+        return finish(Token::Unknown, p + 1);
+    }
+
+    char n = (p + 1 < end) ? p[1] : '\0';
+    switch (c) {
+        case '=': return n == '=' ? finish(Token::EqEq, p + 2) : finish(Token::Assign, p + 1);
+        case '!': return n == '=' ? finish(Token::NotEq, p + 2) : finish(Token::Bang, p + 1);
+        case '<': return n == '=' ? finish(Token::LessEq, p + 2) : n == '<' ? finish(Token::Shl, p + 2) : finish(Token::Less, p + 1);
+        case '>': return n == '=' ? finish(Token::GreaterEq, p + 2) : n == '>' ? finish(Token::Shr, p + 2) : finish(Token::Greater, p + 1);
+        case '&': return n == '&' ? finish(Token::AndAnd, p + 2) : finish(Token::Amp, p + 1);
+        case '|': return n == '|' ? finish(Token::OrOr, p + 2) : finish(Token::Pipe, p + 1);
+        case '-': return n == '>' ? finish(Token::Arrow, p + 2) : finish(Token::Minus, p + 1);
+        case '+': return finish(Token::Plus, p + 1);
+        case '*': return finish(Token::Star, p + 1);
+        case '/': return finish(Token::Slash, p + 1);
+        case '%': return finish(Token::Percent, p + 1);
+        case '^': return finish(Token::Caret, p + 1);
+        case '~': return finish(Token::Tilde, p + 1);
+        case '.': return finish(Token::Dot, p + 1);
+        case ',': return finish(Token::Comma, p + 1);
+        case ':': return finish(Token::Colon, p + 1);
+        case ';': return finish(Token::Semicolon, p + 1);
+        case '(': return finish(Token::LParen, p + 1);
+        case ')': return finish(Token::RParen, p + 1);
+        case '{': return finish(Token::LBrace, p + 1);
+        case '}': return finish(Token::RBrace, p + 1);
+        case '[': return finish(Token::LBracket, p + 1);
+        case ']': return finish(Token::RBracket, p + 1);
+        default: return finish(Token::Unknown, p + 1);
+    }
+}
@@ -0,0 +1,41 @@
+// yylex() for the bison parser backed by the hand-written Lexer. This is the
+// default scanner; `make LEXER=flex` links the lexer.l DFA instead. Both
+// expose the same yyin/yylineno/yyrestart surface main.cpp and the bench use.
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "lexer.h"
+#include "token_bridge.h"
+
+FILE* yyin = nullptr;
+int yylineno = 1;
+
+namespace {
+std::string g_source;
+std::unique_ptr<Lexer> g_lexer;
+
+void loadInput() {
+    g_source.clear();
+    if (yyin) {
+        char chunk[65536];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof chunk, yyin)) > 0) g_source.append(chunk, n);
+    }
+    g_lexer = std::make_unique<Lexer>(g_source);
+}
+}
+
+void yyrestart(FILE* f) {
+    yyin = f;
+    g_lexer.reset();
+}
+
+int yylex(void) {
+    if (!g_lexer) loadInput();
+    Token tok = g_lexer->next();
+    yylineno = tok.loc.line;
+    yylloc.first_line = yylloc.last_line = tok.loc.line;
+    yylloc.first_column = tok.loc.column;
+    yylloc.last_column = tok.loc.column + static_cast<int>(tok.lexeme.size());
+    return bisonTokenFor(tok, yylval);
+}
@@ -0,0 +1,46 @@
+#include "token_bridge.h"
+#include <cstdlib>
+#include <cstring>
+
+int bisonTokenFor(const Token& tok, YYSTYPE& lval) {
+    switch (tok.kind) {
+        case Token::End: return 0;
+        case Token::Identifier: lval.sval = strndup(tok.lexeme.data(), tok.lexeme.size()); return T_ID;
+        case Token::FloatLiteral: lval.sval = strndup(tok.lexeme.data(), tok.lexeme.size()); return T_FLOATLIT;
+        case Token::StringLiteral: lval.sval = strndup(tok.lexeme.data(), tok.lexeme.size()); return T_STRING;
+        case Token::Number: lval.ival = tok.intValue; return T_NUM;
+        case Token::KwInt: return T_INT;
+        case Token::KwFloat: return T_FLOAT;
+        case Token::KwReturn: return T_RETURN;
+        case Token::KwChar: return T_CHAR;
+        case Token::KwVoid: return T_VOID;
+        case Token::KwStruct: return T_STRUCT;
+        case Token::KwTypedef: return T_TYPEDEF;
+        case Token::KwStatic: return T_STATIC;
+        case Token::KwExtern: return T_EXTERN;
+        case Token::KwSizeof: return T_SIZEOF;
+        case Token::KwIf: return T_IF;
+        case Token::KwElse: return T_ELSE;
+        case Token::KwWhile: return T_WHILE;
+        case Token::KwFor: return T_FOR;
+        case Token::KwDo: return T_DO;
+        case Token::KwSwitch: return T_SWITCH;
+        case Token::KwCase: return T_CASE;
+        case Token::KwDefault: return T_DEFAULT;
+        case Token::KwBreak: return T_BREAK;
+        case Token::KwContinue: return T_CONTINUE;
+        case Token::KwGoto: return T_GOTO;
+        case Token::EqEq: return T_EQ;
+        case Token::NotEq: return T_NE;
+        case Token::LessEq: return T_LE;
+        case Token::GreaterEq: return T_GE;
+        case Token::AndAnd: return T_AND;
+        case Token::OrOr: return T_OR;
+        case Token::Shl: return T_SHL;
+        case Token::Shr: return T_SHR;
+        case Token::Arrow: return T_ARROW;
+        default:
+            // single-character tokens are their own code, as in lexer.l
+            return tok.lexeme.empty() ? 0 : static_cast<char>(tok.lexeme[0]);
+    }
+}
@@ -0,0 +1,471 @@
+#include "parser.h"
+#include <charconv>
+#include <unordered_map>
+#include <unordered_set>
+
+// Registries shared with the bison grammar (defined in parser.y)
+extern std::unordered_set<std::string> g_typedef_ints;
+extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
+extern std::unordered_map<std::string, Type*> g_func_typedefs;
+
+namespace {
+struct BinaryOp { int prec; const char* op; };
+
+// Binding power of each binary operator, loosest first; mirrors the rule
+// nesting logical_or .. multiplicative in parser.y. All are left-associative.
+BinaryOp binaryOp(Token::Kind k) {
+    switch (k) {
+        case Token::OrOr: return {1, "||"};
+        case Token::AndAnd: return {2, "&&"};
+        case Token::Pipe: return {3, "|"};
+        case Token::Caret: return {4, "^"};
+        case Token::Amp: return {5, "&"};
+        case Token::EqEq: return {6, "=="};
+        case Token::NotEq: return {6, "!="};
+        case Token::Less: return {7, "<"};
+        case Token::Greater: return {7, ">"};
+        case Token::LessEq: return {7, "<="};
+        case Token::GreaterEq: return {7, ">="};
+        case Token::Shl: return {8, "<<"};
+        case Token::Shr: return {8, ">>"};
+        case Token::Plus: return {9, "+"};
+        case Token::Minus: return {9, "-"};
+        case Token::Star: return {10, "*"};
+        case Token::Slash: return {10, "/"};
+        case Token::Percent: return {10, "%"};
+        default: return {0, nullptr};
+    }
+}
+
+const char* unaryOp(Token::Kind k) {
+    switch (k) {
+        case Token::Minus: return "-";
+        case Token::Bang: return "!";
+        case Token::Amp: return "&";
+        case Token::Star: return "*";
+        default: return nullptr;
+    }
+}
+
+// Moves scratch[mark..] into out (sized exactly) and pops it off the scratch stack.
+template <typename T>
+void takeScratch(std::vector<std::unique_ptr<T>>& scratch, size_t mark, std::vector<std::unique_ptr<T>>& out) {
+    out.reserve(out.size() + (scratch.size() - mark));
+    for (size_t i = mark; i < scratch.size(); ++i) out.push_back(std::move(scratch[i]));
+    scratch.resize(mark);
+}
+}
+
+void Parser::syntaxError(const char* what) {
+    if (failed) return;
+    failed = true;
+    std::string near = current.kind == Token::End ? "end of input" : "'" + std::string(current.lexeme) + "'";
+    err.report(current.loc, std::string("syntax error: expected ") + what + " before " + near);
+}
+
+bool Parser::expect(Token::Kind k, const char* what) {
+    if (accept(k)) return true;
+    syntaxError(what);
+    return false;
+}
+
+std::string Parser::takeIdentifier(const char* what) {
+    if (current.kind != Token::Identifier) { syntaxError(what); return {}; }
+    std::string name(current.lexeme);
+    advance();
+    return name;
+}
+
+bool Parser::parseTranslationUnit(std::vector<std::unique_ptr<Function>>& out) {
+    return parseTranslationUnit([&](std::unique_ptr<Function> fn) { out.push_back(std::move(fn)); });
+}
+
+bool Parser::parseTranslationUnit(const std::function<void(std::unique_ptr<Function>)>& done) {
+    do {
+        auto fn = parseFunction();
+        if (failed) break;
+        done(std::move(fn));
+    } while (current.kind != Token::End);
+    return !failed;
+}
+
+// function: 'int' ID '(' param_list_opt ')' compound_stmt
+//         | 'extern' 'int' ID '(' param_list_opt ')' ';'
+std::unique_ptr<Function> Parser::parseFunction() {
+    auto fn = std::make_unique<Function>();
+    fn->isExtern = accept(Token::KwExtern);
+    expect(Token::KwInt, "'int' at start of function");
+    fn->name = takeIdentifier("function name");
+    expect(Token::LParen, "'('");
+    if (current.kind != Token::RParen) parseParams(fn->detailedParams);
+    expect(Token::RParen, "')'");
+    if (fn->isExtern) expect(Token::Semicolon, "';'");
+    else fn->bodyBlock = parseBlock();
+    return failed ? nullptr : std::move(fn);
+}
+
+// param_list: (('int' | 'char') ID) separated by ','
+bool Parser::parseParams(std::vector<FunctionParam>& params) {
+    do {
+        FunctionParam p;
+        if (accept(Token::KwInt)) p.type = Type::Int();
+        else if (accept(Token::KwChar)) p.type = Type::Char();
+        else { syntaxError("parameter type"); return false; }
+        p.name = takeIdentifier("parameter name");
+        params.push_back(std::move(p));
+    } while (!failed && accept(Token::Comma));
+    return !failed;
+}
+
+// compound_stmt: '{' stmt* '}' (any number of statements)
+std::unique_ptr<BlockStmt> Parser::parseBlock() {
+    auto blk = std::make_unique<BlockStmt>();
+    if (!expect(Token::LBrace, "'{'")) return blk;
+    parseStmtsUntil(Token::RBrace, Token::RBrace, Token::RBrace, blk->statements);
+    expect(Token::RBrace, "'}'");
+    return blk;
+}
+
+void Parser::parseStmtsUntil(Token::Kind a, Token::Kind b, Token::Kind c, std::vector<std::unique_ptr<Stmt>>& out) {
+    size_t mark = stmtScratch.size();
+    while (!failed && current.kind != a && current.kind != b && current.kind != c && current.kind != Token::End) {
+        auto s = parseStmt();
+        stmtScratch.push_back(std::move(s));
+    }
+    takeScratch(stmtScratch, mark, out);
+}
+
+std::unique_ptr<Stmt> Parser::parseStmt() {
+    switch (current.kind) {
+        case Token::LBrace: return parseBlock();
+        case Token::Semicolon: advance(); return std::make_unique<ExprStmt>(nullptr);
+        case Token::KwIf: return parseIf();
+        case Token::KwWhile: return parseWhile();
+        case Token::KwDo: return parseDoWhile();
+        case Token::KwFor: return parseFor();
+        case Token::KwSwitch: return parseSwitch();
+        case Token::KwInt: case Token::KwChar: case Token::KwStatic: return parseDeclaration();
+        case Token::KwStruct: return parseStruct();
+        case Token::KwTypedef: return parseTypedef();
+        case Token::KwReturn: {
+            advance();
+            auto r = std::make_unique<ReturnStmt>(parseExpression());
+            expect(Token::Semicolon, "';'");
+            return r;
+        }
+        case Token::KwBreak: advance(); expect(Token::Semicolon, "';'"); return std::make_unique<BreakStmt>();
+        case Token::KwContinue: advance(); expect(Token::Semicolon, "';'"); return std::make_unique<ContinueStmt>();
+        case Token::KwGoto: {
+            advance();
+            auto g = std::make_unique<GotoStmt>();
+            g->label = takeIdentifier("label");
+            expect(Token::Semicolon, "';'");
+            return g;
+        }
+        case Token::Identifier:
+            if (peek().kind == Token::Identifier) {
+                // ID ID ';' declares a variable of a typedef'd type; unknown names fall back to int
+                std::string tname(current.lexeme);
+                advance();
+                auto d = std::make_unique<VarDeclStmt>();
+                d->name = takeIdentifier("variable name");
+                auto itf = g_func_typedefs.find(tname);
+                d->type = itf != g_func_typedefs.end() ? Type::PointerTo(itf->second) : Type::Int();
+                expect(Token::Semicolon, "';'");
+                return d;
+            }
+            if (peek().kind == Token::Colon) {
+                // ID ':' stmt becomes { label; stmt } as in parser.y
+                auto blk = std::make_unique<BlockStmt>();
+                auto lab = std::make_unique<LabelStmt>();
+                lab->label = std::string(current.lexeme);
+                advance(); advance();
+                blk->statements.reserve(2);
+                blk->statements.push_back(std::move(lab));
+                blk->statements.push_back(parseStmt());
+                return blk;
+            }
+            [[fallthrough]];
+        default: {
+            auto e = std::make_unique<ExprStmt>(parseExpression());
+            expect(Token::Semicolon, "';'");
+            return e;
+        }
+    }
+}
+
+// ['static'] 'int' ID ';' | 'int' ID '=' expr ';' | 'char' ID ';' | ('int' | 'char') ID '[' NUM ']' ';'
+std::unique_ptr<Stmt> Parser::parseDeclaration() {
+    auto d = std::make_unique<VarDeclStmt>();
+    if (accept(Token::KwStatic)) {
+        d->isStatic = true;
+        expect(Token::KwInt, "'int' after 'static'");
+        d->name = takeIdentifier("variable name");
+        d->type = Type::Int();
+        expect(Token::Semicolon, "';'");
+        return d;
+    }
+    Type* elem = current.kind == Token::KwInt ? Type::Int() : Type::Char();
+    advance();
+    d->name = takeIdentifier("variable name");
+    d->type = elem;
+    if (accept(Token::LBracket)) {
+        if (current.kind != Token::Number) { syntaxError("array length"); return d; }
+        d->type = Type::ArrayOf(elem, static_cast<size_t>(current.intValue));
+        advance();
+        expect(Token::RBracket, "']'");
+    } else if (elem == Type::Int() && accept(Token::Assign)) {
+        d->init = parseExpression();
+    }
+    expect(Token::Semicolon, "';'");
+    return d;
+}
+
+// 'typedef' 'int' ID ';' | 'typedef' ('int' | 'char') '(' '*' ID ')' '(' param_list_opt ')' ';'
+std::unique_ptr<Stmt> Parser::parseTypedef() {
+    advance();
+    Type* ret = nullptr;
+    if (accept(Token::KwInt)) ret = Type::Int();
+    else if (accept(Token::KwChar)) ret = Type::Char();
+    else { syntaxError("'int' or 'char' after 'typedef'"); return nullptr; }
+    if (ret == Type::Int() && current.kind == Token::Identifier) {
+        g_typedef_ints.insert(takeIdentifier("typedef name"));
+    } else {
+        expect(Token::LParen, "'('");
+        expect(Token::Star, "'*'");
+        std::string name = takeIdentifier("typedef name");
+        expect(Token::RParen, "')'");
+        expect(Token::LParen, "'('");
+        std::vector<FunctionParam> params;
+        if (!failed && current.kind != Token::RParen) parseParams(params);
+        expect(Token::RParen, "')'");
+        if (!failed) {
+            std::vector<Type*> pts;
+            pts.reserve(params.size());
+            for (const auto& p : params) pts.push_back(p.type);
+            g_func_typedefs[name] = Type::FunctionOf(ret, pts);
+        }
+    }
+    expect(Token::Semicolon, "';'");
+    return std::make_unique<ExprStmt>(nullptr);
+}
+
+// 'struct' ID ['*'] ID ';' | 'struct' ID '{' (('int' | 'char') ID ';')* '}' ';'
+std::unique_ptr<Stmt> Parser::parseStruct() {
+    advance();
+    std::string sname = takeIdentifier("struct name");
+    if (!accept(Token::LBrace)) {
+        auto d = std::make_unique<VarDeclStmt>();
+        bool pointer = accept(Token::Star);
+        d->name = takeIdentifier("variable name");
+        d->type = Type::StructNamed(sname);
+        if (pointer) d->type = Type::PointerTo(d->type);
+        expect(Token::Semicolon, "';'");
+        return d;
+    }
+    std::vector<std::pair<std::string,std::string>> fields;
+    while (!failed && (current.kind == Token::KwInt || current.kind == Token::KwChar)) {
+        const char* ty = current.kind == Token::KwInt ? "i32" : "i8";
+        advance();
+        fields.emplace_back(takeIdentifier("field name"), ty);
+        expect(Token::Semicolon, "';'");
+    }
+    expect(Token::RBrace, "'}'");
+    expect(Token::Semicolon, "';'");
+    if (!failed) g_struct_field_types[sname] = std::move(fields);
+    return std::make_unique<ExprStmt>(nullptr);
+}
+
+std::unique_ptr<Stmt> Parser::parseIf() {
+    advance();
+    auto node = std::make_unique<IfStmt>();
+    expect(Token::LParen, "'('");
+    node->condition = parseExpression();
+    expect(Token::RParen, "')'");
+    node->thenBranch = parseStmt();
+    // else binds to the nearest if, as bison's default shift does
+    if (!failed && accept(Token::KwElse)) node->elseBranch = parseStmt();
+    return node;
+}
+
+std::unique_ptr<Stmt> Parser::parseWhile() {
+    advance();
+    auto node = std::make_unique<WhileStmt>();
+    expect(Token::LParen, "'('");
+    node->condition = parseExpression();
+    expect(Token::RParen, "')'");
+    node->body = parseStmt();
+    return node;
+}
+
+std::unique_ptr<Stmt> Parser::parseDoWhile() {
+    advance();
+    auto node = std::make_unique<DoWhileStmt>();
+    node->body = parseStmt();
+    expect(Token::KwWhile, "'while'");
+    expect(Token::LParen, "'('");
+    node->condition = parseExpression();
+    expect(Token::RParen, "')'");
+    expect(Token::Semicolon, "';'");
+    return node;
+}
+
+// 'for' '(' opt_expr ';' opt_expr ';' opt_expr ')' stmt
+std::unique_ptr<Stmt> Parser::parseFor() {
+    advance();
+    auto fs = std::make_unique<ForStmt>();
+    expect(Token::LParen, "'('");
+    if (auto init = parseOptExpression(Token::Semicolon)) fs->init = std::make_unique<ExprStmt>(std::move(init));
+    expect(Token::Semicolon, "';'");
+    fs->condition = parseOptExpression(Token::Semicolon);
+    expect(Token::Semicolon, "';'");
+    if (auto iter = parseOptExpression(Token::RParen)) fs->iter = std::make_unique<ExprStmt>(std::move(iter));
+    expect(Token::RParen, "')'");
+    fs->body = parseStmt();
+    return fs;
+}
+
+// 'switch' '(' expr ')' '{' ('case' NUM ':' stmt*)* ['default' ':' stmt*] '}'
+std::unique_ptr<Stmt> Parser::parseSwitch() {
+    advance();
+    auto sw = std::make_unique<SwitchStmt>();
+    expect(Token::LParen, "'('");
+    sw->value = parseExpression();
+    expect(Token::RParen, "')'");
+    expect(Token::LBrace, "'{'");
+    while (!failed && accept(Token::KwCase)) {
+        SwitchCase c;
+        if (current.kind != Token::Number) { syntaxError("case value"); break; }
+        c.value = current.intValue;
+        advance();
+        expect(Token::Colon, "':'");
+        parseStmtsUntil(Token::KwCase, Token::KwDefault, Token::RBrace, c.statements);
+        sw->cases.push_back(std::move(c));
+    }
+    if (!failed && accept(Token::KwDefault)) {
+        expect(Token::Colon, "':'");
+        parseStmtsUntil(Token::RBrace, Token::RBrace, Token::RBrace, sw->defaultBody);
+    }
+    expect(Token::RBrace, "'}'");
+    return sw;
+}
+
+// expr: logical_or ['=' expr] (assignment is right-associative)
+std::unique_ptr<Expr> Parser::parseExpression() {
+    auto lhs = parseBinary(1);
+    if (failed || !accept(Token::Assign)) return lhs;
+    auto rhs = parseExpression();
+    return std::make_unique<AssignExpr>(std::move(lhs), std::move(rhs));
+}
+
+std::unique_ptr<Expr> Parser::parseOptExpression(Token::Kind terminator) {
+    return current.kind == terminator ? nullptr : parseExpression();
+}
+
+std::unique_ptr<Expr> Parser::parseBinary(int minPrec) {
+    auto lhs = parseUnary();
+    while (!failed) {
+        BinaryOp b = binaryOp(current.kind);
+        if (b.prec < minPrec || !b.op) break;
+        advance();
+        auto rhs = parseBinary(b.prec + 1);
+        lhs = std::make_unique<BinaryExpr>(b.op, std::move(lhs), std::move(rhs));
+    }
+    return lhs;
+}
+
+std::unique_ptr<Expr> Parser::parseUnary() {
+    if (const char* op = unaryOp(current.kind)) {
+        advance();
+        return std::make_unique<UnaryExpr>(op, parseUnary());
+    }
+    return parsePostfix();
+}
+
+std::unique_ptr<Expr> Parser::parsePostfix() {
+    SourceLocation start = current.loc;
+    auto e = parsePrimary();
+    while (!failed) {
+        if (accept(Token::LParen)) {
+            auto call = std::make_unique<CallExpr>();
+            call->callee = std::move(e);
+            call->loc = start;
+            if (current.kind != Token::RParen) {
+                size_t mark = exprScratch.size();
+                do {
+                    auto arg = parseExpression();
+                    exprScratch.push_back(std::move(arg));
+                } while (!failed && accept(Token::Comma));
+                takeScratch(exprScratch, mark, call->args);
+            }
+            expect(Token::RParen, "')'");
+            e = std::move(call);
+        } else if (accept(Token::LBracket)) {
+            auto a = std::make_unique<ArrayIndexExpr>();
+            a->base = std::move(e);
+            a->index = parseExpression();
+            expect(Token::RBracket, "']'");
+            e = std::move(a);
+        } else if (accept(Token::Dot)) {
+            auto m = std::make_unique<MemberExpr>();
+            m->base = std::move(e);
+            m->field = takeIdentifier("field name");
+            e = std::move(m);
+        } else if (accept(Token::Arrow)) {
+            auto m = std::make_unique<PtrMemberExpr>();
+            m->base = std::move(e);
+            m->field = takeIdentifier("field name");
+            e = std::move(m);
+        } else {
+            break;
+        }
+    }
+    return e;
+}
+
+std::unique_ptr<Expr> Parser::parsePrimary() {
+    switch (current.kind) {
+        case Token::LParen: {
+            advance();
+            auto e = parseExpression();
+            expect(Token::RParen, "')'");
+            return e;
+        }
+        case Token::Number: {
+            auto n = std::make_unique<NumberExpr>(current.intValue);
+            advance();
+            return n;
+        }
+        case Token::FloatLiteral: {
+            double v = 0;
+            std::from_chars(current.lexeme.data(), current.lexeme.data() + current.lexeme.size(), v);
+            advance();
+            return std::make_unique<FloatLiteralExpr>(v);
+        }
+        case Token::Identifier: {
+            auto v = std::make_unique<VarExpr>(std::string(current.lexeme));
+            advance();
+            return v;
+        }
+        case Token::StringLiteral: {
+            auto s = std::make_unique<StringLiteralExpr>(std::string(current.lexeme));
+            advance();
+            return s;
+        }
+        case Token::KwSizeof: {
+            // sizeof '(' ('int' | 'char' | 'struct' ID | ID) ')'; sema computes the size
+            advance();
+            auto z = std::make_unique<SizeofExpr>();
+            expect(Token::LParen, "'('");
+            if (accept(Token::KwInt)) z->operand = Type::Int();
+            else if (accept(Token::KwChar)) z->operand = Type::Char();
+            else if (accept(Token::KwStruct)) z->operand = Type::StructNamed(takeIdentifier("struct name"));
+            else z->name = takeIdentifier("type or variable name");
+            expect(Token::RParen, "')'");
+            return z;
+        }
+        default:
+            syntaxError("expression");
+            return nullptr;
+    }
+}
@@ -23,6 +23,10 @@ std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>>
 std::unordered_map<std::string, Type*> g_func_typedefs; // name -> function type
 %}
 
+%code requires {
+#include "ast.h"
+}
+
 %union {
   long ival;
   char* sval;
@@ -42,7 +46,8 @@ std::unordered_map<std::string, Type*> g_func_typedefs; // name -> function type
 %token <sval> T_ID
 %token <ival> T_NUM
 %token <sval> T_FLOATLIT
-%token T_EQ T_NE T_LE T_GE T_AND T_OR T_SHL T_SHR T_ARROW T_STRING
+%token T_EQ T_NE T_LE T_GE T_AND T_OR T_SHL T_SHR T_ARROW
+%token <sval> T_STRING
 
 %left T_OR
 %left T_AND
@@ -78,6 +83,18 @@ function
       fn->bodyBlock.reset(static_cast<BlockStmt*>($6));
       g_functions.emplace_back(std::move(fn));
     }
+  | T_EXTERN T_INT T_ID '(' param_list_opt ')' ';'
+    {
+      auto fn = std::make_unique<Function>();
+      fn->name = std::string($3);
+      free($3);
+      if ($5) {
+        for (const auto& p : *$5) fn->detailedParams.push_back(p);
+        delete $5;
+      }
+      fn->isExtern = true;
+      g_functions.emplace_back(std::move(fn));
+    }
   ;
 
 param_list_opt
@@ -234,7 +251,11 @@ declaration
     }
   | T_STRUCT T_ID T_ID ';'
     {
-      auto d = new VarDeclStmt(); d->isStatic = false; d->name = std::string($3); d->type = Type::StructNamed(std::string($2), {}); free($2); free($3); $$ = d;
+      auto d = new VarDeclStmt(); d->isStatic = false; d->name = std::string($3); d->type = Type::StructNamed(std::string($2)); free($2); free($3); $$ = d;
+    }
+  | T_STRUCT T_ID '*' T_ID ';'
+    {
+      auto d = new VarDeclStmt(); d->isStatic = false; d->name = std::string($4); d->type = Type::PointerTo(Type::StructNamed(std::string($2))); free($2); free($4); $$ = d;
     }
   | T_TYPEDEF T_INT T_ID ';'
     {
@@ -406,8 +427,8 @@ unary
   ;
 
 postfix
-  : postfix '(' ')'          { auto c=new CallExpr(); c->callee.reset($1); $$ = c; }
-  | postfix '(' arg_list ')' { auto c=new CallExpr(); c->callee.reset($1); for(auto* e:*$3){ c->args.emplace_back(std::unique_ptr<Expr>(e)); } delete $3; $$=c; }
+  : postfix '(' ')'          { auto c=new CallExpr(); c->callee.reset($1); c->loc = {@1.first_line, @1.first_column}; $$ = c; }
+  | postfix '(' arg_list ')' { auto c=new CallExpr(); c->callee.reset($1); c->loc = {@1.first_line, @1.first_column}; for(auto* e:*$3){ c->args.emplace_back(std::unique_ptr<Expr>(e)); } delete $3; $$=c; }
   | postfix '[' expr ']'     { auto a=new ArrayIndexExpr(); a->base.reset($1); a->index.reset($3); $$=a; }
   | postfix '.' T_ID         { auto m=new MemberExpr(); m->base.reset($1); m->field=std::string($3); free($3); $$=m; }
   | postfix T_ARROW T_ID     { auto m=new PtrMemberExpr(); m->base.reset($1); m->field=std::string($3); free($3); $$=m; }
@@ -425,7 +446,10 @@ primary
   | T_FLOATLIT               { $$ = new FloatLiteralExpr(strtod($1,nullptr)); free($1); }
   | T_ID                     { $$ = new VarExpr(std::string($1)); free($1); }
   | T_STRING                 { $$ = new StringLiteralExpr(std::string($1)); free($1); }
-  | T_SIZEOF '(' T_ID ')'    { $$ = new NumberExpr(4); /* simplistic sizeof int/char default */ }
+  | T_SIZEOF '(' T_INT ')'   { auto z=new SizeofExpr(); z->operand=Type::Int(); $$=z; }
+  | T_SIZEOF '(' T_CHAR ')'  { auto z=new SizeofExpr(); z->operand=Type::Char(); $$=z; }
+  | T_SIZEOF '(' T_STRUCT T_ID ')' { auto z=new SizeofExpr(); z->operand=Type::StructNamed(std::string($4)); free($4); $$=z; }
+  | T_SIZEOF '(' T_ID ')'    { auto z=new SizeofExpr(); z->name=std::string($3); free($3); $$=z; /* variable or typedef, resolved by sema */ }
   ;
 %%
 
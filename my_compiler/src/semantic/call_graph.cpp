@@ -0,0 +1,62 @@
+// Reachability over the call graph of a module, for dead function
+// elimination. Edges are found before names are resolved: a function is
+// linked to every function whose name appears anywhere in its body, called
+// or only named (taken as a function pointer). A local that shadows a
+// function's name just adds an edge that is not there, which is harmless.
+#include "semantic.h"
+#include "ast_walk.h"
+#include "lexer.h"
+#include <unordered_map>
+
+void markReachableFunctions(const std::vector<std::unique_ptr<Function>>& fns) {
+    std::unordered_map<std::string_view, std::vector<Function*>> byName; // definitions and extern declarations
+    std::vector<Function*> work;
+    for (const auto& fn : fns) {
+        byName[fn->name].push_back(fn.get());
+        fn->reachable = false;
+    }
+    // a unit without main is a library: anything in it may be called
+    for (const auto& fn : fns)
+        if (fn->name == "main" || !byName.count("main")) { fn->reachable = true; work.push_back(fn.get()); }
+    while (!work.empty()) {
+        Function* fn = work.back();
+        work.pop_back();
+        forEachExpr(*fn, [&](const Expr* e) {
+            auto v = dynamic_cast<const VarExpr*>(e);
+            auto it = v ? byName.find(v->name) : byName.end();
+            if (it == byName.end()) return;
+            for (Function* callee : it->second)
+                if (!callee->reachable) { callee->reachable = true; work.push_back(callee); }
+        });
+    }
+}
+
+std::unordered_set<std::string> scanReachableFunctions(const std::vector<std::string>& sources) {
+    std::unordered_map<std::string_view, std::vector<std::string_view>> mentions; // function -> identifiers in its body
+    for (const auto& source : sources) {
+        Lexer lex(source);
+        int braces = 0, parens = 0;
+        Token::Kind prev = Token::End;
+        std::vector<std::string_view>* body = nullptr;
+        for (Token t = lex.next(); t.kind != Token::End; prev = t.kind, t = lex.next()) {
+            if (t.kind == Token::LBrace) ++braces;
+            else if (t.kind == Token::RBrace) --braces;
+            else if (braces == 0 && t.kind == Token::LParen) ++parens;
+            else if (braces == 0 && t.kind == Token::RParen) --parens;
+            else if (t.kind != Token::Identifier) continue;
+            else if (braces > 0 && body) body->push_back(t.lexeme);
+            else if (braces == 0 && parens == 0 && prev == Token::KwInt) body = &mentions[t.lexeme];
+        }
+    }
+    std::unordered_set<std::string> reachable;
+    std::vector<std::string_view> work;
+    for (const auto& [name, ids] : mentions)
+        if (name == "main" || !mentions.count("main")) { reachable.emplace(name); work.push_back(name); }
+    while (!work.empty()) {
+        auto it = mentions.find(work.back());
+        work.pop_back();
+        for (std::string_view id : it->second)
+            if (mentions.count(id) && reachable.emplace(id).second) work.push_back(id);
+    }
+    return reachable;
+}
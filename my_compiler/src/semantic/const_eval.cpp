@@ -0,0 +1,481 @@
+// Compile-time evaluation of calls to pure functions (see semantic.h). The
+// interpreter follows what the IR generator emits rather than C where the
+// two part: && and || evaluate both operands, a switch's default comes
+// after its cases, and int arithmetic wraps at 32 bits. Where the emitted
+// code does something C does not define (continue in a switch, overflowing
+// a shift) the function is impure or the call is given up, so a folded
+// value is always the one the program computes.
+#include "semantic.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr long kMaxSteps = 1000000;  // statements and expressions per folded call
+constexpr size_t kMaxCells = 1 << 16; // ints and chars live at once
+constexpr int kMaxDepth = 256;        // nested calls
+
+bool integer(const Type* t) { return t && (t->kind == TypeKind::Int || t->kind == TypeKind::Char); }
+
+// Arrays of arrays included; anything else takes a pointer to use.
+bool storable(const Type* t) { return integer(t) || (t && t->kind == TypeKind::Array && storable(t->element)); }
+
+size_t cells(const Type* t) { return t->kind == TypeKind::Array ? t->arrayLength * cells(t->element) : 1; }
+
+bool pureConv(const Expr* e) {
+    return e->conv == ImplicitConv::None || e->conv == ImplicitConv::CharToInt || e->conv == ImplicitConv::IntToChar;
+}
+
+// Which statement a break or continue leaves: a switch has no continue target.
+enum class Enclosing { None, Loop, Switch };
+
+bool pureExpr(const Expr* e, std::vector<const Function*>& callees, bool arrayBase = false) {
+    if (!e || !e->type || !pureConv(e)) return false;
+    if (!integer(e->valueType()) && !(arrayBase && e->type->kind == TypeKind::Array && storable(e->type))) return false;
+    if (dynamic_cast<const NumberExpr*>(e) || dynamic_cast<const SizeofExpr*>(e)) return true;
+    if (auto v = dynamic_cast<const VarExpr*>(e)) return v->slot >= 0;
+    if (auto u = dynamic_cast<const UnaryExpr*>(e)) return (u->op == "-" || u->op == "!") && pureExpr(u->operand.get(), callees);
+    if (auto b = dynamic_cast<const BinaryExpr*>(e)) return pureExpr(b->lhs.get(), callees) && pureExpr(b->rhs.get(), callees);
+    if (auto a = dynamic_cast<const AssignExpr*>(e)) return pureExpr(a->target.get(), callees) && pureExpr(a->value.get(), callees);
+    if (auto x = dynamic_cast<const ArrayIndexExpr*>(e))
+        return pureExpr(x->base.get(), callees, true) && pureExpr(x->index.get(), callees);
+    if (auto c = dynamic_cast<const CallExpr*>(e)) {
+        if (!c->target || c->target->isExtern) return false;
+        callees.push_back(c->target);
+        for (const auto& a : c->args)
+            if (!pureExpr(a.get(), callees)) return false;
+        return true;
+    }
+    return false;
+}
+
+bool pureStmt(const Stmt* s, Enclosing in, std::vector<const Function*>& callees) {
+    if (!s) return true;
+    auto expr = [&](const std::unique_ptr<Expr>& e) { return !e || pureExpr(e.get(), callees); };
+    if (auto r = dynamic_cast<const ReturnStmt*>(s)) return r->value && pureExpr(r->value.get(), callees);
+    if (auto e = dynamic_cast<const ExprStmt*>(s)) return expr(e->expr);
+    if (auto d = dynamic_cast<const VarDeclStmt*>(s))
+        return !d->isStatic && d->slot >= 0 && storable(d->type) && (!d->init || (integer(d->type) && expr(d->init)));
+    if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+        for (const auto& st : b->statements)
+            if (!pureStmt(st.get(), in, callees)) return false;
+        return true;
+    }
+    if (auto i = dynamic_cast<const IfStmt*>(s))
+        return expr(i->condition) && pureStmt(i->thenBranch.get(), in, callees) && pureStmt(i->elseBranch.get(), in, callees);
+    if (auto w = dynamic_cast<const WhileStmt*>(s)) return expr(w->condition) && pureStmt(w->body.get(), Enclosing::Loop, callees);
+    if (auto dw = dynamic_cast<const DoWhileStmt*>(s)) return pureStmt(dw->body.get(), Enclosing::Loop, callees) && expr(dw->condition);
+    if (auto f = dynamic_cast<const ForStmt*>(s))
+        return pureStmt(f->init.get(), in, callees) && expr(f->condition) && pureStmt(f->iter.get(), in, callees)
+            && pureStmt(f->body.get(), Enclosing::Loop, callees);
+    if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+        if (!expr(sw->value)) return false;
+        for (const auto& c : sw->cases)
+            for (const auto& st : c.statements)
+                if (!pureStmt(st.get(), Enclosing::Switch, callees)) return false;
+        for (const auto& st : sw->defaultBody)
+            if (!pureStmt(st.get(), Enclosing::Switch, callees)) return false;
+        return true;
+    }
+    if (dynamic_cast<const BreakStmt*>(s)) return in == Enclosing::Loop || in == Enclosing::Switch;
+    if (dynamic_cast<const ContinueStmt*>(s)) return in == Enclosing::Loop;
+    return false; // goto and labels
+}
+
+// True if `fn` itself qualifies; its direct callees go to `callees`.
+bool pureBody(const Function& fn, std::vector<const Function*>& callees) {
+    if (fn.isExtern || !fn.bodyBlock || !fn.body.empty() || fn.returnType != Type::Int()) return false;
+    for (const auto& p : fn.detailedParams)
+        if (!integer(p.type)) return false;
+    for (const auto& slot : fn.slots)
+        if (slot.isStatic || !storable(slot.type)) return false;
+    return pureStmt(fn.bodyBlock.get(), Enclosing::None, callees);
+}
+
+// No variables, assignments or calls: the same value wherever it is.
+bool constantExpr(const Expr* e) {
+    if (dynamic_cast<const NumberExpr*>(e) || dynamic_cast<const SizeofExpr*>(e)) return true;
+    if (auto u = dynamic_cast<const UnaryExpr*>(e)) return (u->op == "-" || u->op == "!") && constantExpr(u->operand.get());
+    if (auto b = dynamic_cast<const BinaryExpr*>(e)) return constantExpr(b->lhs.get()) && constantExpr(b->rhs.get());
+    return false;
+}
+
+using CallKey = std::pair<const Function*, std::vector<long>>;
+
+enum class Flow { Next, Break, Continue, Return, Fail };
+
+// One evaluation of a call, with its own step budget. Locals live in one
+// array of cells, a call's slots side by side above its caller's.
+class Interpreter {
+public:
+    explicit Interpreter(std::map<CallKey, long>& cache) : cache(cache) {}
+
+    bool call(const Function* fn, const std::vector<long>& args, long& result) {
+        CallKey key{fn, args};
+        if (auto it = cache.find(key); it != cache.end()) { result = it->second; return true; }
+        if (++depth > kMaxDepth) return false;
+        Frame frame{{}, 0};
+        size_t top = mem.size();
+        for (const auto& slot : fn->slots) {
+            frame.offset.push_back(mem.size());
+            mem.resize(mem.size() + cells(slot.type));
+        }
+        if (mem.size() > kMaxCells) return false;
+        set.resize(mem.size(), false);
+        for (size_t i = 0; i < args.size(); ++i) store(frame.offset[static_cast<size_t>(fn->detailedParams[i].slot)], args[i]);
+        Frame* caller = current;
+        current = &frame;
+        bool ok = exec(fn->bodyBlock.get()) == Flow::Return;
+        current = caller;
+        mem.resize(top);
+        set.resize(top);
+        --depth;
+        if (!ok) return false;
+        result = frame.result;
+        cache.emplace(std::move(key), result);
+        return true;
+    }
+
+    // Constant expressions need no frame.
+    bool value(const Expr* e, long& v) { return eval(e, v); }
+
+private:
+    struct Frame {
+        std::vector<size_t> offset; // first cell of each slot
+        long result;
+    };
+
+    std::map<CallKey, long>& cache;
+    std::vector<long> mem;
+    std::vector<bool> set; // written since declared
+    Frame* current = nullptr;
+    long steps = 0;
+    int depth = 0;
+
+    void store(size_t cell, long v) { mem[cell] = v; set[cell] = true; }
+
+    static long wrap(long long v) { return static_cast<int32_t>(static_cast<uint32_t>(v)); }
+
+    static long convert(const Expr* e, long v) {
+        return e->conv == ImplicitConv::IntToChar ? static_cast<int8_t>(static_cast<uint8_t>(v)) : v;
+    }
+
+    bool address(const Expr* e, size_t& cell) {
+        if (auto v = dynamic_cast<const VarExpr*>(e)) {
+            if (!current || v->slot < 0) return false;
+            cell = current->offset[static_cast<size_t>(v->slot)];
+            return true;
+        }
+        auto x = dynamic_cast<const ArrayIndexExpr*>(e);
+        long i;
+        if (!x || !address(x->base.get(), cell) || !eval(x->index.get(), i)) return false;
+        const Type* array = x->base->type;
+        if (i < 0 || static_cast<size_t>(i) >= array->arrayLength) return false;
+        cell += static_cast<size_t>(i) * cells(array->element);
+        return true;
+    }
+
+    bool eval(const Expr* e, long& v) {
+        if (++steps > kMaxSteps) return false;
+        if (!evalRaw(e, v)) return false;
+        v = convert(e, v);
+        return true;
+    }
+
+    bool evalRaw(const Expr* e, long& v) {
+        if (auto n = dynamic_cast<const NumberExpr*>(e)) { v = n->value; return true; }
+        if (auto z = dynamic_cast<const SizeofExpr*>(e)) { v = static_cast<long>(z->size); return true; }
+        if (dynamic_cast<const VarExpr*>(e) || dynamic_cast<const ArrayIndexExpr*>(e)) {
+            size_t cell;
+            if (!address(e, cell) || !set[cell]) return false;
+            v = mem[cell];
+            return true;
+        }
+        if (auto u = dynamic_cast<const UnaryExpr*>(e)) {
+            if (!eval(u->operand.get(), v)) return false;
+            v = u->op == "-" ? wrap(-static_cast<long long>(v)) : v == 0;
+            return true;
+        }
+        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
+            long l, r;
+            if (!eval(b->lhs.get(), l) || !eval(b->rhs.get(), r)) return false;
+            return binary(b->op, l, r, v);
+        }
+        if (auto a = dynamic_cast<const AssignExpr*>(e)) {
+            size_t cell;
+            if (!address(a->target.get(), cell) || !eval(a->value.get(), v)) return false;
+            store(cell, v);
+            return true;
+        }
+        if (auto c = dynamic_cast<const CallExpr*>(e)) {
+            std::vector<long> args(c->args.size());
+            for (size_t i = 0; i < args.size(); ++i)
+                if (!eval(c->args[i].get(), args[i])) return false;
+            return call(c->target, args, v);
+        }
+        return false;
+    }
+
+    static bool binary(const std::string& op, long l, long r, long& v) {
+        long long a = l, b = r;
+        if (op == "+") v = wrap(a + b);
+        else if (op == "-") v = wrap(a - b);
+        else if (op == "*") v = wrap(a * b);
+        else if (op == "/" || op == "%") {
+            if (b == 0 || (a == INT32_MIN && b == -1)) return false;
+            v = op == "/" ? a / b : a % b;
+        }
+        else if (op == "&") v = a & b;
+        else if (op == "|") v = a | b;
+        else if (op == "^") v = a ^ b;
+        else if (op == "<<" || op == ">>") {
+            if (b < 0 || b > 31) return false;
+            v = op == "<<" ? wrap(static_cast<long long>(static_cast<uint32_t>(a) << b)) : a >> b;
+        }
+        else if (op == "<") v = a < b;
+        else if (op == ">") v = a > b;
+        else if (op == "<=") v = a <= b;
+        else if (op == ">=") v = a >= b;
+        else if (op == "==") v = a == b;
+        else if (op == "!=") v = a != b;
+        else if (op == "&&") v = a != 0 && b != 0;
+        else if (op == "||") v = a != 0 || b != 0;
+        else return false;
+        return true;
+    }
+
+    bool condition(const Expr* e, bool& taken) {
+        long v;
+        if (!eval(e, v)) return false;
+        taken = v != 0;
+        return true;
+    }
+
+    Flow exec(const Stmt* s) {
+        if (++steps > kMaxSteps) return Flow::Fail;
+        long v;
+        bool taken;
+        if (auto r = dynamic_cast<const ReturnStmt*>(s)) {
+            if (!eval(r->value.get(), current->result)) return Flow::Fail;
+            return Flow::Return;
+        }
+        if (auto e = dynamic_cast<const ExprStmt*>(s)) return !e->expr || eval(e->expr.get(), v) ? Flow::Next : Flow::Fail;
+        if (auto d = dynamic_cast<const VarDeclStmt*>(s)) {
+            size_t first = current->offset[static_cast<size_t>(d->slot)];
+            for (size_t i = 0; i < cells(d->type); ++i) set[first + i] = false;
+            if (!d->init) return Flow::Next;
+            if (!eval(d->init.get(), v)) return Flow::Fail;
+            store(first, v);
+            return Flow::Next;
+        }
+        if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+            for (const auto& st : b->statements)
+                if (Flow f = exec(st.get()); f != Flow::Next) return f;
+            return Flow::Next;
+        }
+        if (auto i = dynamic_cast<const IfStmt*>(s)) {
+            if (!condition(i->condition.get(), taken)) return Flow::Fail;
+            if (taken) return exec(i->thenBranch.get());
+            return i->elseBranch ? exec(i->elseBranch.get()) : Flow::Next;
+        }
+        if (auto w = dynamic_cast<const WhileStmt*>(s)) {
+            for (;;) {
+                if (!condition(w->condition.get(), taken)) return Flow::Fail;
+                if (!taken) return Flow::Next;
+                Flow f = exec(w->body.get());
+                if (f == Flow::Break) return Flow::Next;
+                if (f == Flow::Return || f == Flow::Fail) return f;
+            }
+        }
+        if (auto dw = dynamic_cast<const DoWhileStmt*>(s)) {
+            for (;;) {
+                Flow f = exec(dw->body.get());
+                if (f == Flow::Break) return Flow::Next;
+                if (f == Flow::Return || f == Flow::Fail) return f;
+                if (!condition(dw->condition.get(), taken)) return Flow::Fail;
+                if (!taken) return Flow::Next;
+            }
+        }
+        if (auto fs = dynamic_cast<const ForStmt*>(s)) {
+            if (fs->init && exec(fs->init.get()) != Flow::Next) return Flow::Fail;
+            for (;;) {
+                if (fs->condition) {
+                    if (!condition(fs->condition.get(), taken)) return Flow::Fail;
+                    if (!taken) return Flow::Next;
+                }
+                Flow f = exec(fs->body.get());
+                if (f == Flow::Break) return Flow::Next;
+                if (f == Flow::Return || f == Flow::Fail) return f;
+                if (fs->iter && exec(fs->iter.get()) != Flow::Next) return Flow::Fail;
+            }
+        }
+        if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+            if (!eval(sw->value.get(), v)) return Flow::Fail;
+            size_t start = 0;
+            while (start < sw->cases.size() && sw->cases[start].value != v) ++start;
+            // the default body follows the last case
+            std::vector<const Stmt*> run;
+            for (size_t c = start; c < sw->cases.size(); ++c)
+                for (const auto& st : sw->cases[c].statements) run.push_back(st.get());
+            for (const auto& st : sw->defaultBody) run.push_back(st.get());
+            for (const Stmt* st : run) {
+                Flow f = exec(st);
+                if (f == Flow::Break) return Flow::Next;
+                if (f != Flow::Next) return f;
+            }
+            return Flow::Next;
+        }
+        if (dynamic_cast<const BreakStmt*>(s)) return Flow::Break;
+        if (dynamic_cast<const ContinueStmt*>(s)) return Flow::Continue;
+        return Flow::Fail;
+    }
+};
+
+// Calls to fold in a function, innermost first: the children of every
+// expression are visited before it, so f(g(1)) sees g(1) folded.
+void forEachCall(std::unique_ptr<Expr>& e, const std::function<void(std::unique_ptr<Expr>&)>& f);
+
+void forEachChild(Expr* e, const std::function<void(std::unique_ptr<Expr>&)>& f) {
+    if (auto x = dynamic_cast<UnaryExpr*>(e)) { forEachCall(x->operand, f); return; }
+    if (auto x = dynamic_cast<BinaryExpr*>(e)) { forEachCall(x->lhs, f); forEachCall(x->rhs, f); return; }
+    if (auto x = dynamic_cast<AssignExpr*>(e)) { forEachCall(x->target, f); forEachCall(x->value, f); return; }
+    if (auto x = dynamic_cast<CallExpr*>(e)) {
+        forEachCall(x->callee, f);
+        for (auto& a : x->args) forEachCall(a, f);
+        return;
+    }
+    if (auto x = dynamic_cast<ArrayIndexExpr*>(e)) { forEachCall(x->base, f); forEachCall(x->index, f); return; }
+    if (auto x = dynamic_cast<MemberExpr*>(e)) { forEachCall(x->base, f); return; }
+    if (auto x = dynamic_cast<PtrMemberExpr*>(e)) { forEachCall(x->base, f); return; }
+}
+
+void forEachCall(std::unique_ptr<Expr>& e, const std::function<void(std::unique_ptr<Expr>&)>& f) {
+    if (!e) return;
+    forEachChild(e.get(), f);
+    if (dynamic_cast<CallExpr*>(e.get())) f(e);
+}
+
+void forEachCall(Stmt* s, const std::function<void(std::unique_ptr<Expr>&)>& f) {
+    if (!s) return;
+    if (auto x = dynamic_cast<ExprStmt*>(s)) { forEachCall(x->expr, f); return; }
+    if (auto x = dynamic_cast<VarDeclStmt*>(s)) { forEachCall(x->init, f); return; }
+    if (auto x = dynamic_cast<ReturnStmt*>(s)) { forEachCall(x->value, f); return; }
+    if (auto x = dynamic_cast<BlockStmt*>(s)) { for (auto& c : x->statements) forEachCall(c.get(), f); return; }
+    if (auto x = dynamic_cast<IfStmt*>(s)) {
+        forEachCall(x->condition, f);
+        forEachCall(x->thenBranch.get(), f);
+        forEachCall(x->elseBranch.get(), f);
+        return;
+    }
+    if (auto x = dynamic_cast<WhileStmt*>(s)) { forEachCall(x->condition, f); forEachCall(x->body.get(), f); return; }
+    if (auto x = dynamic_cast<DoWhileStmt*>(s)) { forEachCall(x->body.get(), f); forEachCall(x->condition, f); return; }
+    if (auto x = dynamic_cast<ForStmt*>(s)) {
+        forEachCall(x->init.get(), f);
+        forEachCall(x->condition, f);
+        forEachCall(x->iter.get(), f);
+        forEachCall(x->body.get(), f);
+        return;
+    }
+    if (auto x = dynamic_cast<SwitchStmt*>(s)) {
+        forEachCall(x->value, f);
+        for (auto& c : x->cases) for (auto& b : c.statements) forEachCall(b.get(), f);
+        for (auto& b : x->defaultBody) forEachCall(b.get(), f);
+    }
+}
+
+} // namespace
+
+struct ConstEvaluator::State {
+    enum class Purity { Pure, Impure, Unknown };
+    std::unordered_set<const Function*> added;
+    std::unordered_map<const Function*, bool> pure;
+    std::map<CallKey, long> cache;
+    std::set<CallKey> failed; // given up once, so not tried again
+    ConstEvalStats stats;
+
+    // Pure when its own body qualifies and every function it reaches
+    // does; in a cycle of calls, each is assumed pure until shown not to be.
+    Purity purity(const Function* fn) {
+        if (auto it = pure.find(fn); it != pure.end()) return it->second ? Purity::Pure : Purity::Impure;
+        struct Local { bool ok = false; std::vector<const Function*> callees; };
+        std::unordered_map<const Function*, Local> local{{fn, Local{}}}; // what it reaches not yet settled
+        std::vector<const Function*> work{fn};
+        while (!work.empty()) {
+            const Function* f = work.back();
+            work.pop_back();
+            if (!added.count(f)) return Purity::Unknown;
+            Local& l = local[f];
+            l.ok = pureBody(*f, l.callees);
+            for (const Function* c : l.callees)
+                if (!pure.count(c) && local.emplace(c, Local{}).second) work.push_back(c);
+        }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto& [f, l] : local) {
+                if (!l.ok) continue;
+                for (const Function* c : l.callees) {
+                    auto it = pure.find(c);
+                    if (it != pure.end() ? it->second : local.find(c)->second.ok) continue;
+                    l.ok = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        for (const auto& [f, l] : local) {
+            pure.emplace(f, l.ok);
+            stats.pure += l.ok;
+        }
+        return pure[fn] ? Purity::Pure : Purity::Impure;
+    }
+};
+
+ConstEvaluator::ConstEvaluator() : state(std::make_unique<State>()) {}
+ConstEvaluator::~ConstEvaluator() = default;
+ConstEvaluator& ConstEvaluator::operator=(ConstEvaluator&&) noexcept = default;
+
+void ConstEvaluator::add(const Function& fn) { state->added.insert(&fn); }
+
+const ConstEvalStats& ConstEvaluator::stats() const { return state->stats; }
+
+bool ConstEvaluator::fold(Function& fn) {
+    MemTagScope tag(MemTag::Sema);
+    State& s = *state;
+    bool settled = true;
+    auto replace = [&](std::unique_ptr<Expr>& e) {
+        auto c = static_cast<CallExpr*>(e.get());
+        if (!c->target || c->target->isExtern) return;
+        for (const auto& a : c->args)
+            if (!constantExpr(a.get())) return;
+        State::Purity p = s.purity(c->target);
+        if (p == State::Purity::Unknown) settled = false;
+        if (p != State::Purity::Pure) return;
+        Interpreter run(s.cache);
+        std::vector<long> args(c->args.size());
+        for (size_t i = 0; i < args.size(); ++i)
+            if (!run.value(c->args[i].get(), args[i])) { ++s.stats.givenUp; return; }
+        CallKey key{c->target, args};
+        if (s.failed.count(key)) { ++s.stats.givenUp; return; }
+        bool cached = s.cache.count(key) != 0;
+        long v;
+        if (!run.call(c->target, args, v)) {
+            s.failed.insert(std::move(key));
+            ++s.stats.givenUp;
+            return;
+        }
+        auto n = std::make_unique<NumberExpr>(v);
+        n->type = Type::Int();
+        n->conv = c->conv;
+        n->convertedType = c->convertedType;
+        e = std::move(n);
+        ++s.stats.folded;
+        s.stats.cached += cached;
+    };
+    forEachCall(fn.bodyBlock.get(), replace);
+    for (auto& st : fn.body) forEachCall(st.get(), replace);
+    return settled;
+}
@@ -1,118 +1,534 @@
 #include "ast.h"
+#include "struct_layout.h"
 #include "symbol_table.h"
 #include "type_system.h"
 #include "error_handler.h"
-#include <unordered_set>
+#include "mem_stats.h"
+#include "semantic.h"
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
+
+extern std::unordered_set<std::string> g_typedef_ints;
+extern std::unordered_map<std::string, Type*> g_func_typedefs;
 
 namespace {
-struct Scope {
-    std::unordered_set<std::string> vars;
-};
+using FunctionTable = std::unordered_map<std::string, const Function*>;
 
 struct Ctx {
-    std::vector<Scope> scopes;
+    SymbolTable* symbols = nullptr; // name -> Function::slots index
     int loopDepth = 0;
     ErrorHandler* err = nullptr;
+    Function* fn = nullptr;
+    const FunctionTable* functions = nullptr;
+    // Set by IncrementalChecker: calls whose callee has not been defined
+    // yet, and a flag for anything only a check of the whole module can do.
+    std::vector<CallExpr*>* pending = nullptr;
+    bool* incomplete = nullptr;
 
-    void push() { scopes.emplace_back(); }
-    void pop() { if (!scopes.empty()) scopes.pop_back(); }
-    bool declare(const std::string& n) { if (scopes.empty()) push(); if (scopes.back().vars.count(n)) return false; scopes.back().vars.insert(n); return true; }
-    bool exists(const std::string& n) const { for (auto it=scopes.rbegin(); it!=scopes.rend(); ++it) if (it->vars.count(n)) return true; return false; }
+    void push() { symbols->pushScope(); }
+    void pop() { symbols->popScope(); }
+    int declare(const std::string& n, Type* t, bool isStatic = false, int paramIndex = -1) {
+        int slot = static_cast<int>(fn->slots.size());
+        if (!symbols->declare(n, SymbolInfo{slot})) return -1;
+        fn->slots.push_back(VarSlot{n, t, isStatic, paramIndex});
+        return slot;
+    }
+    int lookup(const std::string& n) const {
+        const SymbolInfo* s = symbols->lookup(n);
+        return s ? s->slot : -1;
+    }
+    void error(const std::string& msg) { err->report({0,0}, msg); }
 };
 
-void checkExpr(const Expr* e, Ctx& ctx) {
+bool isInteger(const Type* t) { return t && (t->kind == TypeKind::Int || t->kind == TypeKind::Char); }
+bool isArithmetic(const Type* t) { return isInteger(t) || (t && t->kind == TypeKind::Float); }
+bool isPointer(const Type* t) { return t && t->kind == TypeKind::Pointer; }
+bool isScalar(const Type* t) { return isArithmetic(t) || isPointer(t); }
+
+bool sameType(const Type* a, const Type* b) {
+    if (a == b) return true;
+    if (!a || !b || a->kind != b->kind) return false;
+    switch (a->kind) {
+        case TypeKind::Pointer: return sameType(a->element, b->element);
+        case TypeKind::Array: return a->arrayLength == b->arrayLength && sameType(a->element, b->element);
+        case TypeKind::Struct: return a->structName == b->structName;
+        case TypeKind::Function:
+            if (a->params.size() != b->params.size() || !sameType(a->element, b->element)) return false;
+            for (size_t i = 0; i < a->params.size(); ++i) if (!sameType(a->params[i], b->params[i])) return false;
+            return true;
+        default: return true;
+    }
+}
+
+std::string typeName(const Type* t) {
+    if (!t) return "<unknown>";
+    switch (t->kind) {
+        case TypeKind::Int: return "int";
+        case TypeKind::Char: return "char";
+        case TypeKind::Float: return "float";
+        case TypeKind::Void: return "void";
+        case TypeKind::Pointer: return typeName(t->element) + "*";
+        case TypeKind::Array: return typeName(t->element) + "[" + std::to_string(t->arrayLength) + "]";
+        case TypeKind::Struct: return "struct " + t->structName;
+        case TypeKind::Function: return typeName(t->element) + "(*)(...)";
+    }
+    return "<unknown>";
+}
+
+// Type of e once used as an rvalue: arrays decay to a pointer to their element.
+Type* rvalueType(Expr* e) {
+    if (e->type && e->type->kind == TypeKind::Array) {
+        e->conv = ImplicitConv::ArrayToPointer;
+        e->convertedType = Type::PointerTo(e->type->element);
+    }
+    return e->valueType();
+}
+
+// Records the conversion of e's value to `to`; reports when there is none.
+void convertTo(Expr* e, Type* to, Ctx& ctx, const char* what) {
+    if (!e || !e->type || !to) return;
+    Type* from = rvalueType(e);
+    if (sameType(from, to)) return;
+    ImplicitConv c = ImplicitConv::None;
+    if (from->kind == TypeKind::Char && to->kind == TypeKind::Int) c = ImplicitConv::CharToInt;
+    else if (from->kind == TypeKind::Int && to->kind == TypeKind::Char) c = ImplicitConv::IntToChar;
+    else if (isInteger(from) && to->kind == TypeKind::Float) c = ImplicitConv::IntToFloat;
+    else if (from->kind == TypeKind::Float && isInteger(to)) c = ImplicitConv::FloatToInt;
+    else if (isPointer(from) && isPointer(to)) c = ImplicitConv::PointerCast;
+    else if (isInteger(from) && isPointer(to)) c = ImplicitConv::IntToPointer;
+    else if (isPointer(from) && isInteger(to)) c = ImplicitConv::PointerToInt;
+    else {
+        ctx.error(std::string("cannot convert '") + typeName(from) + "' to '" + typeName(to) + "' in " + what);
+        return;
+    }
+    e->conv = c;
+    e->convertedType = to;
+}
+
+// Looks a field up in the struct's layout; sets its index in the emitted
+// struct type and returns its type.
+Type* resolveField(const Type* st, const std::string& field, size_t& index, Ctx& ctx) {
+    if (!st || st->kind != TypeKind::Struct) {
+        ctx.error("member reference base type '" + typeName(st) + "' is not a structure");
+        return nullptr;
+    }
+    if (!st->layout) {
+        ctx.error("member access into incomplete type 'struct " + st->structName + "'");
+        return nullptr;
+    }
+    auto it = st->layout->byName.find(field);
+    if (it == st->layout->byName.end()) {
+        ctx.error("no member named '" + field + "' in 'struct " + st->structName + "'");
+        return nullptr;
+    }
+    const StructField& f = st->layout->fields[it->second];
+    index = f.index;
+    return f.type;
+}
+
+// sizeof(type) or sizeof(name), where name is a variable or a typedef.
+void checkSizeof(SizeofExpr* z, Ctx& ctx) {
+    z->type = Type::Int();
+    const Type* t = z->operand;
+    if (!t) {
+        int slot = ctx.lookup(z->name);
+        if (slot >= 0) t = ctx.fn->slots[static_cast<size_t>(slot)].type;
+        else if (ctx.incomplete) { *ctx.incomplete = true; return; } // the parser may be adding typedefs
+        else if (g_typedef_ints.count(z->name)) t = Type::Int();
+        else if (auto it = g_func_typedefs.find(z->name); it != g_func_typedefs.end()) t = Type::PointerTo(it->second);
+        else { ctx.error("use of undeclared identifier '" + z->name + "' in sizeof"); return; }
+    }
+    if (t->kind == TypeKind::Struct && !t->layout) {
+        ctx.error("invalid application of 'sizeof' to an incomplete type 'struct " + t->structName + "'");
+        return;
+    }
+    z->size = sizeOf(t);
+}
+
+Type* functionType(const Function* f) {
+    std::vector<Type*> params;
+    for (const auto& p : f->detailedParams) params.push_back(p.type);
+    return Type::FunctionOf(f->returnType, params);
+}
+
+void checkExpr(Expr* e, Ctx& ctx);
+
+void checkArgs(CallExpr* c, const std::vector<Type*>& params, const std::string& name, Ctx& ctx) {
+    if (c->args.size() != params.size()) {
+        ctx.error("function '" + name + "' expects " + std::to_string(params.size()) + " arguments, got " + std::to_string(c->args.size()));
+        return;
+    }
+    for (size_t i = 0; i < params.size(); ++i) convertTo(c->args[i].get(), params[i], ctx, "argument");
+}
+
+void bindCall(CallExpr* c, const Function* target, Ctx& ctx) {
+    c->target = target;
+    std::vector<Type*> params;
+    for (const auto& p : target->detailedParams) params.push_back(p.type);
+    checkArgs(c, params, target->name, ctx);
+    c->type = target->returnType;
+}
+
+void checkCall(CallExpr* c, Ctx& ctx) {
+    for (auto& arg : c->args) checkExpr(arg.get(), ctx);
+    c->type = Type::Int();
+    auto* cv = dynamic_cast<VarExpr*>(c->callee.get());
+    if (cv && ctx.lookup(cv->name) < 0) {
+        const std::string& name = cv->name;
+        if (name == "printf" || name == "scanf") {
+            // variadic: default argument promotions
+            if (c->args.empty()) { ctx.error("'" + name + "' requires a format string"); return; }
+            convertTo(c->args[0].get(), Type::PointerTo(Type::Char()), ctx, "format argument");
+            for (size_t i = 1; i < c->args.size(); ++i) {
+                Expr* a = c->args[i].get();
+                if (!a->type) continue;
+                Type* t = rvalueType(a);
+                if (t->kind == TypeKind::Char) convertTo(a, Type::Int(), ctx, "argument");
+            }
+            return;
+        }
+        if (name == "malloc") {
+            checkArgs(c, {Type::Int()}, name, ctx);
+            c->type = Type::PointerTo(Type::Char());
+            return;
+        }
+        if (name == "free") {
+            checkArgs(c, {Type::PointerTo(Type::Char())}, name, ctx);
+            return;
+        }
+        auto it = ctx.functions->find(name);
+        if (ctx.pending && (it == ctx.functions->end() || it->second->isExtern)) {
+            // a definition may still follow; every function returns int,
+            // so only the arguments wait for it
+            ctx.pending->push_back(c);
+            return;
+        }
+        if (it == ctx.functions->end()) { ctx.error("call to undeclared function '" + name + "'"); return; }
+        bindCall(c, it->second, ctx);
+        return;
+    }
+    // call through a function pointer
+    checkExpr(c->callee.get(), ctx);
+    Type* ft = c->callee->type ? rvalueType(c->callee.get()) : nullptr;
+    if (!ft) return;
+    if (!isPointer(ft) || !ft->element || ft->element->kind != TypeKind::Function) {
+        ctx.error("called object of type '" + typeName(ft) + "' is not a function");
+        return;
+    }
+    checkArgs(c, ft->element->params, "(pointer)", ctx);
+    c->type = ft->element->element;
+}
+
+void checkBinary(BinaryExpr* b, Ctx& ctx) {
+    checkExpr(b->lhs.get(), ctx);
+    checkExpr(b->rhs.get(), ctx);
+    Expr* l = b->lhs.get();
+    Expr* r = b->rhs.get();
+    b->type = Type::Int();
+    if (!l->type || !r->type) return;
+    Type* lt = rvalueType(l);
+    Type* rt = rvalueType(r);
+    const std::string& op = b->op;
+    if (op == "&&" || op == "||") {
+        if (!isScalar(lt) || !isScalar(rt)) ctx.error("invalid operands to '" + op + "'");
+        return;
+    }
+    bool cmp = op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=";
+    if (cmp && (isPointer(lt) || isPointer(rt))) {
+        // compare pointers in the left operand's (or the pointer side's) type
+        Type* pt = isPointer(lt) ? lt : rt;
+        convertTo(l, pt, ctx, "comparison");
+        convertTo(r, pt, ctx, "comparison");
+        return;
+    }
+    if ((op == "+" || op == "-") && (isPointer(lt) || isPointer(rt))) {
+        if (isPointer(lt) && isInteger(rt)) { convertTo(r, Type::Int(), ctx, "pointer arithmetic"); b->type = lt; return; }
+        if (op == "+" && isInteger(lt) && isPointer(rt)) { convertTo(l, Type::Int(), ctx, "pointer arithmetic"); b->type = rt; return; }
+        ctx.error("invalid operands to '" + op + "' ('" + typeName(lt) + "' and '" + typeName(rt) + "')");
+        return;
+    }
+    if (!isArithmetic(lt) || !isArithmetic(rt)) {
+        ctx.error("invalid operands to '" + op + "' ('" + typeName(lt) + "' and '" + typeName(rt) + "')");
+        return;
+    }
+    bool intOnly = op == "&" || op == "|" || op == "^" || op == "<<" || op == ">>";
+    Type* common = (lt->kind == TypeKind::Float || rt->kind == TypeKind::Float) ? Type::Float() : Type::Int();
+    if (intOnly && common->kind == TypeKind::Float) { ctx.error("invalid operands to '" + op + "' (float)"); return; }
+    convertTo(l, common, ctx, "binary expression");
+    convertTo(r, common, ctx, "binary expression");
+    if (!cmp) b->type = common;
+}
+
+void checkUnary(UnaryExpr* u, Ctx& ctx) {
+    checkExpr(u->operand.get(), ctx);
+    Expr* o = u->operand.get();
+    u->type = Type::Int();
+    if (!o->type) return;
+    if (u->op == "&") {
+        if (!o->isLValue) { ctx.error("cannot take the address of an rvalue"); return; }
+        u->type = Type::PointerTo(o->type);
+        return;
+    }
+    Type* ot = rvalueType(o);
+    if (u->op == "*") {
+        if (!isPointer(ot)) { ctx.error("indirection requires pointer operand ('" + typeName(ot) + "' invalid)"); return; }
+        u->type = ot->element;
+        u->isLValue = true;
+        return;
+    }
+    if (u->op == "!") {
+        if (!isScalar(ot)) ctx.error("invalid argument type '" + typeName(ot) + "' to unary expression");
+        return;
+    }
+    // "-"
+    if (!isArithmetic(ot)) { ctx.error("invalid argument type '" + typeName(ot) + "' to unary expression"); return; }
+    u->type = ot->kind == TypeKind::Float ? Type::Float() : Type::Int();
+    convertTo(o, u->type, ctx, "unary expression");
+}
+
+void checkExpr(Expr* e, Ctx& ctx) {
     if (!e) return;
-    if (auto v = dynamic_cast<const VarExpr*>(e)) {
-        if (!ctx.exists(v->name)) ctx.err->report({0,0}, "use of undeclared identifier '" + v->name + "'");
-    } else if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
-        checkExpr(b->lhs.get(), ctx);
-        checkExpr(b->rhs.get(), ctx);
-    } else if (auto u = dynamic_cast<const UnaryExpr*>(e)) {
-        checkExpr(u->operand.get(), ctx);
-    } else if (auto a = dynamic_cast<const AssignExpr*>(e)) {
-        if (!dynamic_cast<const VarExpr*>(a->target.get()) && !dynamic_cast<const ArrayIndexExpr*>(a->target.get()) && !dynamic_cast<const MemberExpr*>(a->target.get())) {
-            ctx.err->report({0,0}, "assignment target is not an lvalue");
+    if (dynamic_cast<NumberExpr*>(e)) {
+        e->type = Type::Int();
+    } else if (dynamic_cast<FloatLiteralExpr*>(e)) {
+        e->type = Type::Float();
+    } else if (dynamic_cast<StringLiteralExpr*>(e)) {
+        e->type = Type::PointerTo(Type::Char());
+    } else if (auto z = dynamic_cast<SizeofExpr*>(e)) {
+        checkSizeof(z, ctx);
+    } else if (auto v = dynamic_cast<VarExpr*>(e)) {
+        v->slot = ctx.lookup(v->name);
+        if (v->slot >= 0) {
+            v->type = ctx.fn->slots[static_cast<size_t>(v->slot)].type;
+            v->isLValue = true;
+        } else if (auto it = ctx.functions->find(v->name); it != ctx.functions->end()) {
+            if (ctx.incomplete && it->second->isExtern) *ctx.incomplete = true; // may yet be defined
+            v->function = it->second;
+            v->type = Type::PointerTo(functionType(it->second));
+        } else {
+            ctx.error("use of undeclared identifier '" + v->name + "'");
         }
+    } else if (auto b = dynamic_cast<BinaryExpr*>(e)) {
+        checkBinary(b, ctx);
+    } else if (auto u = dynamic_cast<UnaryExpr*>(e)) {
+        checkUnary(u, ctx);
+    } else if (auto a = dynamic_cast<AssignExpr*>(e)) {
         checkExpr(a->target.get(), ctx);
         checkExpr(a->value.get(), ctx);
-    } else if (auto c = dynamic_cast<const CallExpr*>(e)) {
-        for (auto& arg : c->args) checkExpr(arg.get(), ctx);
-    } else if (auto idx = dynamic_cast<const ArrayIndexExpr*>(e)) {
+        Expr* t = a->target.get();
+        a->type = t->type;
+        if (!t->type) return;
+        if (!t->isLValue || (t->type && t->type->kind == TypeKind::Array)) {
+            ctx.error("assignment target is not an lvalue");
+            return;
+        }
+        convertTo(a->value.get(), t->type, ctx, "assignment");
+    } else if (auto c = dynamic_cast<CallExpr*>(e)) {
+        checkCall(c, ctx);
+    } else if (auto idx = dynamic_cast<ArrayIndexExpr*>(e)) {
         checkExpr(idx->base.get(), ctx);
         checkExpr(idx->index.get(), ctx);
-    } else if (auto m = dynamic_cast<const MemberExpr*>(e)) {
+        Type* bt = idx->base->type;
+        if (!bt || !idx->index->type) return;
+        // arrays are indexed in place; anything else must be a pointer value
+        if (bt->kind != TypeKind::Array) bt = rvalueType(idx->base.get());
+        if (bt->kind != TypeKind::Array && !isPointer(bt)) { ctx.error("subscripted value is not an array or pointer"); return; }
+        if (!isInteger(rvalueType(idx->index.get()))) { ctx.error("array subscript is not an integer"); return; }
+        convertTo(idx->index.get(), Type::Int(), ctx, "array subscript");
+        idx->type = bt->element;
+        idx->isLValue = true;
+    } else if (auto m = dynamic_cast<MemberExpr*>(e)) {
         checkExpr(m->base.get(), ctx);
-    } else if (auto pm = dynamic_cast<const PtrMemberExpr*>(e)) {
+        if (!m->base->type) return;
+        m->type = resolveField(m->base->type, m->field, m->fieldIndex, ctx);
+        m->isLValue = m->type && m->base->isLValue;
+    } else if (auto pm = dynamic_cast<PtrMemberExpr*>(e)) {
         checkExpr(pm->base.get(), ctx);
-    } else if (auto s = dynamic_cast<const StringLiteralExpr*>(e)) {
-        (void)s; // ok
+        if (!pm->base->type) return;
+        Type* bt = rvalueType(pm->base.get());
+        if (!isPointer(bt)) { ctx.error("member reference type '" + typeName(bt) + "' is not a pointer"); return; }
+        pm->type = resolveField(bt->element, pm->field, pm->fieldIndex, ctx);
+        pm->isLValue = pm->type != nullptr;
     }
 }
 
-void checkStmt(const Stmt* s, Ctx& ctx) {
-    if (auto r = dynamic_cast<const ReturnStmt*>(s)) {
+// Conditions only need a scalar; codegen compares against zero in the operand's own type.
+void checkCondition(Expr* e, Ctx& ctx) {
+    checkExpr(e, ctx);
+    if (e && e->type && !isScalar(rvalueType(e))) ctx.error("statement requires expression of scalar type ('" + typeName(e->type) + "' invalid)");
+}
+
+void checkStmt(Stmt* s, Ctx& ctx) {
+    if (auto r = dynamic_cast<ReturnStmt*>(s)) {
         checkExpr(r->value.get(), ctx);
-    } else if (auto e = dynamic_cast<const ExprStmt*>(s)) {
+        convertTo(r->value.get(), ctx.fn->returnType, ctx, "return");
+    } else if (auto e = dynamic_cast<ExprStmt*>(s)) {
         checkExpr(e->expr.get(), ctx);
-    } else if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+    } else if (auto b = dynamic_cast<BlockStmt*>(s)) {
         ctx.push();
         for (const auto& st : b->statements) checkStmt(st.get(), ctx);
         ctx.pop();
-    } else if (auto i = dynamic_cast<const IfStmt*>(s)) {
-        checkExpr(i->condition.get(), ctx);
+    } else if (auto i = dynamic_cast<IfStmt*>(s)) {
+        checkCondition(i->condition.get(), ctx);
         checkStmt(i->thenBranch.get(), ctx);
         if (i->elseBranch) checkStmt(i->elseBranch.get(), ctx);
-    } else if (auto w = dynamic_cast<const WhileStmt*>(s)) {
-        checkExpr(w->condition.get(), ctx);
+    } else if (auto w = dynamic_cast<WhileStmt*>(s)) {
+        checkCondition(w->condition.get(), ctx);
         ctx.loopDepth++; checkStmt(w->body.get(), ctx); ctx.loopDepth--;
-    } else if (auto d = dynamic_cast<const DoWhileStmt*>(s)) {
+    } else if (auto d = dynamic_cast<DoWhileStmt*>(s)) {
         ctx.loopDepth++; checkStmt(d->body.get(), ctx); ctx.loopDepth--;
-        checkExpr(d->condition.get(), ctx);
-    } else if (auto f = dynamic_cast<const ForStmt*>(s)) {
+        checkCondition(d->condition.get(), ctx);
+    } else if (auto f = dynamic_cast<ForStmt*>(s)) {
         ctx.push();
         if (f->init) checkStmt(f->init.get(), ctx);
-        if (f->condition) checkExpr(f->condition.get(), ctx);
+        if (f->condition) checkCondition(f->condition.get(), ctx);
         ctx.loopDepth++; if (f->body) checkStmt(f->body.get(), ctx); ctx.loopDepth--;
         if (f->iter) checkStmt(f->iter.get(), ctx);
         ctx.pop();
-    } else if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+    } else if (auto sw = dynamic_cast<SwitchStmt*>(s)) {
         checkExpr(sw->value.get(), ctx);
+        convertTo(sw->value.get(), Type::Int(), ctx, "switch condition");
         ctx.loopDepth++; // allow break
         for (const auto& c : sw->cases) { for (const auto& st : c.statements) checkStmt(st.get(), ctx); }
         for (const auto& st : sw->defaultBody) checkStmt(st.get(), ctx);
         ctx.loopDepth--;
-    } else if (dynamic_cast<const BreakStmt*>(s) || dynamic_cast<const ContinueStmt*>(s)) {
-        if (ctx.loopDepth <= 0) ctx.err->report({0,0}, "break/continue not in loop");
-    } else if (auto dcl = dynamic_cast<const VarDeclStmt*>(s)) {
-        if (!ctx.declare(dcl->name)) ctx.err->report({0,0}, "redeclaration of '" + dcl->name + "'");
+    } else if (dynamic_cast<BreakStmt*>(s) || dynamic_cast<ContinueStmt*>(s)) {
+        if (ctx.loopDepth <= 0) ctx.error("break/continue not in loop");
+    } else if (auto dcl = dynamic_cast<VarDeclStmt*>(s)) {
+        // the initializer is checked before the name comes into scope
         if (dcl->init) checkExpr(dcl->init.get(), ctx);
+        if (dcl->type && dcl->type->kind == TypeKind::Struct && !dcl->type->layout)
+            ctx.error("variable '" + dcl->name + "' has incomplete type 'struct " + dcl->type->structName + "'");
+        dcl->slot = ctx.declare(dcl->name, dcl->type, dcl->isStatic);
+        if (dcl->slot < 0) ctx.error("redeclaration of '" + dcl->name + "'");
+        if (dcl->init) convertTo(dcl->init.get(), dcl->type, ctx, "initialization");
     }
 }
-}
 
-void semanticCheck(const Function& fn, ErrorHandler& err) {
-    Ctx ctx; ctx.err = &err; ctx.push();
+void checkFunction(Function& fn, const FunctionTable& functions, SymbolTable& symbols, ErrorHandler& err,
+                   std::vector<CallExpr*>* pending = nullptr, bool* incomplete = nullptr) {
+    symbols.clear();
+    Ctx ctx; ctx.symbols = &symbols; ctx.err = &err; ctx.fn = &fn; ctx.functions = &functions; ctx.push();
+    ctx.pending = pending;
+    ctx.incomplete = incomplete;
+    fn.slots.clear();
     // Declare parameters in scope
-    for (const auto& p : fn.detailedParams) ctx.declare(p.name);
+    for (size_t i = 0; i < fn.detailedParams.size(); ++i) {
+        auto& p = fn.detailedParams[i];
+        p.slot = ctx.declare(p.name, p.type, false, static_cast<int>(i));
+    }
     if (fn.bodyBlock) {
         checkStmt(fn.bodyBlock.get(), ctx);
     } else {
         for (const auto& st : fn.body) checkStmt(st.get(), ctx);
     }
 }
+}
 
-// Simple module-level checker scaffold: validates duplicate function names and arity match across calls
-void semanticCheckModule(const std::vector<std::unique_ptr<Function>>& fns, ErrorHandler& err) {
-    std::unordered_map<std::string, const Function*> ftable;
+void semanticCheck(Function& fn, ErrorHandler& err) {
+    FunctionTable functions{{fn.name, &fn}};
+    SymbolTable symbols;
+    layoutStructs(false);
+    checkFunction(fn, functions, symbols, err);
+}
+
+// Module-level checker: struct layouts and duplicate function names, then a
+// typing pass over each function that annotates every expression for the IR generator.
+void semanticCheckModule(const std::vector<std::unique_ptr<Function>>& fns, ErrorHandler& err,
+                         const CompilerOptions& opts) {
+    MemTagScope tag(MemTag::Sema);
+    layoutStructs(opts.reorderStructFields);
+    if (opts.deadFunctions) markReachableFunctions(fns);
+    else for (const auto& fn : fns) fn->reachable = true;
+    // calls bind to the definition when the module has one, else to the
+    // extern declaration
+    FunctionTable ftable;
     for (const auto& fn : fns) {
-        if (ftable.count(fn->name)) {
+        auto [it, fresh] = ftable.emplace(fn->name, fn.get());
+        if (fresh) continue;
+        const Function* other = it->second;
+        if (!fn->isExtern && !other->isExtern) {
             err.report({0,0}, "duplicate function '" + fn->name + "'");
-        } else {
-            ftable[fn->name] = fn.get();
+        } else if (!sameType(functionType(fn.get()), functionType(other))) {
+            err.report({0,0}, "conflicting types for '" + fn->name + "'");
+        } else if (!fn->isExtern) {
+            it->second = fn.get();
+        }
+    }
+    SymbolTable symbols; // reused, so names are interned once per module
+    for (const auto& fn : fns) {
+        if (fn->isExtern || !fn->reachable) continue;
+        MemStats::beginFunction(fn->name);
+        checkFunction(*fn, ftable, symbols, err);
+        MemStats::endFunction();
+    }
+}
+
+struct IncrementalChecker::State {
+    struct Waiting { Function* fn; size_t pending; };
+    struct PendingCall { CallExpr* call; size_t function; }; // index of the caller in arrival order
+    FunctionTable ftable;
+    SymbolTable symbols;
+    ErrorHandler err;
+    bool incomplete = false;
+    std::deque<Waiting> waiting; // checked, not yet released; the first is function number `released`
+    size_t released = 0;
+    std::unordered_map<std::string, std::vector<PendingCall>> calls; // by callee name
+
+    void bind(const PendingCall& p, const Function* target) {
+        Ctx ctx; ctx.err = &err;
+        bindCall(p.call, target, ctx);
+        --waiting[p.function - released].pending;
+    }
+    void release(std::vector<Function*>& ready, bool all) {
+        while (!waiting.empty() && (all || waiting.front().pending == 0)) {
+            ready.push_back(waiting.front().fn);
+            waiting.pop_front();
+            ++released;
         }
-        // per-function checks
-        semanticCheck(*fn, err);
     }
-    // Further checks would require expression traversal with types; stubbed for now
+};
+
+IncrementalChecker::IncrementalChecker() : state(std::make_unique<State>()) {}
+IncrementalChecker::~IncrementalChecker() = default;
+
+void IncrementalChecker::add(Function& fn, std::vector<Function*>& ready) {
+    MemTagScope tag(MemTag::Sema);
+    State& s = *state;
+    auto [it, fresh] = s.ftable.emplace(fn.name, &fn);
+    if (!fresh) {
+        const Function* other = it->second;
+        if ((!fn.isExtern && !other->isExtern) || !sameType(functionType(&fn), functionType(other))) s.incomplete = true;
+        else if (!fn.isExtern) it->second = &fn;
+    }
+    if (!fn.isExtern) {
+        if (auto c = s.calls.find(fn.name); c != s.calls.end()) {
+            for (const auto& p : c->second) s.bind(p, &fn);
+            s.calls.erase(c);
+        }
+    }
+    // one that main cannot reach is only declared, as in semanticCheckModule
+    std::vector<CallExpr*> pending;
+    if (!fn.isExtern && fn.reachable) checkFunction(fn, s.ftable, s.symbols, s.err, &pending, &s.incomplete);
+    size_t index = s.released + s.waiting.size();
+    for (CallExpr* c : pending)
+        s.calls[static_cast<VarExpr*>(c->callee.get())->name].push_back({c, index});
+    s.waiting.push_back({&fn, pending.size()});
+    s.release(ready, false);
 }
+
+void IncrementalChecker::finish(std::vector<Function*>& ready) {
+    MemTagScope tag(MemTag::Sema);
+    State& s = *state;
+    // what is still pending can only bind to an extern declaration
+    for (const auto& [name, calls] : s.calls) {
+        auto it = s.ftable.find(name);
+        if (it == s.ftable.end()) { s.incomplete = true; continue; }
+        for (const auto& p : calls) s.bind(p, it->second);
+    }
+    s.calls.clear();
+    s.release(ready, true);
+}
+
+bool IncrementalChecker::needsSerialCheck() const { return state->incomplete || state->err.hasErrors(); }
@@ -0,0 +1,91 @@
+#include "struct_layout.h"
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
+
+size_t sizeOf(const Type* t) {
+    if (!t) return 0;
+    switch (t->kind) {
+        case TypeKind::Int: case TypeKind::Float: return 4;
+        case TypeKind::Char: case TypeKind::Void: return 1;
+        case TypeKind::Pointer: return 8;
+        case TypeKind::Array: return t->arrayLength * sizeOf(t->element);
+        case TypeKind::Struct: return t->layout ? t->layout->size : 0;
+        case TypeKind::Function: return 1;
+    }
+    return 0;
+}
+
+size_t alignOf(const Type* t) {
+    if (!t) return 1;
+    switch (t->kind) {
+        case TypeKind::Array: return alignOf(t->element);
+        case TypeKind::Struct: return t->layout ? t->layout->align : 1;
+        default: return std::max<size_t>(1, std::min<size_t>(sizeOf(t), 8));
+    }
+}
+
+namespace {
+StructLayout computeLayout(const std::vector<std::pair<std::string,std::string>>& decl, bool reorderFields) {
+    StructLayout l;
+    l.fields.reserve(decl.size());
+    for (const auto& [name, ir] : decl) {
+        StructField f;
+        f.name = name;
+        f.type = ir == "i8" ? Type::Char() : Type::Int();
+        l.byName.emplace(name, l.fields.size());
+        l.fields.push_back(std::move(f));
+    }
+    for (size_t i = 0; i < l.fields.size(); ++i) l.memoryOrder.push_back(i);
+    if (reorderFields) {
+        std::stable_sort(l.memoryOrder.begin(), l.memoryOrder.end(), [&](size_t a, size_t b) {
+            return alignOf(l.fields[a].type) > alignOf(l.fields[b].type);
+        });
+    }
+    size_t offset = 0, used = 0;
+    for (size_t pos = 0; pos < l.memoryOrder.size(); ++pos) {
+        StructField& f = l.fields[l.memoryOrder[pos]];
+        size_t a = alignOf(f.type);
+        offset = (offset + a - 1) / a * a;
+        f.offset = offset;
+        f.index = pos;
+        offset += sizeOf(f.type);
+        used += sizeOf(f.type);
+        l.align = std::max(l.align, a);
+    }
+    l.size = (offset + l.align - 1) / l.align * l.align;
+    l.padding = l.size - used;
+    return l;
+}
+}
+
+namespace {
+std::deque<StructLayout> layoutPool;
+// the declaration each layout was computed from, for layoutNewStructs
+std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> laidOut;
+}
+
+void layoutStructs(bool reorderFields) {
+    MemTagScope tag(MemTag::Types);
+    laidOut.clear();
+    for (const auto& [name, decl] : g_struct_field_types) {
+        Type* t = Type::StructNamed(name);
+        if (!t->layout) { layoutPool.emplace_back(); t->layout = &layoutPool.back(); }
+        *t->layout = computeLayout(decl, reorderFields);
+    }
+}
+
+bool layoutNewStructs(bool reorderFields) {
+    MemTagScope tag(MemTag::Types);
+    bool unchanged = true;
+    for (const auto& [name, decl] : g_struct_field_types) {
+        auto [it, fresh] = laidOut.try_emplace(name, decl);
+        if (!fresh) { unchanged &= it->second == decl; continue; }
+        Type* t = Type::StructNamed(name);
+        layoutPool.emplace_back(computeLayout(decl, reorderFields));
+        t->layout = &layoutPool.back();
+    }
+    return unchanged;
+}
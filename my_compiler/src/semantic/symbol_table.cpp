@@ -1,25 +1,74 @@
 #include "symbol_table.h"
 
+uint32_t SymbolTable::hashName(std::string_view name) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) { h ^= c; h *= 16777619u; }
+    return h;
+}
+
+size_t SymbolTable::probe(std::string_view name, uint32_t hash) const {
+    size_t mask = entries.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Entry& e = entries[i];
+        if (!e.occupied || (e.hash == hash && e.name == name)) return i;
+    }
+}
+
+void SymbolTable::grow() {
+    std::vector<Entry> old = std::move(entries);
+    entries.assign(old.empty() ? 64 : old.size() * 2, Entry{});
+    std::vector<uint32_t> moved(old.size());
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (!old[i].occupied) continue;
+        size_t j = probe(old[i].name, old[i].hash);
+        moved[i] = static_cast<uint32_t>(j);
+        entries[j] = std::move(old[i]);
+    }
+    for (auto& b : bindings) b.entry = moved[b.entry];
+}
+
 void SymbolTable::pushScope() {
-    scopes.emplace_back();
+    scopeMarks.push_back(bindings.size());
 }
 
 void SymbolTable::popScope() {
-    if (!scopes.empty()) scopes.pop_back();
+    if (scopeMarks.empty()) return;
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    while (bindings.size() > mark) {
+        const Binding& b = bindings.back();
+        entries[b.entry].binding = b.shadowed;
+        bindings.pop_back();
+    }
 }
 
-bool SymbolTable::declare(const std::string& name, const SymbolInfo& info) {
-    if (scopes.empty()) scopes.emplace_back();
-    auto& top = scopes.back();
-    if (top.count(name)) return false;
-    top[name] = info;
+bool SymbolTable::declare(std::string_view name, const SymbolInfo& info) {
+    if (scopeMarks.empty()) pushScope();
+    if ((occupiedEntries + 1) * 2 > entries.size()) grow();
+    uint32_t h = hashName(name);
+    size_t i = probe(name, h);
+    Entry& e = entries[i];
+    if (!e.occupied) {
+        e.name.assign(name);
+        e.hash = h;
+        e.occupied = true;
+        ++occupiedEntries;
+    } else if (e.binding >= 0 && bindings[static_cast<size_t>(e.binding)].depth == scopeMarks.size()) {
+        return false;
+    }
+    bindings.push_back(Binding{info, static_cast<uint32_t>(i), e.binding, static_cast<uint32_t>(scopeMarks.size())});
+    e.binding = static_cast<int>(bindings.size() - 1);
     return true;
 }
 
-const SymbolInfo* SymbolTable::lookup(const std::string& name) const {
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-        auto found = it->find(name);
-        if (found != it->end()) return &found->second;
-    }
-    return nullptr;
+const SymbolInfo* SymbolTable::lookup(std::string_view name) const {
+    if (entries.empty()) return nullptr;
+    const Entry& e = entries[probe(name, hashName(name))];
+    if (!e.occupied || e.binding < 0) return nullptr;
+    return &bindings[static_cast<size_t>(e.binding)].info;
+}
+
+void SymbolTable::clear() {
+    while (!scopeMarks.empty()) popScope();
 }
@@ -0,0 +1,59 @@
+#include "ast_walk.h"
+
+namespace {
+
+// Direct children of a statement, in source order.
+void children(const Stmt* s, const std::function<void(const Stmt*)>& stmt, const std::function<void(const Expr*)>& expr) {
+    auto e = [&](const std::unique_ptr<Expr>& x) { if (x) expr(x.get()); };
+    auto st = [&](const std::unique_ptr<Stmt>& x) { if (x) stmt(x.get()); };
+    if (auto x = dynamic_cast<const ExprStmt*>(s)) { e(x->expr); return; }
+    if (auto x = dynamic_cast<const VarDeclStmt*>(s)) { e(x->init); return; }
+    if (auto x = dynamic_cast<const ReturnStmt*>(s)) { e(x->value); return; }
+    if (auto x = dynamic_cast<const BlockStmt*>(s)) { for (const auto& c : x->statements) st(c); return; }
+    if (auto x = dynamic_cast<const IfStmt*>(s)) { e(x->condition); st(x->thenBranch); st(x->elseBranch); return; }
+    if (auto x = dynamic_cast<const WhileStmt*>(s)) { e(x->condition); st(x->body); return; }
+    if (auto x = dynamic_cast<const DoWhileStmt*>(s)) { st(x->body); e(x->condition); return; }
+    if (auto x = dynamic_cast<const ForStmt*>(s)) { st(x->init); e(x->condition); st(x->iter); st(x->body); return; }
+    if (auto x = dynamic_cast<const SwitchStmt*>(s)) {
+        e(x->value);
+        for (const auto& c : x->cases) for (const auto& b : c.statements) st(b);
+        for (const auto& b : x->defaultBody) st(b);
+    }
+}
+
+} // namespace
+
+void forEachStmt(const Stmt* s, const std::function<void(const Stmt*)>& f) {
+    if (!s) return;
+    f(s);
+    children(s, [&](const Stmt* c) { forEachStmt(c, f); }, [](const Expr*) {});
+}
+
+void forEachStmt(const Function& fn, const std::function<void(const Stmt*)>& f) {
+    if (fn.bodyBlock) forEachStmt(fn.bodyBlock.get(), f);
+    for (const auto& s : fn.body) forEachStmt(s.get(), f);
+}
+
+void forEachExpr(const Expr* e, const std::function<void(const Expr*)>& f) {
+    if (!e) return;
+    f(e);
+    if (auto x = dynamic_cast<const UnaryExpr*>(e)) { forEachExpr(x->operand.get(), f); return; }
+    if (auto x = dynamic_cast<const BinaryExpr*>(e)) { forEachExpr(x->lhs.get(), f); forEachExpr(x->rhs.get(), f); return; }
+    if (auto x = dynamic_cast<const AssignExpr*>(e)) { forEachExpr(x->target.get(), f); forEachExpr(x->value.get(), f); return; }
+    if (auto x = dynamic_cast<const CallExpr*>(e)) {
+        forEachExpr(x->callee.get(), f);
+        for (const auto& a : x->args) forEachExpr(a.get(), f);
+        return;
+    }
+    if (auto x = dynamic_cast<const ArrayIndexExpr*>(e)) { forEachExpr(x->base.get(), f); forEachExpr(x->index.get(), f); return; }
+    if (auto x = dynamic_cast<const MemberExpr*>(e)) { forEachExpr(x->base.get(), f); return; }
+    if (auto x = dynamic_cast<const PtrMemberExpr*>(e)) { forEachExpr(x->base.get(), f); return; }
+}
+
+void forEachExpr(const Stmt* s, const std::function<void(const Expr*)>& f) {
+    forEachStmt(s, [&](const Stmt* st) { children(st, [](const Stmt*) {}, [&](const Expr* e) { forEachExpr(e, f); }); });
+}
+
+void forEachExpr(const Function& fn, const std::function<void(const Expr*)>& f) {
+    forEachStmt(fn, [&](const Stmt* st) { children(st, [](const Stmt*) {}, [&](const Expr* e) { forEachExpr(e, f); }); });
+}
@@ -0,0 +1,192 @@
+#include "mem_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr size_t kTagCount = static_cast<size_t>(MemTag::Count);
+// Header in front of every block: requested size and tag. 16 bytes keeps the
+// payload aligned for max_align_t.
+constexpr size_t kHeader = 16;
+
+const char* kTagNames[kTagCount] = {
+    "other", "parser", "ast", "types", "sema", "function-ctx", "ir-text"
+};
+
+std::atomic<size_t> g_bytes[kTagCount];
+std::atomic<size_t> g_allocs[kTagCount];
+std::atomic<size_t> g_live[kTagCount];
+std::atomic<size_t> g_liveTotal{0};
+std::atomic<size_t> g_peak{0};
+std::atomic<size_t> g_phasePeak{0};
+thread_local MemTag t_tag = MemTag::Other;
+bool g_enabled = false;
+
+void raisePeak(std::atomic<size_t>& peak, size_t live) {
+    size_t cur = peak.load(std::memory_order_relaxed);
+    while (live > cur && !peak.compare_exchange_weak(cur, live, std::memory_order_relaxed)) {}
+}
+
+void* countedAlloc(size_t n) {
+    void* raw = std::malloc(n + kHeader);
+    if (!raw) throw std::bad_alloc();
+    size_t tag = static_cast<size_t>(t_tag);
+    auto* h = static_cast<size_t*>(raw);
+    h[0] = n; h[1] = tag;
+    g_bytes[tag].fetch_add(n, std::memory_order_relaxed);
+    g_allocs[tag].fetch_add(1, std::memory_order_relaxed);
+    g_live[tag].fetch_add(n, std::memory_order_relaxed);
+    size_t live = g_liveTotal.fetch_add(n, std::memory_order_relaxed) + n;
+    raisePeak(g_peak, live);
+    raisePeak(g_phasePeak, live);
+    return static_cast<char*>(raw) + kHeader;
+}
+
+void countedFree(void* p) {
+    if (!p) return;
+    auto* raw = static_cast<char*>(p) - kHeader;
+    auto* h = reinterpret_cast<size_t*>(raw);
+    g_live[h[1]].fetch_sub(h[0], std::memory_order_relaxed);
+    g_liveTotal.fetch_sub(h[0], std::memory_order_relaxed);
+    std::free(raw);
+}
+
+struct Snapshot {
+    size_t bytes[kTagCount] = {};
+    size_t allocs[kTagCount] = {};
+    static Snapshot take() {
+        Snapshot s;
+        for (size_t i = 0; i < kTagCount; ++i) {
+            s.bytes[i] = g_bytes[i].load(std::memory_order_relaxed);
+            s.allocs[i] = g_allocs[i].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+    size_t totalBytes() const { size_t t = 0; for (size_t b : bytes) t += b; return t; }
+    size_t totalAllocs() const { size_t t = 0; for (size_t a : allocs) t += a; return t; }
+};
+
+struct PhaseRecord {
+    std::string name;
+    Snapshot delta;
+    size_t peak = 0;
+    size_t liveAtEnd = 0;
+};
+
+struct FunctionRecord { size_t bytes = 0; size_t allocs = 0; };
+
+struct State {
+    std::vector<PhaseRecord> phases;
+    bool phaseOpen = false;
+    Snapshot phaseStart;
+    std::string curFunction;
+    Snapshot functionStart;
+    std::unordered_map<std::string, FunctionRecord> functions;
+};
+
+State& state() { static State s; return s; }
+}
+
+void* operator new(std::size_t n) { return countedAlloc(n); }
+void* operator new[](std::size_t n) { return countedAlloc(n); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+
+MemTagScope::MemTagScope(MemTag tag) : prev(t_tag) { t_tag = tag; }
+MemTagScope::~MemTagScope() { t_tag = prev; }
+
+void MemStats::enable() { g_enabled = true; }
+bool MemStats::enabled() { return g_enabled; }
+
+void MemStats::beginPhase(const std::string& name) {
+    MemTagScope tag(MemTag::Other);
+    endPhase();
+    auto& st = state();
+    st.phases.push_back(PhaseRecord{name, {}, 0, 0});
+    st.phaseOpen = true;
+    st.phaseStart = Snapshot::take();
+    g_phasePeak.store(g_liveTotal.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemStats::endPhase() {
+    auto& st = state();
+    if (!st.phaseOpen) return;
+    Snapshot now = Snapshot::take();
+    auto& rec = st.phases.back();
+    for (size_t i = 0; i < kTagCount; ++i) {
+        rec.delta.bytes[i] = now.bytes[i] - st.phaseStart.bytes[i];
+        rec.delta.allocs[i] = now.allocs[i] - st.phaseStart.allocs[i];
+    }
+    rec.peak = g_phasePeak.load(std::memory_order_relaxed);
+    rec.liveAtEnd = g_liveTotal.load(std::memory_order_relaxed);
+    st.phaseOpen = false;
+}
+
+void MemStats::beginFunction(const std::string& name) {
+    MemTagScope tag(MemTag::Other);
+    auto& st = state();
+    st.curFunction = name;
+    st.functionStart = Snapshot::take();
+}
+
+void MemStats::endFunction() {
+    auto& st = state();
+    if (st.curFunction.empty()) return;
+    Snapshot now = Snapshot::take();
+    MemTagScope tag(MemTag::Other);
+    auto& rec = st.functions[st.curFunction];
+    rec.bytes += now.totalBytes() - st.functionStart.totalBytes();
+    rec.allocs += now.totalAllocs() - st.functionStart.totalAllocs();
+    st.curFunction.clear();
+}
+
+size_t MemStats::liveBytes() { return g_liveTotal.load(std::memory_order_relaxed); }
+size_t MemStats::peakBytes() { return g_peak.load(std::memory_order_relaxed); }
+
+void MemStats::report(std::ostream& os) {
+    MemTagScope tag(MemTag::Other);
+    endPhase();
+    auto& st = state();
+    os << "=== memory report ===\n";
+    os << "per phase:\n";
+    os << "  " << std::left << std::setw(14) << "phase" << std::right
+       << std::setw(14) << "bytes" << std::setw(10) << "allocs"
+       << std::setw(14) << "peak-live" << std::setw(14) << "live-at-end" << "\n";
+    for (const auto& p : st.phases) {
+        os << "  " << std::left << std::setw(14) << p.name << std::right
+           << std::setw(14) << p.delta.totalBytes() << std::setw(10) << p.delta.totalAllocs()
+           << std::setw(14) << p.peak << std::setw(14) << p.liveAtEnd << "\n";
+        for (size_t i = 0; i < kTagCount; ++i) {
+            if (!p.delta.allocs[i]) continue;
+            os << "    " << std::left << std::setw(12) << kTagNames[i] << std::right
+               << std::setw(14) << p.delta.bytes[i] << std::setw(10) << p.delta.allocs[i] << "\n";
+        }
+    }
+    os << "per subsystem (whole run):\n";
+    os << "  " << std::left << std::setw(14) << "subsystem" << std::right
+       << std::setw(14) << "bytes" << std::setw(10) << "allocs" << std::setw(14) << "live" << "\n";
+    for (size_t i = 0; i < kTagCount; ++i) {
+        os << "  " << std::left << std::setw(14) << kTagNames[i] << std::right
+           << std::setw(14) << g_bytes[i].load() << std::setw(10) << g_allocs[i].load()
+           << std::setw(14) << g_live[i].load() << "\n";
+    }
+    os << "high-water mark: " << peakBytes() << " bytes\n";
+
+    std::vector<std::pair<std::string, FunctionRecord>> fns(st.functions.begin(), st.functions.end());
+    std::sort(fns.begin(), fns.end(), [](const auto& a, const auto& b) {
+        return a.second.bytes != b.second.bytes ? a.second.bytes > b.second.bytes : a.first < b.first;
+    });
+    if (fns.size() > 10) fns.resize(10);
+    os << "largest functions:\n";
+    for (const auto& f : fns) {
+        os << "  " << std::left << std::setw(24) << f.first << std::right
+           << std::setw(14) << f.second.bytes << " bytes" << std::setw(10) << f.second.allocs << " allocs\n";
+    }
+}
@@ -0,0 +1,262 @@
+// Compiler phase benchmark: times lexing, parsing, semantic analysis and IR
+// emission separately over one or more .mc inputs and reports throughput.
+// Results are written as CSV so runs can be diffed against a baseline.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "error_handler.h"
+#include "ir_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parser.tab.hh"
+#include "semantic.h"
+
+extern FILE* yyin;
+extern int yylineno;
+extern std::vector<std::unique_ptr<Function>> g_functions;
+int yylex(void);
+void yyrestart(FILE* f);
+
+namespace {
+size_t countNodes(const Expr* e);
+size_t countNodes(const Stmt* s);
+
+size_t countNodes(const Expr* e) {
+    if (!e) return 0;
+    size_t n = 1;
+    if (auto b = dynamic_cast<const BinaryExpr*>(e)) n += countNodes(b->lhs.get()) + countNodes(b->rhs.get());
+    else if (auto u = dynamic_cast<const UnaryExpr*>(e)) n += countNodes(u->operand.get());
+    else if (auto a = dynamic_cast<const AssignExpr*>(e)) n += countNodes(a->target.get()) + countNodes(a->value.get());
+    else if (auto c = dynamic_cast<const CallExpr*>(e)) {
+        n += countNodes(c->callee.get());
+        for (const auto& arg : c->args) n += countNodes(arg.get());
+    }
+    else if (auto i = dynamic_cast<const ArrayIndexExpr*>(e)) n += countNodes(i->base.get()) + countNodes(i->index.get());
+    else if (auto m = dynamic_cast<const MemberExpr*>(e)) n += countNodes(m->base.get());
+    else if (auto pm = dynamic_cast<const PtrMemberExpr*>(e)) n += countNodes(pm->base.get());
+    return n;
+}
+
+size_t countNodes(const Stmt* s) {
+    if (!s) return 0;
+    size_t n = 1;
+    if (auto r = dynamic_cast<const ReturnStmt*>(s)) n += countNodes(r->value.get());
+    else if (auto e = dynamic_cast<const ExprStmt*>(s)) n += countNodes(e->expr.get());
+    else if (auto b = dynamic_cast<const BlockStmt*>(s)) { for (const auto& st : b->statements) n += countNodes(st.get()); }
+    else if (auto i = dynamic_cast<const IfStmt*>(s)) n += countNodes(i->condition.get()) + countNodes(i->thenBranch.get()) + countNodes(i->elseBranch.get());
+    else if (auto w = dynamic_cast<const WhileStmt*>(s)) n += countNodes(w->condition.get()) + countNodes(w->body.get());
+    else if (auto d = dynamic_cast<const DoWhileStmt*>(s)) n += countNodes(d->body.get()) + countNodes(d->condition.get());
+    else if (auto f = dynamic_cast<const ForStmt*>(s)) n += countNodes(f->init.get()) + countNodes(f->condition.get()) + countNodes(f->iter.get()) + countNodes(f->body.get());
+    else if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+        n += countNodes(sw->value.get());
+        for (const auto& c : sw->cases) for (const auto& st : c.statements) n += countNodes(st.get());
+        for (const auto& st : sw->defaultBody) n += countNodes(st.get());
+    }
+    else if (auto v = dynamic_cast<const VarDeclStmt*>(s)) n += countNodes(v->init.get());
+    return n;
+}
+
+size_t countModuleNodes() {
+    size_t n = 0;
+    for (const auto& fn : g_functions) n += 1 + countNodes(fn->bodyBlock.get());
+    return n;
+}
+
+double timeMs(const std::function<void()>& body) {
+    auto t0 = std::chrono::steady_clock::now();
+    body();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+// Points flex/bison at an in-memory copy of the source.
+FILE* openSource(std::string& src) {
+    FILE* f = fmemopen(src.data(), src.size(), "r");
+    if (!f) { std::perror("fmemopen"); std::exit(1); }
+    yyin = f;
+    yyrestart(f);
+    yylineno = 1;
+    return f;
+}
+
+struct PhaseResult {
+    std::string file;
+    std::string phase;
+    double medianMs = 0;
+    double minMs = 0;
+    size_t lines = 0;
+    size_t nodes = 0;
+    size_t bytes = 0;
+    double linesPerSec() const { return medianMs > 0 ? lines / (medianMs / 1000.0) : 0; }
+    double nodesPerSec() const { return medianMs > 0 ? nodes / (medianMs / 1000.0) : 0; }
+    double mbPerSec() const { return medianMs > 0 ? (bytes / 1048576.0) / (medianMs / 1000.0) : 0; }
+};
+
+bool benchFile(const std::string& path, int iters, std::vector<PhaseResult>& results) {
+    std::ifstream in(path);
+    if (!in) { std::cerr << "error: cannot open input file: " << path << "\n"; return false; }
+    std::ostringstream buf; buf << in.rdbuf();
+    std::string src = buf.str();
+    size_t lines = static_cast<size_t>(std::count(src.begin(), src.end(), '\n'));
+
+    std::map<std::string, std::vector<double>> samples;
+    size_t tokens = 0, nodes = 0;
+    for (int it = 0; it < iters; ++it) {
+        FILE* f = openSource(src);
+        samples["lex"].push_back(timeMs([&] { tokens = 0; while (yylex() != 0) ++tokens; }));
+        std::fclose(f);
+
+        g_functions.clear();
+        f = openSource(src);
+        int status = 0;
+        samples["parse"].push_back(timeMs([&] { status = yyparse(); }));
+        std::fclose(f);
+        if (status != 0) { std::cerr << "error: parse failed: " << path << "\n"; return false; }
+        nodes = countModuleNodes();
+        g_functions.clear();
+
+        ErrorHandler parseErr;
+        bool parsed = false;
+        samples["pratt"].push_back(timeMs([&] {
+            Lexer lex(src);
+            Parser parser(lex, parseErr);
+            parsed = parser.parseTranslationUnit(g_functions);
+        }));
+        if (!parsed) { parseErr.printAll(); return false; }
+
+        ErrorHandler semErr;
+        samples["sema"].push_back(timeMs([&] { semanticCheckModule(g_functions, semErr); }));
+        if (semErr.hasErrors()) { semErr.printAll(); return false; }
+
+        std::string ir;
+        samples["irgen"].push_back(timeMs([&] { IRGenerator gen; ir = gen.generateModuleIR(g_functions); }));
+    }
+    g_functions.clear();
+
+    // Both parsers lex as they go, so "parse" (bison) and "pratt" (the
+    // hand-written Parser) each include a full lexing pass. The total counts
+    // only the parser mycc is built with.
+#if USE_FLEX_BISON
+    const char* skipped = "pratt";
+#else
+    const char* skipped = "parse";
+#endif
+    const char* order[] = {"lex", "parse", "pratt", "sema", "irgen"};
+    double total = 0;
+    for (const char* ph : order) {
+        PhaseResult r;
+        r.file = path; r.phase = ph; r.lines = lines; r.nodes = nodes; r.bytes = src.size();
+        r.medianMs = median(samples[ph]);
+        r.minMs = *std::min_element(samples[ph].begin(), samples[ph].end());
+        if (r.phase != "lex" && r.phase != skipped) total += r.medianMs;
+        results.push_back(r);
+    }
+    PhaseResult t;
+    t.file = path; t.phase = "total"; t.lines = lines; t.nodes = nodes; t.bytes = src.size();
+    t.medianMs = total; t.minMs = total;
+    results.push_back(t);
+    std::cout << path << ": " << lines << " lines, " << src.size() << " bytes, "
+              << tokens << " tokens, " << nodes << " AST nodes\n";
+    return true;
+}
+
+void printTable(const std::vector<PhaseResult>& results) {
+    std::cout << std::left << std::setw(28) << "file" << std::setw(8) << "phase" << std::right
+              << std::setw(12) << "median ms" << std::setw(12) << "min ms"
+              << std::setw(14) << "lines/s" << std::setw(14) << "nodes/s" << std::setw(10) << "MB/s" << "\n";
+    for (const auto& r : results) {
+        std::string name = r.file.size() > 27 ? "..." + r.file.substr(r.file.size() - 24) : r.file;
+        std::cout << std::left << std::setw(28) << name << std::setw(8) << r.phase << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << r.medianMs << std::setw(12) << r.minMs
+                  << std::setprecision(0) << std::setw(14) << r.linesPerSec() << std::setw(14) << r.nodesPerSec()
+                  << std::setprecision(2) << std::setw(10) << r.mbPerSec() << "\n";
+    }
+}
+
+void writeCsv(const std::string& path, const std::vector<PhaseResult>& results) {
+    std::ofstream out(path);
+    out << "file,phase,median_ms,min_ms,lines,nodes,bytes,lines_per_sec,nodes_per_sec,mb_per_sec\n";
+    for (const auto& r : results) {
+        out << r.file << "," << r.phase << "," << r.medianMs << "," << r.minMs << "," << r.lines << ","
+            << r.nodes << "," << r.bytes << "," << r.linesPerSec() << "," << r.nodesPerSec() << "," << r.mbPerSec() << "\n";
+    }
+}
+
+// Compares median times with a previous CSV; returns the number of phases
+// that got slower than the threshold.
+int compareBaseline(const std::string& path, const std::vector<PhaseResult>& results, double threshold) {
+    std::ifstream in(path);
+    if (!in) { std::cerr << "warning: cannot open baseline: " << path << "\n"; return 0; }
+    std::map<std::string, double> base;
+    std::string line;
+    std::getline(in, line); // header
+    while (std::getline(in, line)) {
+        std::stringstream ss(line);
+        std::string file, phase, ms;
+        std::getline(ss, file, ','); std::getline(ss, phase, ','); std::getline(ss, ms, ',');
+        base[file + "|" + phase] = std::atof(ms.c_str());
+    }
+    int regressions = 0;
+    std::cout << "vs baseline " << path << ":\n";
+    for (const auto& r : results) {
+        auto it = base.find(r.file + "|" + r.phase);
+        if (it == base.end() || it->second <= 0) continue;
+        double delta = (r.medianMs - it->second) / it->second * 100.0;
+        bool slow = delta > threshold;
+        regressions += slow;
+        std::cout << "  " << std::left << std::setw(28) << r.file << std::setw(8) << r.phase << std::right
+                  << std::showpos << std::fixed << std::setprecision(1) << std::setw(8) << delta << "%"
+                  << std::noshowpos << (slow ? "  REGRESSION" : "") << "\n";
+    }
+    return regressions;
+}
+
+void usage() {
+    std::cerr << "usage: bench_compiler [--iters N] [--csv out.csv] [--baseline old.csv] [--threshold PCT] file.mc...\n";
+}
+}
+
+int main(int argc, char** argv) {
+    int iters = 5;
+    double threshold = 10.0;
+    std::string csvPath, baselinePath;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iters" && i + 1 < argc) iters = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--csv" && i + 1 < argc) csvPath = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc) baselinePath = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc) threshold = std::atof(argv[++i]);
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 2; }
+        else inputs.push_back(arg);
+    }
+    if (inputs.empty()) { usage(); return 2; }
+
+    std::vector<PhaseResult> results;
+    for (const auto& path : inputs) {
+        if (!benchFile(path, iters, results)) return 1;
+    }
+    printTable(results);
+    if (!csvPath.empty()) {
+        writeCsv(csvPath, results);
+        std::cout << "Wrote results to " << csvPath << "\n";
+    }
+    if (!baselinePath.empty() && compareBaseline(baselinePath, results, threshold) > 0) return 1;
+    return 0;
+}
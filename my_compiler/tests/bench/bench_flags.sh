@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# Usage: bench_flags.sh "<base flags>" "<test flags>" kernel.mc...
+# Compiles each kernel with both sets of mycc flags, builds both through
+# llc -O2, checks that they print the same thing and reports the best-of-3
+# runtimes and their ratio. Anything mycc prints to stderr for the test
+# build (pass statistics) is shown under the kernel.
+set -euo pipefail
+
+MYCC=${MYCC:-./mycc}
+LLC=${LLC:-llc}
+CC=${CC:-cc}
+OUT=${OUT:-outputs/bench/flags}
+mkdir -p "$OUT"
+
+base_flags=$1
+test_flags=$2
+shift 2
+
+best() { # binary output
+  local t best=""
+  for _ in 1 2 3; do
+    t=$( { time "$1" > "$2"; } 2>&1 )
+    if [[ -z $best ]] || awk -v a="$t" -v b="$best" 'BEGIN { exit !(a < b) }'; then best=$t; fi
+  done
+  echo "$best"
+}
+
+status=0
+TIMEFORMAT=%R
+printf '%-10s %10s %10s %8s   (%s vs %s)\n' kernel base_s test_s speedup "${base_flags:-<none>}" "$test_flags"
+for mc in "$@"; do
+  name=$(basename "$mc" .mc)
+  for mode in base test; do
+    flags=$base_flags
+    [[ $mode == test ]] && flags=$test_flags
+    # word splitting of $flags is intended
+    "$MYCC" $flags -o "$OUT/$name.$mode.ll" "$mc" > /dev/null 2> "$OUT/$name.$mode.log"
+    "$LLC" -O2 -relocation-model=pic "$OUT/$name.$mode.ll" -o "$OUT/$name.$mode.s"
+    "$CC" "$OUT/$name.$mode.s" -o "$OUT/$name.$mode"
+  done
+  tb=$(best "$OUT/$name.base" "$OUT/$name.base.out")
+  tt=$(best "$OUT/$name.test" "$OUT/$name.test.out")
+  if ! cmp -s "$OUT/$name.base.out" "$OUT/$name.test.out"; then
+    echo "FAIL $name: output differs"
+    status=1
+    continue
+  fi
+  printf '%-10s %10s %10s %7sx\n' "$name" "$tb" "$tt" "$(awk -v a="$tb" -v b="$tt" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }')"
+  sed 's/^/           /' "$OUT/$name.test.log"
+done
+exit $status
@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+# Profile-guided build of each kernel: compile with -fprofile-generate, run
+# it once to write the profile, recompile with -fprofile-use and compare
+# best-of-RUNS runtimes against the plain build (all through llc -O2). Each
+# time is followed by the spread of its runs, (slowest - best) / best; a
+# speedup smaller than the larger spread is marked as noise.
+set -euo pipefail
+
+MYCC=${MYCC:-./mycc}
+LLC=${LLC:-llc}
+CC=${CC:-cc}
+OUT=${OUT:-outputs/bench/pgo}
+RUNS=${RUNS:-7}
+mkdir -p "$OUT"
+
+build() { # name mode flags...
+  local name=$1 mode=$2; shift 2
+  "$MYCC" "$@" -o "$OUT/$name.$mode.ll" "$mc" > /dev/null
+  "$LLC" -O2 -relocation-model=pic "$OUT/$name.$mode.ll" -o "$OUT/$name.$mode.s"
+  "$CC" "$OUT/$name.$mode.s" -o "$OUT/$name.$mode"
+}
+
+timings() { # binary output: "best spread%" over RUNS runs
+  local times=""
+  for ((i = 0; i < RUNS; i++)); do
+    times+=" $( { time "$1" > "$2"; } 2>&1 )"
+  done
+  echo "$times" | awk '{ lo = hi = $1; for (i = 2; i <= NF; i++) { if ($i < lo) lo = $i; if ($i > hi) hi = $i }
+                         printf "%.3f %.1f", lo, (lo > 0 ? 100 * (hi - lo) / lo : 0) }'
+}
+
+status=0
+TIMEFORMAT=%R
+printf '%-10s %10s %7s %10s %7s %8s   (best of %d)\n' kernel plain_s spread pgo_s spread speedup "$RUNS"
+for mc in "$@"; do
+  name=$(basename "$mc" .mc)
+  prof="$OUT/$name.profdata"
+  build "$name" gen "-fprofile-generate=$prof"
+  "$OUT/$name.gen" > "$OUT/$name.gen.out"
+  build "$name" plain
+  build "$name" pgo "-fprofile-use=$prof"
+  read -r tp sp <<< "$(timings "$OUT/$name.plain" "$OUT/$name.plain.out")"
+  read -r tu su <<< "$(timings "$OUT/$name.pgo" "$OUT/$name.pgo.out")"
+  if ! cmp -s "$OUT/$name.plain.out" "$OUT/$name.pgo.out" || ! cmp -s "$OUT/$name.plain.out" "$OUT/$name.gen.out"; then
+    echo "FAIL $name: output differs between builds"
+    status=1
+    continue
+  fi
+  printf '%-10s %10s %6s%% %10s %6s%% %7sx%s\n' "$name" "$tp" "$sp" "$tu" "$su" \
+    "$(awk -v a="$tp" -v b="$tu" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }')" \
+    "$(awk -v a="$tp" -v b="$tu" -v s="$sp" -v t="$su" 'BEGIN { d = (b > 0 ? 100 * (a / b - 1) : 0); if (d < 0) d = -d; if (d <= (s > t ? s : t)) printf "  noise" }')"
+done
+exit $status
@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+# Usage: bench_pipeline.sh file.mc...
+# Compiles each file serially and with -fpipeline, fails if the two write
+# different IR or messages, and reports the best-of-3 wall times and their
+# ratio. The pipeline only pays off with a core per stage, see pipeline.h.
+set -euo pipefail
+
+MYCC=${MYCC:-./mycc}
+OUT=${OUT:-outputs/bench/pipeline}
+mkdir -p "$OUT"
+
+best() { # output.ll flags...
+  local out=$1 t best=""
+  shift
+  for _ in 1 2 3; do
+    t=$( { time "$MYCC" "$@" -o "$out" > "$out.log" 2>&1; } 2>&1 )
+    if [[ -z $best ]] || awk -v a="$t" -v b="$best" 'BEGIN { exit !(a < b) }'; then best=$t; fi
+  done
+  echo "$best"
+}
+
+TIMEFORMAT=%R
+echo "$(nproc) cores"
+printf '%-28s %10s %10s %8s\n' file serial_s pipeline_s speedup
+for mc in "$@"; do
+  name=$(basename "$mc" .mc)
+  ts=$(best "$OUT/$name.ll" "$mc")
+  tp=$(best "$OUT/$name.pipeline.ll" -fpipeline "$mc")
+  if ! cmp -s "$OUT/$name.ll" "$OUT/$name.pipeline.ll" ||
+     ! diff -q <(sed "s|$OUT/$name.ll||" "$OUT/$name.ll.log") <(sed "s|$OUT/$name.pipeline.ll||" "$OUT/$name.pipeline.ll.log") > /dev/null; then
+    echo "FAIL: $mc: -fpipeline output differs"
+    exit 1
+  fi
+  printf '%-28s %10s %10s %7sx\n' "$name" "$ts" "$tp" "$(awk -v a="$ts" -v b="$tp" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }')"
+done
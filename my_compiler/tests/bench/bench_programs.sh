@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+# Usage: bench_programs.sh program.mc...
+# End-to-end runtime of whole programs. Each one is built through mycc and
+# llc -O2 and, since the programs are also valid C, straight from the same
+# source by $REFCC -O2 (clang, or cc when clang is missing). Both builds
+# must print what <program>.expected holds. mycc gets -fno-const-eval:
+# otherwise it folds calls such as fib(35) in recursion.mc at compile
+# time and there is nothing left to run. Reports the median of $RUNS
+# runs of each build and the mycc/C ratio, and writes them to
+# $OUT/results.csv. With BASELINE=old.csv, a program whose mycc build got
+# more than THRESHOLD percent slower is marked as a regression.
+set -euo pipefail
+
+MYCC=${MYCC:-./mycc}
+LLC=${LLC:-llc}
+CC=${CC:-cc}
+REFCC=${REFCC:-$(command -v clang || command -v "$CC")}
+RUNS=${RUNS:-5}
+THRESHOLD=${THRESHOLD:-10}
+BASELINE=${BASELINE:-}
+OUT=${OUT:-outputs/bench/programs}
+mkdir -p "$OUT"
+
+median() { # binary output
+  local times=()
+  for _ in $(seq "$RUNS"); do
+    times+=( "$( { time "$1" > "$2"; } 2>&1 )" )
+  done
+  printf '%s\n' "${times[@]}" | sort -n | awk '{ t[NR] = $1 } END { print t[int((NR + 1) / 2)] }'
+}
+
+status=0
+TIMEFORMAT=%R
+csv="$OUT/results.csv"
+echo "program,mycc_s,c_s,ratio" > "$csv"
+printf '%-10s %10s %10s %8s   (C: %s -O2, median of %s)\n' program mycc_s c_s ratio "$(basename "$REFCC")" "$RUNS"
+for mc in "$@"; do
+  name=$(basename "$mc" .mc)
+  expected="${mc%.mc}.expected"
+  "$MYCC" -fno-const-eval -o "$OUT/$name.ll" "$mc" > /dev/null
+  "$LLC" -O2 -relocation-model=pic "$OUT/$name.ll" -o "$OUT/$name.s"
+  "$CC" "$OUT/$name.s" -o "$OUT/$name.mycc"
+  "$REFCC" -O2 -w -x c -include stdio.h -include stdlib.h "$mc" -o "$OUT/$name.c"
+  tm=$(median "$OUT/$name.mycc" "$OUT/$name.mycc.out")
+  tc=$(median "$OUT/$name.c" "$OUT/$name.c.out")
+  for build in mycc c; do
+    if ! cmp -s "$expected" "$OUT/$name.$build.out"; then
+      echo "FAIL $name: $build build printed $(head -c 80 "$OUT/$name.$build.out"), expected $(head -c 80 "$expected")"
+      status=1
+    fi
+  done
+  ratio=$(awk -v a="$tm" -v b="$tc" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }')
+  echo "$name,$tm,$tc,$ratio" >> "$csv"
+  note=""
+  if [[ -n $BASELINE && -f $BASELINE ]]; then
+    old=$(awk -F, -v n="$name" '$1 == n { print $2 }' "$BASELINE")
+    if [[ -n $old ]]; then
+      note=$(awk -v a="$tm" -v b="$old" -v t="$THRESHOLD" 'BEGIN {
+        d = (b > 0 ? (a - b) / b * 100 : 0)
+        printf "%+6.1f%% vs baseline%s", d, (d > t ? "  REGRESSION" : "") }')
+      [[ $note == *REGRESSION ]] && status=1
+    fi
+  fi
+  printf '%-10s %10s %10s %7sx   %s\n' "$name" "$tm" "$tc" "$ratio" "$note"
+done
+exit $status
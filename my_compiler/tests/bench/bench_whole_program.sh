@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Usage: bench_whole_program.sh unit.mc...
+# Builds the units the usual way (one mycc + llc -O2 per unit, linked by
+# cc) and as one --whole-program module, checks that both print the same
+# thing and reports the best-of-3 runtimes and their ratio.
+set -euo pipefail
+
+MYCC=${MYCC:-./mycc}
+LLC=${LLC:-llc}
+CC=${CC:-cc}
+OUT=${OUT:-outputs/bench/whole_program}
+mkdir -p "$OUT"
+
+best() { # binary output
+  local t best=""
+  for _ in 1 2 3; do
+    t=$( { time "$1" > "$2"; } 2>&1 )
+    if [[ -z $best ]] || awk -v a="$t" -v b="$best" 'BEGIN { exit !(a < b) }'; then best=$t; fi
+  done
+  echo "$best"
+}
+
+TIMEFORMAT=%R
+objs=()
+for mc in "$@"; do
+  name=$(basename "$mc" .mc)
+  "$MYCC" -o "$OUT/$name.ll" "$mc" > /dev/null
+  "$LLC" -O2 -relocation-model=pic "$OUT/$name.ll" -o "$OUT/$name.s"
+  objs+=("$OUT/$name.s")
+done
+"$CC" "${objs[@]}" -o "$OUT/separate"
+"$MYCC" --whole-program -o "$OUT/whole.ll" "$@" > /dev/null 2> "$OUT/whole.log"
+"$LLC" -O2 -relocation-model=pic "$OUT/whole.ll" -o "$OUT/whole.s"
+"$CC" "$OUT/whole.s" -o "$OUT/whole"
+
+ts=$(best "$OUT/separate" "$OUT/separate.out")
+tw=$(best "$OUT/whole" "$OUT/whole.out")
+if ! cmp -s "$OUT/separate.out" "$OUT/whole.out"; then
+  echo "FAIL: output differs"
+  exit 1
+fi
+printf '%10s %10s %8s\n' separate_s whole_s speedup
+printf '%10s %10s %7sx\n' "$ts" "$tw" "$(awk -v a="$ts" -v b="$tw" 'BEGIN { printf "%.2f", (b > 0 ? a / b : 0) }')"
+cat "$OUT/whole.log"
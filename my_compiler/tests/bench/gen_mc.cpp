@@ -0,0 +1,210 @@
+// Deterministic generator for synthetic .mc programs used by `make bench`.
+// The same options and seed always produce byte-identical output.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+struct GenOptions {
+    int functions = 20;   // number of functions besides main
+    int mainCalls = -1;   // main calls f0..f(N-1) only (they call lower ones); -1 = all
+    int stmts = 30;       // top-level statements per function body
+    int exprDepth = 3;    // maximum expression tree depth
+    int loopDepth = 2;    // maximum loop nesting
+    bool structs = true;  // emit struct definitions and member accesses
+    bool strings = true;  // emit printf calls with string literals
+    int blockLimit = 2;   // max statements per { } (0 = unlimited); bison's compound_stmt takes 2
+    int nestDepth = 0;    // extra chain of nested scopes per function (symbol table stress)
+    int nestLocals = 4;   // locals declared at each nesting level
+    uint64_t seed = 1;
+};
+
+class ProgramGen {
+public:
+    explicit ProgramGen(const GenOptions& o) : opt(o), state(o.seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    std::string program() {
+        std::string out;
+        for (int f = 0; f < opt.functions; ++f) out += function(f);
+        out += mainFunction();
+        return out;
+    }
+
+private:
+    const GenOptions& opt;
+    uint64_t state;
+    int curFunction = 0;
+
+    static constexpr int kLocals = 4;
+    static constexpr int kArrayLen = 16;
+
+    // xorshift64*: small, fast, stable across platforms
+    uint64_t next() {
+        state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+    int pick(int n) { return n <= 0 ? 0 : static_cast<int>(next() % static_cast<uint64_t>(n)); }
+
+    static std::string pad(int indent) { return std::string(static_cast<size_t>(indent) * 2, ' '); }
+    static std::string local(int i) { return "v" + std::to_string(i); }
+    static std::string loopVar(int d) { return "i" + std::to_string(d); }
+
+    // Wraps a statement list into blocks that respect blockLimit by nesting
+    // the tail: { s1 { s2 { s3 } } } when the limit is 2. The tail blocks
+    // keep the outer indentation so file size stays linear in statements.
+    std::string block(const std::vector<std::string>& stmts, int indent) {
+        std::string out = "{\n";
+        size_t limit = opt.blockLimit > 1 ? static_cast<size_t>(opt.blockLimit) : 0;
+        if (limit == 0 || stmts.size() <= limit) {
+            for (const auto& s : stmts) out += pad(indent + 1) + s + "\n";
+        } else {
+            for (size_t i = 0; i + 1 < limit; ++i) out += pad(indent + 1) + stmts[i] + "\n";
+            std::vector<std::string> rest(stmts.begin() + static_cast<long>(limit) - 1, stmts.end());
+            out += pad(indent + 1) + block(rest, indent) + "\n";
+        }
+        out += pad(indent) + "}";
+        return out;
+    }
+
+    std::string leaf(int loopLevel) {
+        switch (pick(loopLevel > 0 ? 6 : 5)) {
+            case 0: return std::to_string(pick(100));
+            case 1: case 2: return local(pick(kLocals));
+            case 3: return "a";
+            case 4: return opt.structs ? "p.x" : "b";
+            default: return "arr[" + loopVar(pick(loopLevel)) + "]";
+        }
+    }
+
+    std::string expr(int depth, int loopLevel) {
+        if (depth <= 0 || pick(4) == 0) return leaf(loopLevel);
+        static const char* ops[] = {"+", "-", "*", "+", "<", "==", "&&", "-"};
+        int k = pick(10);
+        if (k == 9) {
+            if (curFunction == 0) return leaf(loopLevel);
+            int callee = pick(curFunction);
+            return "f" + std::to_string(callee) + "(" + expr(depth - 1, loopLevel) + ", " + expr(depth - 1, loopLevel) + ")";
+        }
+        if (k == 8) return "(" + expr(depth - 1, loopLevel) + " / 3)";
+        if (k == 7) return "-" + leaf(loopLevel);
+        return "(" + expr(depth - 1, loopLevel) + " " + ops[k] + " " + expr(depth - 1, loopLevel) + ")";
+    }
+
+    std::string assignTarget(int loopLevel) {
+        int k = pick(loopLevel > 0 ? 4 : 3);
+        if (k == 2 && opt.structs) return "p.y";
+        if (k == 3) return "arr[" + loopVar(pick(loopLevel)) + "]";
+        return local(pick(kLocals));
+    }
+
+    std::string stmt(int indent, int loopLevel, int budget) {
+        int k = pick(10);
+        if (k <= 3 || budget <= 1) {
+            return assignTarget(loopLevel) + " = " + expr(opt.exprDepth, loopLevel) + ";";
+        }
+        if (k == 4 && opt.strings) {
+            return "printf(\"f" + std::to_string(curFunction) + " %d\\n\", " + expr(1, loopLevel) + ");";
+        }
+        if (k <= 6 && loopLevel < opt.loopDepth) {
+            std::string iv = loopVar(loopLevel);
+            std::vector<std::string> body;
+            int n = 1 + pick(3);
+            for (int i = 0; i < n; ++i) body.push_back(stmt(indent + 1, loopLevel + 1, budget / 2));
+            int bound = 2 + pick(kArrayLen - 2);
+            if (pick(3) == 0) {
+                body.push_back(iv + " = " + iv + " + 1;");
+                std::vector<std::string> loop{iv + " = 0;", "while (" + iv + " < " + std::to_string(bound) + ") " + block(body, indent + 1)};
+                return block(loop, indent);
+            }
+            return "for (" + iv + " = 0; " + iv + " < " + std::to_string(bound) + "; " + iv + " = " + iv + " + 1) " + block(body, indent);
+        }
+        std::vector<std::string> thenBody{stmt(indent + 1, loopLevel, budget / 2)};
+        std::vector<std::string> elseBody{stmt(indent + 1, loopLevel, budget / 2)};
+        return "if (" + expr(2, loopLevel) + ") " + block(thenBody, indent) + " else " + block(elseBody, indent);
+    }
+
+    // Level d of a chain of nested blocks: declares nestLocals fresh names,
+    // shadows one of the function's locals, reads names from outer levels
+    // and then opens level d + 1.
+    std::string nest(int d, int indent) {
+        std::vector<std::string> body;
+        auto name = [](int level, int k) { return "n" + std::to_string(level) + "_" + std::to_string(k); };
+        for (int k = 0; k < opt.nestLocals; ++k) {
+            std::string init = d == 0 ? std::to_string(k) : name(pick(d), pick(opt.nestLocals)) + " + " + std::to_string(k);
+            body.push_back("int " + name(d, k) + " = " + init + ";");
+        }
+        std::string shadowed = local(pick(kLocals));
+        body.push_back("int " + shadowed + " = " + shadowed + " + " + name(d, 0) + ";");
+        body.push_back(local(pick(kLocals)) + " = " + name(pick(d + 1), pick(opt.nestLocals)) + " - " + shadowed + ";");
+        if (d + 1 < opt.nestDepth) body.push_back(nest(d + 1, indent));
+        return block(body, indent);
+    }
+
+    std::string function(int f) {
+        curFunction = f;
+        std::vector<std::string> body;
+        if (opt.structs && f == 0) body.push_back("struct P { int x; int y; char tag; };");
+        for (int i = 0; i < kLocals; ++i) body.push_back("int " + local(i) + " = " + std::to_string(i + f) + ";");
+        for (int d = 0; d < opt.loopDepth; ++d) body.push_back("int " + loopVar(d) + ";");
+        body.push_back("int arr[" + std::to_string(kArrayLen) + "];");
+        if (opt.structs) {
+            body.push_back("struct P p;");
+            body.push_back("p.x = a;");
+            body.push_back("p.y = b;");
+        }
+        // arrays are only read inside loops, after this initialization
+        body.push_back("for (i0 = 0; i0 < " + std::to_string(kArrayLen) + "; i0 = i0 + 1) arr[i0] = i0;");
+        for (int s = 0; s < opt.stmts; ++s) body.push_back(stmt(1, 0, 8));
+        if (opt.nestDepth > 0) body.push_back(nest(0, 1));
+        body.push_back("return " + expr(opt.exprDepth, 0) + ";");
+        return "int f" + std::to_string(f) + "(int a, int b) " + block(body, 0) + "\n\n";
+    }
+
+    std::string mainFunction() {
+        curFunction = opt.functions;
+        std::vector<std::string> body{"int s = 0;"};
+        int calls = opt.mainCalls < 0 ? opt.functions : std::min(opt.mainCalls, opt.functions);
+        for (int f = 0; f < calls; ++f) {
+            body.push_back("s = s + f" + std::to_string(f) + "(" + std::to_string(f) + ", " + std::to_string(f + 1) + ");");
+        }
+        body.push_back("return s;");
+        return "int main() " + block(body, 0) + "\n";
+    }
+};
+
+void usage() {
+    std::cerr << "usage: gen_mc [--functions N] [--main-calls N] [--stmts N] [--expr-depth N] [--loop-depth N]\n"
+                 "              [--no-structs] [--no-strings] [--block-limit N] [--seed N]\n"
+                 "              [--nest-depth N] [--nest-locals N]\n";
+}
+}
+
+int main(int argc, char** argv) {
+    GenOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](int& dst) {
+            if (i + 1 >= argc) { usage(); std::exit(2); }
+            dst = std::atoi(argv[++i]);
+        };
+        if (arg == "--functions") value(opt.functions);
+        else if (arg == "--main-calls") value(opt.mainCalls);
+        else if (arg == "--stmts") value(opt.stmts);
+        else if (arg == "--expr-depth") value(opt.exprDepth);
+        else if (arg == "--loop-depth") value(opt.loopDepth);
+        else if (arg == "--block-limit") value(opt.blockLimit);
+        else if (arg == "--nest-depth") value(opt.nestDepth);
+        else if (arg == "--nest-locals") value(opt.nestLocals);
+        else if (arg == "--no-structs") opt.structs = false;
+        else if (arg == "--no-strings") opt.strings = false;
+        else if (arg == "--seed" && i + 1 < argc) opt.seed = std::strtoull(argv[++i], nullptr, 10);
+        else { usage(); return 2; }
+    }
+    if (opt.loopDepth < 1) opt.loopDepth = 1; // i0 drives the array initializer
+    ProgramGen gen(opt);
+    std::cout << gen.program();
+    return 0;
+}
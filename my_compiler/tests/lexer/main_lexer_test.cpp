@@ -1,3 +1,153 @@
+// Token-for-token comparison of the hand-written Lexer against the flex
+// scanner from lexer.l, plus MB/s for both. Link with the flex-generated
+// lexer.yy.o (make test-lexer).
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-int main(){ std::cout << "lexer tests stub" << std::endl; }
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "token_bridge.h"
+
+extern FILE* yyin;
+extern int yylineno;
+int yylex(void);
+void yyrestart(FILE* f);
+
+namespace {
+// Exercises every rule in lexer.l.
+const char* kCorpus =
+    "int float return char void struct typedef static extern sizeof\n"
+    "if else while for do switch case default break continue goto\n"
+    "ident _x x1 int2 returns i\n"
+    "0 42 1234567 99999999999999999999 3.14 2. .5 1.5e10 2.0E-3 7e3\n"
+    "== != <= >= && || << >> -> < > + - * / ! & | ^ % . = ; , ( ) { } [ ] : ~ ? @\n"
+    "\"plain\" \"esc \\\"q\\\" \\n\" \"\" 'a' ' ' '\\n' '\\t' '\\0' '\\\\' '\\''\n"
+    "// line comment\n"
+    "/* block\n comment */ a/**/b /* * ** x */ c /* x **/ d /***/ e\n"
+    "x->y a.b p[3] f(1, 2);\n";
+
+struct Tok {
+    int code;
+    std::string text; // strdup'd payload or decimal ival
+    int line;
+    std::string spelling; // hand tokens only: the source text
+    bool operator==(const Tok& o) const { return code == o.code && text == o.text; }
+};
+
+std::string payload(int code, const YYSTYPE& v) {
+    if (code == T_ID || code == T_FLOATLIT || code == T_STRING) {
+        std::string s = v.sval ? v.sval : "";
+        std::free(v.sval);
+        return s;
+    }
+    if (code == T_NUM) return std::to_string(v.ival);
+    return "";
+}
+
+std::vector<Tok> flexTokens(std::string& src) {
+    std::vector<Tok> out;
+    FILE* f = fmemopen(src.data(), src.size(), "r");
+    yyin = f; yyrestart(f); yylineno = 1;
+    for (int code; (code = yylex()) != 0;) out.push_back({code, payload(code, yylval), yylineno, {}});
+    std::fclose(f);
+    return out;
+}
+
+std::vector<Tok> handTokens(const std::string& src) {
+    std::vector<Tok> out;
+    Lexer lex(src);
+    for (;;) {
+        Token t = lex.next();
+        YYSTYPE v{};
+        int code = bisonTokenFor(t, v);
+        if (code == 0) break;
+        out.push_back({code, payload(code, v), t.loc.line, std::string(t.lexeme)});
+    }
+    return out;
+}
+
+int decodedEscape(char e) {
+    switch (e) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return 0;
+        default: return static_cast<unsigned char>(e);
+    }
+}
+
+// lexer.l takes the byte after the quote, the backslash, as the value of
+// '\n' and friends; the hand lexer decodes the escape. That is the one
+// intended difference.
+bool knownDifference(const Tok& flexTok, const Tok& handTok) {
+    const std::string& s = handTok.spelling;
+    return flexTok.code == T_NUM && handTok.code == T_NUM && flexTok.text == std::to_string('\\')
+        && s.size() == 4 && s[0] == '\'' && s[1] == '\\' && s[3] == '\''
+        && handTok.text == std::to_string(decodedEscape(s[2]));
+}
+
+bool compare(const std::string& name, std::string src) {
+    auto a = flexTokens(src);
+    auto b = handTokens(src);
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] == b[i] || knownDifference(a[i], b[i])) continue;
+        std::cerr << "FAIL " << name << ": token " << i << " (line " << a[i].line << "): flex=" << a[i].code
+                  << " '" << a[i].text << "' hand=" << b[i].code << " '" << b[i].text << "'\n";
+        return false;
+    }
+    if (a.size() != b.size()) {
+        std::cerr << "FAIL " << name << ": flex produced " << a.size() << " tokens, hand " << b.size() << "\n";
+        return false;
+    }
+    std::cout << "PASS " << name << ": " << a.size() << " tokens\n";
+    return true;
+}
+
+template <typename F>
+double mbPerSec(const std::string& src, int iters, F&& run) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) run();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return secs > 0 ? (static_cast<double>(src.size()) * iters / 1048576.0) / secs : 0;
+}
+
+void benchmark(const std::string& name, std::string src) {
+    int iters = src.size() < (1u << 20) ? 50 : 5;
+    size_t sink = 0;
+    double flex = mbPerSec(src, iters, [&] {
+        FILE* f = fmemopen(src.data(), src.size(), "r");
+        yyin = f; yyrestart(f);
+        for (int code; (code = yylex()) != 0;) { payload(code, yylval); ++sink; }
+        std::fclose(f);
+    });
+    double bridged = mbPerSec(src, iters, [&] {
+        Lexer lex(src);
+        for (;;) { Token t = lex.next(); YYSTYPE v{}; int c = bisonTokenFor(t, v); if (!c) break; payload(c, v); ++sink; }
+    });
+    double direct = mbPerSec(src, iters, [&] {
+        Lexer lex(src);
+        while (lex.next().kind != Token::End) ++sink;
+    });
+    std::cout << "BENCH " << name << ": flex " << flex << " MB/s, hand+yylval " << bridged
+              << " MB/s, hand zero-copy " << direct << " MB/s\n";
+    assert(sink > 0);
+}
+}
+
+int main(int argc, char** argv) {
+    bool ok = compare("corpus", kCorpus);
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i]);
+        if (!in) { std::cerr << "error: cannot open input file: " << argv[i] << "\n"; return 1; }
+        std::ostringstream buf; buf << in.rdbuf();
+        ok = compare(argv[i], buf.str()) && ok;
+        benchmark(argv[i], buf.str());
+    }
+    return ok ? 0 : 1;
+}
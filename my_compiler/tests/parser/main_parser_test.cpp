@@ -1,3 +1,242 @@
+// Checks that the hand-written Parser builds the same AST (and the same
+// typedef/struct registries) as the bison parser, then times both.
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-int main(){ std::cout << "parser tests stub" << std::endl; }
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ast.h"
+#include "error_handler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parser.tab.hh"
+
+extern FILE* yyin;
+extern int yylineno;
+extern std::vector<std::unique_ptr<Function>> g_functions;
+extern std::unordered_set<std::string> g_typedef_ints;
+extern std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> g_struct_field_types;
+extern std::unordered_map<std::string, Type*> g_func_typedefs;
+void yyrestart(FILE* f);
+
+namespace {
+// Every construct parser.y accepts. Blocks hold at most two statements so
+// bison can parse it too.
+const char* kCorpus =
+    "extern int ext(int a, char c);\n"
+    "int f(int a, char c) {\n"
+    "  { struct S { int x; char t; int y; }; typedef int myint; }\n"
+    "  { typedef int (*fp)(int a, char b); typedef char (*cp)(); }\n"
+    "}\n"
+    "int g() {\n"
+    "  { static int s; int x = 1 + 2 * 3 - 4 / 5 % 6; }\n"
+    "  { { { char c; int arr[10]; } { char buf[4]; struct S v; } }\n"
+    "    { struct S* q; x = sizeof(int) + sizeof(char) + sizeof(struct S); } }\n"
+    "}\n"
+    "int h(int n) {\n"
+    "  { myint m; fp p; }\n"
+    "  { x = y = a || b && c | d ^ e & f == g != h < i > j <= k >= l << m >> n; ; }\n"
+    "}\n"
+    "int k() {\n"
+    "  { if (a) if (b) x = 1; else x = 2; while (x < 10) x = x + 1; }\n"
+    "  { { do { x = x - 1; } while (x); for (;;) break; } { for (i = 0; i < n; i = i + 1) continue; goto done; } }\n"
+    "}\n"
+    "int m() {\n"
+    "  { done: return -a + !b * *p + &q; x = f(1, g(2), 'c') + arr[i][j] + s.x + p->y; }\n"
+    "  { printf(\"%d\\n\", 2.5 + .5 + 1.5e3); return sizeof(int2) + (a + b) * c; }\n"
+    "}\n";
+
+void dumpType(const Type* t, std::string& out) {
+    if (!t) { out += "null"; return; }
+    switch (t->kind) {
+        case TypeKind::Int: out += "int"; break;
+        case TypeKind::Char: out += "char"; break;
+        case TypeKind::Float: out += "float"; break;
+        case TypeKind::Void: out += "void"; break;
+        case TypeKind::Pointer: out += "ptr("; dumpType(t->element, out); out += ")"; break;
+        case TypeKind::Array: out += "arr" + std::to_string(t->arrayLength) + "("; dumpType(t->element, out); out += ")"; break;
+        case TypeKind::Struct: out += "struct " + t->structName; break;
+        case TypeKind::Function:
+            out += "fn(";
+            for (const Type* p : t->params) { dumpType(p, out); out += ","; }
+            out += ")->";
+            dumpType(t->element, out);
+            break;
+    }
+}
+
+void dump(const Expr* e, std::string& out) {
+    if (!e) { out += "_"; return; }
+    if (auto n = dynamic_cast<const NumberExpr*>(e)) out += std::to_string(n->value);
+    else if (auto f = dynamic_cast<const FloatLiteralExpr*>(e)) { std::ostringstream ss; ss << std::hexfloat << f->value; out += ss.str(); }
+    else if (auto v = dynamic_cast<const VarExpr*>(e)) out += v->name;
+    else if (auto s = dynamic_cast<const StringLiteralExpr*>(e)) out += "\"" + s->value + "\"";
+    else if (auto z = dynamic_cast<const SizeofExpr*>(e)) { out += "sizeof("; if (z->operand) dumpType(z->operand, out); else out += z->name; out += ")"; }
+    else if (auto u = dynamic_cast<const UnaryExpr*>(e)) { out += "(" + u->op; dump(u->operand.get(), out); out += ")"; }
+    else if (auto b = dynamic_cast<const BinaryExpr*>(e)) { out += "("; dump(b->lhs.get(), out); out += " " + b->op + " "; dump(b->rhs.get(), out); out += ")"; }
+    else if (auto a = dynamic_cast<const AssignExpr*>(e)) { out += "("; dump(a->target.get(), out); out += " = "; dump(a->value.get(), out); out += ")"; }
+    else if (auto c = dynamic_cast<const CallExpr*>(e)) {
+        dump(c->callee.get(), out); out += "(";
+        for (const auto& arg : c->args) { dump(arg.get(), out); out += ","; }
+        out += ")";
+    }
+    else if (auto i = dynamic_cast<const ArrayIndexExpr*>(e)) { dump(i->base.get(), out); out += "["; dump(i->index.get(), out); out += "]"; }
+    else if (auto m = dynamic_cast<const MemberExpr*>(e)) { dump(m->base.get(), out); out += "." + m->field; }
+    else if (auto pm = dynamic_cast<const PtrMemberExpr*>(e)) { dump(pm->base.get(), out); out += "->" + pm->field; }
+    else out += "?expr";
+}
+
+void dump(const Stmt* s, std::string& out) {
+    if (!s) { out += "_;"; return; }
+    if (auto r = dynamic_cast<const ReturnStmt*>(s)) { out += "return "; dump(r->value.get(), out); out += ";"; }
+    else if (auto e = dynamic_cast<const ExprStmt*>(s)) { dump(e->expr.get(), out); out += ";"; }
+    else if (auto b = dynamic_cast<const BlockStmt*>(s)) {
+        out += "{";
+        for (const auto& st : b->statements) dump(st.get(), out);
+        out += "}";
+    }
+    else if (auto i = dynamic_cast<const IfStmt*>(s)) {
+        out += "if("; dump(i->condition.get(), out); out += ")"; dump(i->thenBranch.get(), out);
+        if (i->elseBranch) { out += "else "; dump(i->elseBranch.get(), out); }
+    }
+    else if (auto w = dynamic_cast<const WhileStmt*>(s)) { out += "while("; dump(w->condition.get(), out); out += ")"; dump(w->body.get(), out); }
+    else if (auto d = dynamic_cast<const DoWhileStmt*>(s)) { out += "do "; dump(d->body.get(), out); out += "while("; dump(d->condition.get(), out); out += ");"; }
+    else if (auto f = dynamic_cast<const ForStmt*>(s)) {
+        out += "for("; if (f->init) dump(f->init.get(), out);
+        out += "|"; dump(f->condition.get(), out);
+        out += "|"; if (f->iter) dump(f->iter.get(), out);
+        out += ")"; dump(f->body.get(), out);
+    }
+    else if (auto sw = dynamic_cast<const SwitchStmt*>(s)) {
+        out += "switch("; dump(sw->value.get(), out); out += "){";
+        for (const auto& c : sw->cases) {
+            out += "case " + std::to_string(c.value) + ":";
+            for (const auto& st : c.statements) dump(st.get(), out);
+        }
+        out += "default:";
+        for (const auto& st : sw->defaultBody) dump(st.get(), out);
+        out += "}";
+    }
+    else if (auto v = dynamic_cast<const VarDeclStmt*>(s)) {
+        out += v->isStatic ? "static " : "";
+        dumpType(v->type, out);
+        out += " " + v->name;
+        if (v->init) { out += " = "; dump(v->init.get(), out); }
+        out += ";";
+    }
+    else if (dynamic_cast<const BreakStmt*>(s)) out += "break;";
+    else if (dynamic_cast<const ContinueStmt*>(s)) out += "continue;";
+    else if (auto g = dynamic_cast<const GotoStmt*>(s)) out += "goto " + g->label + ";";
+    else if (auto l = dynamic_cast<const LabelStmt*>(s)) out += l->label + ":";
+    else out += "?stmt;";
+}
+
+// AST of every function plus the registries the grammar actions fill; then clears all of it.
+std::string takeModule() {
+    std::string out;
+    for (const auto& fn : g_functions) {
+        out += (fn->isExtern ? "extern int " : "int ") + fn->name + "(";
+        for (const auto& p : fn->detailedParams) { dumpType(p.type, out); out += " " + p.name + ","; }
+        out += ")";
+        dump(fn->bodyBlock.get(), out);
+        out += "\n";
+    }
+    std::vector<std::string> regs;
+    for (const auto& t : g_typedef_ints) regs.push_back("typedef int " + t);
+    for (const auto& [name, fields] : g_struct_field_types) {
+        std::string r = "struct " + name + " {";
+        for (const auto& [f, ty] : fields) r += ty + " " + f + ";";
+        regs.push_back(r + "}");
+    }
+    for (const auto& [name, t] : g_func_typedefs) { std::string r = "typedef " + name + " "; dumpType(t, r); regs.push_back(r); }
+    std::sort(regs.begin(), regs.end());
+    for (const auto& r : regs) out += r + "\n";
+    g_functions.clear();
+    g_typedef_ints.clear();
+    g_struct_field_types.clear();
+    g_func_typedefs.clear();
+    return out;
+}
+
+bool parseBison(std::string& src) {
+    FILE* f = fmemopen(src.data(), src.size(), "r");
+    yyin = f; yyrestart(f); yylineno = 1;
+    int status = yyparse();
+    std::fclose(f);
+    return status == 0;
+}
+
+bool parseHand(const std::string& src) {
+    ErrorHandler err;
+    Lexer lex(src);
+    Parser parser(lex, err);
+    bool ok = parser.parseTranslationUnit(g_functions);
+    if (!ok) err.printAll();
+    return ok;
+}
+
+template <typename F>
+double mbPerSec(size_t bytes, int iters, F&& run) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) { run(); g_functions.clear(); }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return secs > 0 ? (static_cast<double>(bytes) * iters / 1048576.0) / secs : 0;
+}
+
+bool compare(const std::string& name, std::string src, bool bench) {
+    bool okBison = parseBison(src);
+    std::string expected = takeModule();
+    bool okHand = parseHand(src);
+    std::string actual = takeModule();
+    if (!okBison || !okHand) {
+        std::cerr << "FAIL " << name << ": bison " << (okBison ? "ok" : "failed") << ", hand " << (okHand ? "ok" : "failed") << "\n";
+        return false;
+    }
+    if (expected != actual) {
+        size_t i = 0;
+        while (i < expected.size() && i < actual.size() && expected[i] == actual[i]) ++i;
+        size_t from = i > 40 ? i - 40 : 0;
+        std::cerr << "FAIL " << name << ": ASTs differ at byte " << i << "\n  bison: " << expected.substr(from, 100)
+                  << "\n  hand:  " << actual.substr(from, 100) << "\n";
+        return false;
+    }
+    std::cout << "PASS " << name << ": " << expected.size() << " bytes of AST dump\n";
+    if (bench) {
+        int iters = src.size() < (1u << 20) ? 20 : 3;
+        double bison = mbPerSec(src.size(), iters, [&] { parseBison(src); });
+        double hand = mbPerSec(src.size(), iters, [&] { parseHand(src); });
+        std::cout << "BENCH " << name << ": bison " << bison << " MB/s, hand " << hand << " MB/s ("
+                  << (bison > 0 ? hand / bison : 0) << "x)\n";
+    }
+    return true;
+}
+
+// bison stops at two statements per block; the hand parser has no limit.
+bool longBlock() {
+    std::string src = "int main() {\n";
+    for (int i = 0; i < 10000; ++i) src += "  x = x + " + std::to_string(i) + ";\n";
+    src += "  return x;\n}\n";
+    bool ok = parseHand(src) && g_functions.size() == 1 && g_functions[0]->bodyBlock->statements.size() == 10001;
+    takeModule();
+    std::cout << (ok ? "PASS" : "FAIL") << " long block: 10001 statements\n";
+    return ok;
+}
+}
+
+int main(int argc, char** argv) {
+    bool ok = compare("corpus", kCorpus, false);
+    ok = longBlock() && ok;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i]);
+        if (!in) { std::cerr << "error: cannot open input file: " << argv[i] << "\n"; return 1; }
+        std::ostringstream buf; buf << in.rdbuf();
+        ok = compare(argv[i], buf.str(), true) && ok;
+    }
+    return ok ? 0 : 1;
+}